@@ -1,7 +1,32 @@
-#include <math.h>
+#include <limits.h>
 #include <stdio.h>
+#include <string.h>
+#include <sys/random.h>
+#include <time.h>
 
-#include "hashmap_base.h"
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** a new random seed for a map
+ *
+ * if the os has no randomness to give the time and the address of a local are
+ * mixed instead, that is still different for every map and every run
+ */
+uint64_t new_seed(void) {
+    uint64_t seed;
+
+    if (getrandom(&seed, sizeof(seed), GRND_NONBLOCK) != sizeof(seed)) {
+        struct timespec now;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+
+        seed = ((uint64_t)now.tv_sec << 32 ^ (uint64_t)now.tv_nsec ^
+                (uint64_t)(uintptr_t)&seed) *
+               UINT64_C(0x9e3779b97f4a7c15);
+    }
+
+    return seed;
+}
 
 /** init the hashmap base
  *
@@ -17,28 +42,121 @@
  *   a function that will receive the key and value for each entry
  *
  *  @param size
- *   the size of the hash table
+ *   the size of the hash table, this needs to be a power of two
+ *
+ *  @param backend
+ *   the storage layout to use for the table
  */
 HashMapBase *init_hashmap_base(HashFunc hash_func, CompFunc comp_func,
-                               DropFunc drop_func, size_t size) {
+                               DropFunc drop_func, uint64_t size,
+                               enum HashMapBackend backend) {
     HashMapBase *map = malloc(sizeof(HashMapBase));
 
     if (map == NULL) {
         return NULL;
     }
 
-    map->table = malloc(sizeof(Entry *) * size);
+    map->backend = backend;
+    map->table = NULL;
+    map->slots = NULL;
+    map->ctrl = NULL;
+    map->mapped = NULL;
+    map->mapped_size = 0;
+    map->indexes = NULL;
+    map->entries_used = 0;
+    map->entries_capacity = 0;
+
+    init_pool(&map->pool);
+
+    map->old_table = NULL;
+    map->old_table_size = 0;
+    map->migrate_index = 0;
+    map->incremental = false;
+    map->active_iters = 0;
+    map->max_pause_ns = 0;
+
+    map->seed = new_seed();
+    map->flooded = false;
+    map->reseed_size = 0;
+    map->reseed_count = 0;
+
+    map->cache_capacity = 0;
+    map->clock_hand = 0;
+    map->referenced = NULL;
+    map->cache_hits = map->cache_misses = map->cache_evictions = 0;
+
+    map->rehash_count = 0;
+    map->rehash_ns = 0;
+    map->lookups[0] = map->lookups[1] = 0;
+    map->lookup_probes[0] = map->lookup_probes[1] = 0;
 
-    for (int i = 0; i < size; ++i) {
-        map->table[i] = NULL;
-    }
+    map->current_size = 0;
+    map->max_load_factor = MAX_LOAD_FACTOR;
+    map->growth_factor = GROWTH_FACTOR;
 
-    if (map->table == NULL) {
-        return NULL;
+    switch (backend) {
+        case HashMapChained: {
+            map->table = calloc(size, sizeof(Entry *));
+
+            if (map->table == NULL) {
+                free(map);
+                return NULL;
+            }
+            break;
+        }
+        case HashMapOpen: {
+            map->slots = alloc_slots_open(size);
+
+            if (map->slots == NULL) {
+                free(map);
+                return NULL;
+            }
+            break;
+        }
+        case HashMapSwiss: {
+            if (size < min_table_size_swiss()) {
+                size = min_table_size_swiss();
+            }
+
+            map->table_size = size;
+
+            if (!alloc_table_swiss(map)) {
+                free(map);
+                return NULL;
+            }
+            break;
+        }
+        case HashMapCompact: {
+            map->table_size = size;
+
+            if (!alloc_table_compact(map)) {
+                free(map);
+                return NULL;
+            }
+            break;
+        }
+        case HashMapCuckoo: {
+            if (size < min_table_size_cuckoo()) {
+                size = min_table_size_cuckoo();
+            }
+
+            map->table_size = size;
+
+            if (!alloc_table_cuckoo(map)) {
+                free(map);
+                return NULL;
+            }
+            break;
+        }
+        case HashMapMapped: {
+            // these only come from load_hashmap_mmap_base
+            free(map);
+            return NULL;
+        }
     }
 
     map->table_size = size;
-    map->current_size = 0;
+    map->threshold = size * MAX_LOAD_FACTOR;
 
     map->hash_func = hash_func;
     map->comp_func = comp_func;
@@ -47,10 +165,98 @@ HashMapBase *init_hashmap_base(HashFunc hash_func, CompFunc comp_func,
     return map;
 }
 
+/* the threshold for a table size, a chained table of 2^30 buckets with a load
+ * factor of 4 would be past INT_MAX so it stops there
+ */
+static inline int _threshold_for(int table_size, double max_load_factor) {
+    double threshold = table_size * max_load_factor;
+
+    return threshold >= INT_MAX ? INT_MAX : (int)threshold;
+}
+
+/** the smallest table that can hold capacity entrys without growing
+ *
+ * @return
+ *  the table size or 0 if capacity needs a table over MAX_TABLE_SIZE
+ */
+static int _table_size_for(enum HashMapBackend backend, double max_load_factor,
+                           size_t capacity) {
+    int size = MIN_TABLE_SIZE;
+
+    if (backend == HashMapSwiss && size < min_table_size_swiss()) {
+        size = min_table_size_swiss();
+    }
+
+    if (backend == HashMapCuckoo && size < min_table_size_cuckoo()) {
+        size = min_table_size_cuckoo();
+    }
+
+    // an insert grows the table when it would reach the threshold so the
+    // threshold has to be past the capacity
+    while ((size_t)(size * max_load_factor) <= capacity) {
+        if (size == MAX_TABLE_SIZE) {
+            return 0;
+        }
+
+        size *= 2;
+    }
+
+    return size;
+}
+
+/** init the hashmap base with room for capacity entrys
+ *
+ * the table is made big enough that inserting capacity entrys never rehashes,
+ * for a map that is filled with a known amount of keys this skips all the
+ * rehashes on the way there
+ *
+ * @param capacity
+ *  the amount of entrys the map should hold without growing
+ *
+ * the rest of the params are the same as init_hashmap_base
+ */
+HashMapBase *init_hashmap_with_capacity_base(HashFunc hash_func,
+                                             CompFunc comp_func,
+                                             DropFunc drop_func,
+                                             size_t capacity,
+                                             enum HashMapBackend backend) {
+    int size = _table_size_for(backend, MAX_LOAD_FACTOR, capacity);
+
+    if (size == 0) {
+        return NULL;
+    }
+
+    return init_hashmap_base(hash_func, comp_func, drop_func, size, backend);
+}
+
+/* the current time for measuring rehash pauses */
+static uint64_t _now_ns(void) {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+/* keep track of the longest time a single call spent rehashing and the total
+ * time spent rehashing
+ */
+static void _record_pause(HashMapBase *map, uint64_t start) {
+    uint64_t pause = _now_ns() - start;
+
+    map->rehash_ns += pause;
+
+    if (pause > map->max_pause_ns) {
+        map->max_pause_ns = pause;
+    }
+}
+
 /** drop the hashmap table, entrys and values
  *
  * the values will not be freed if there is no drop_func attached to the hashmap
  *
+ * the entrys themselves are freed with the pool in drop_hashmap_base
+ *
  * NOTE: the value check could be enforced from the drop_func but it
  * probably is safer to do that here and let the drop_func assume it
  * will always have valid data
@@ -58,27 +264,27 @@ HashMapBase *init_hashmap_base(HashFunc hash_func, CompFunc comp_func,
  * @param map
  *  the hashmap base
  */
-void drop_table(HashMapBase *map) {
-    Entry *entry;
-    Entry *temp;
-
-    for (int i = 0; i < map->table_size; ++i) {
-        entry = map->table[i];
-
-        while (entry != NULL) {
-            if (map->drop_func) {
+static void _drop_chains(HashMapBase *map, Entry **table, int table_size) {
+    // the entrys live in the pool so they only need to be walked to drop the
+    // keys and values
+    if (map->drop_func) {
+        for (int i = 0; i < table_size; ++i) {
+            for (Entry *entry = table[i]; entry != NULL; entry = entry->next) {
                 map->drop_func((void *)entry->key, entry->value);
             }
+        }
+    }
 
-            temp = entry->next;
+    free(table);
+}
 
-            free(entry);
+/* drop the chained table and the old table if a rehash is in progress */
+void drop_table(HashMapBase *map) {
+    _drop_chains(map, map->table, map->table_size);
 
-            entry = temp;
-        }
+    if (map->old_table) {
+        _drop_chains(map, map->old_table, map->old_table_size);
     }
-
-    free(map->table);
 }
 
 /** drop the whole hashmap
@@ -93,19 +299,41 @@ void drop_hashmap_base(HashMapBase *map) {
         drop_table(map);
     }
 
+    if (map->indexes) {
+        drop_table_compact(map);
+    } else if (map->ctrl && map->backend == HashMapCuckoo) {
+        drop_table_cuckoo(map);
+    } else if (map->ctrl) {
+        drop_table_swiss(map);
+    } else if (map->slots) {
+        drop_table_open(map);
+    } else if (map->mapped) {
+        drop_table_mapped(map);
+    }
+
+    drop_pool(&map->pool);
+
+    free(map->referenced);
     free(map);
 }
 
 /** create an entry struct
+ *
+ * @param map
+ *  the hashmap base, the entry comes from its pool
  *
  * @param key
  *  a pointer to the key
  *
  * @param value
  *  a pointer the value
+ *
+ * @param hash
+ *  the full hash of the key, this is kept so the key never has to be hashed
+ *  again
  */
-Entry *create_entry(void *key, void *value) {
-    Entry *entry = malloc(sizeof(Entry));
+Entry *create_entry(HashMapBase *map, void *key, void *value, uint64_t hash) {
+    Entry *entry = pool_alloc_entry(&map->pool);
 
     if (entry == NULL) {
         return NULL;
@@ -117,184 +345,823 @@ Entry *create_entry(void *key, void *value) {
 
     entry->value = value;
 
+    entry->hash = hash;
+
     return entry;
 }
 
-/** the internal insert function
+/** move old buckets in to the new table during an incremental rehash
+ *
+ * the entrys are moved as they are, just relinked at the front of their new
+ * bucket, once the last bucket is moved the old table is freed
  *
- * this is where entrys will acutely be entered in to the table/linked list
+ * this is not timed here as resize_hashmap already times the migration that
+ * _start_incremental_rehash finishes, the other callers record the pause
  *
  * @param map
  *  the hashmap base
  *
- * @param entry
- *  a pointer to an Entry struct, these will not be reallocate
+ * @param count
+ *  the max amount of old buckets to move
+ */
+static void _migrate_buckets(HashMapBase *map, int count) {
+    int end = map->migrate_index + count;
+
+    if (end > map->old_table_size) {
+        end = map->old_table_size;
+    }
+
+    for (int i = map->migrate_index; i < end; ++i) {
+        Entry *entry = map->old_table[i];
+
+        while (entry != NULL) {
+            Entry *next = entry->next;
+            uint64_t bucket = entry->hash & (map->table_size - 1);
+
+            entry->next = map->table[bucket];
+            map->table[bucket] = entry;
+
+            entry = next;
+        }
+
+        map->old_table[i] = NULL;
+    }
+
+    map->migrate_index = end;
+
+    if (map->migrate_index == map->old_table_size) {
+        free(map->old_table);
+
+        map->old_table = NULL;
+        map->old_table_size = 0;
+        map->migrate_index = 0;
+    }
+}
+
+/* move every old bucket that is left in one go and record it as a pause */
+static void _finish_migration(HashMapBase *map) {
+    uint64_t start = _now_ns();
+
+    _migrate_buckets(map, map->old_table_size);
+
+    _record_pause(map, start);
+}
+
+/** do a bit of the incremental rehash if there is one in progress
+ *
+ * this is called at the start of every operation on a chained map, the
+ * migration is held while there are iterators so they see every entry once
+ */
+static inline void _rehash_step(HashMapBase *map) {
+    if (map->old_table && map->active_iters == 0) {
+        uint64_t start = _now_ns();
+
+        _migrate_buckets(map, INCREMENTAL_REHASH_STEP);
+
+        _record_pause(map, start);
+    }
+}
+
+/** start an incremental rehash
+ *
+ * the current table becomes the old table and a new empty table is set up,
+ * if the last rehash is still going it is finished first
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param new_table_size
+ *  the size of the new table
+ */
+static enum HashMapResult _start_incremental_rehash(HashMapBase *map,
+                                                    int new_table_size) {
+    if (map->old_table) {
+        _migrate_buckets(map, map->old_table_size);
+    }
+
+    Entry **new_table = calloc(new_table_size, sizeof(Entry *));
+
+    if (new_table == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    map->old_table = map->table;
+    map->old_table_size = map->table_size;
+    map->migrate_index = 0;
+
+    map->table = new_table;
+    map->table_size = new_table_size;
+
+    return Success;
+}
+
+/** turn incremental rehashing on or off
+ *
+ * with it on the table is not rehashed in one go when it grows, the old and
+ * new table are kept and every operation moves INCREMENTAL_REHASH_STEP
+ * buckets over until the old table is empty
+ *
+ * this only works with the chained backend
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param incremental
+ *  true to turn it on
+ *
+ * @return
+ *  false if the backend does not support it
+ */
+bool set_incremental_rehash_base(HashMapBase *map, bool incremental) {
+    if (map->backend != HashMapChained) {
+        return false;
+    }
+
+    // finish what ever is left so the map is back to one table
+    if (!incremental && map->old_table) {
+        _finish_migration(map);
+    }
+
+    map->incremental = incremental;
+
+    return true;
+}
+
+/* the longest time in nanoseconds a single call spent rehashing */
+uint64_t get_max_pause_base(HashMapBase *map) {
+    return map->max_pause_ns;
+}
+
+/** rehash the chained table
+ *
+ * the entrys are relinked in to the new table using their stored hash, there
+ * can not be any duplicates so nothing can fail once the new table is
+ * allocated
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param new_table_size
+ *  the size of the new table
+ */
+enum HashMapResult rehash_chained(HashMapBase *map, int new_table_size) {
+    if (map->incremental) {
+        return _start_incremental_rehash(map, new_table_size);
+    }
+
+    Entry **new_table = calloc(new_table_size, sizeof(Entry *));
+
+    if (new_table == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    for (int i = 0; i < map->table_size; ++i) {
+        Entry *entry = map->table[i];
+
+        while (entry != NULL) {
+            Entry *next = entry->next;
+            uint64_t bucket = entry->hash & (new_table_size - 1);
+
+            entry->next = new_table[bucket];
+            new_table[bucket] = entry;
+
+            entry = next;
+        }
+    }
+
+    // drop the old table but dont drop the values
+    free(map->table);
+
+    map->table = new_table;
+    map->table_size = new_table_size;
+
+    return Success;
+}
+
+/** rehash the whole table to a new size
+ *
+ * this can grow or shrink the table, the new size has to fit all the entrys,
+ * every rehash goes through here so it is counted in the stats, the backends
+ * that grow on their own call it too, rehash_count only counts the ones that
+ * worked but the time of a failed one is still a pause
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param new_table_size
+ *  the new table size, a power of two
+ */
+enum HashMapResult resize_hashmap(HashMapBase *map, int new_table_size) {
+    enum HashMapResult result = FailedToInsert;
+
+    uint64_t start = _now_ns();
+
+    switch (map->backend) {
+        case HashMapChained:
+            result = rehash_chained(map, new_table_size);
+            break;
+        case HashMapOpen:
+            result = rehash_open(map, new_table_size);
+            break;
+        case HashMapSwiss:
+            result = rehash_swiss(map, new_table_size);
+            break;
+        case HashMapCompact:
+            result = rehash_compact(map, new_table_size);
+            break;
+        case HashMapCuckoo:
+            result = rehash_cuckoo(map, new_table_size);
+            break;
+        case HashMapMapped:
+            return FailedToInsert;
+    }
+
+    if (result == Success) {
+        ++map->rehash_count;
+    }
+
+    map->threshold = _threshold_for(map->table_size, map->max_load_factor);
+
+    _record_pause(map, start);
+
+    return result;
+}
+
+/** rehash the whole table
+ *
+ * this will rehash the whole table to a bigger size based on the maps
+ * growth_factor
+ *
+ * @param map
+ *  the hashmap base
+ */
+enum HashMapResult rehash_hashmap(HashMapBase *map) {
+    if (map->table_size > MAX_TABLE_SIZE / map->growth_factor) {
+        return FailedToRehashNoMemory;
+    }
+
+    return resize_hashmap(map, map->table_size * map->growth_factor);
+}
+
+/** make sure the map can hold capacity entrys without growing
+ *
+ * the table is never made smaller here, see shrink_to_fit_hashmap_base
+ *
+ * with incremental rehashing on the table is moved over the next operations
+ * like any other rehash
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param capacity
+ *  the amount of entrys the map should hold
+ */
+enum HashMapResult reserve_hashmap_base(HashMapBase *map, size_t capacity) {
+    int size = _table_size_for(map->backend, map->max_load_factor, capacity);
+
+    if (size == 0) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (size <= map->table_size) {
+        return Success;
+    }
+
+    return resize_hashmap(map, size);
+}
+
+/** shrink the table to the smallest size that holds the current entrys
+ *
+ * removing entrys never shrinks the table on its own, this can be called after
+ * removing a lot of them to give the memory back
+ *
+ * @param map
+ *  the hashmap base
+ */
+enum HashMapResult shrink_to_fit_hashmap_base(HashMapBase *map) {
+    int size =
+        _table_size_for(map->backend, map->max_load_factor, map->current_size);
+
+    if (size == 0 || size >= map->table_size) {
+        return Success;
+    }
+
+    return resize_hashmap(map, size);
+}
+
+/** set how full the table gets and how much it grows by
+ *
+ * if the map is already fuller than the new load factor it grows on the next
+ * insert
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param max_load_factor
+ *  entrys per slot before the table grows, for the chained backend this can be
+ *  up to 4, the open backend up to 0.95, compact and cuckoo up to 0.9 and swiss
+ *  up to 0.85 as it keeps room for its deleted markers
+ *
+ * @param growth_factor
+ *  how many times bigger the table gets when it grows, a power of two from 2 to
+ *  16
+ *
+ * @return
+ *  false if one of the factors is out of range for the backend
+ */
+bool set_load_factor_hashmap_base(HashMapBase *map, double max_load_factor,
+                                  int growth_factor) {
+    double max = 4;
+
+    if (map->backend == HashMapMapped) {
+        return false;
+    } else if (map->backend == HashMapOpen) {
+        max = 0.95;
+    } else if (map->backend == HashMapCompact ||
+               map->backend == HashMapCuckoo) {
+        max = 0.9;
+    } else if (map->backend == HashMapSwiss) {
+        max = 0.85;
+    }
+
+    if (!(max_load_factor > 0 && max_load_factor <= max) ||
+        growth_factor < 2 || growth_factor > 16 ||
+        (growth_factor & (growth_factor - 1)) != 0) {
+        return false;
+    }
+
+    map->max_load_factor = max_load_factor;
+    map->growth_factor = growth_factor;
+    map->threshold = _threshold_for(map->table_size, max_load_factor);
+
+    return true;
+}
+
+/* check the stored hash first so comp_func is only called on likely matches */
+static inline bool _entry_matches(HashMapBase *map, Entry *entry,
+                                  uint64_t hash, void *key) {
+    return entry->hash == hash && map->comp_func(entry->key, key);
+}
+
+/** find the link in a chain that points to the entry for a key
+ *
+ * if a rehash is in progress the old table is checked first, for buckets that
+ * have not been moved yet
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the full hash of the key
+ *
+ * @param key
+ *  the key to look for
+ *
+ * @param probes
+ *  set to the amount of entrys that were compared
+ *
+ * @return
+ *  the link to the entry, if the key is not found this points to the NULL at
+ *  the end of the keys chain in the new table so an entry can be added there
+ */
+static inline Entry **_find_link(HashMapBase *map, uint64_t hash, void *key,
+                                 int *probes) {
+    Entry **link;
+
+    *probes = 0;
+
+    if (map->old_table) {
+        int bucket = hash & (map->old_table_size - 1);
+
+        if (bucket >= map->migrate_index) {
+            link = &map->old_table[bucket];
+
+            while (*link && !_entry_matches(map, *link, hash, key)) {
+                link = &(*link)->next;
+                ++*probes;
+            }
+
+            if (*link) {
+                ++*probes;
+                COUNT_LOOKUP(map, true, *probes);
+                return link;
+            }
+        }
+    }
+
+    link = &map->table[hash & (map->table_size - 1)];
+
+    while (*link && !_entry_matches(map, *link, hash, key)) {
+        link = &(*link)->next;
+        ++*probes;
+    }
+
+    // the probes are the entrys compared, a hit compares its own entry too
+    *probes += *link != NULL;
+
+    COUNT_LOOKUP(map, *link != NULL, *probes);
+
+    return link;
+}
+
+/* _find_link for the callers that dont need the probes */
+Entry **find_link_chained(HashMapBase *map, uint64_t hash, void *key) {
+    int probes;
+
+    return _find_link(map, hash, key, &probes);
+}
+
+/* hash every key again with the seed of the map, the table is left as it is */
+static void _rehash_keys(HashMapBase *map) {
+    switch (map->backend) {
+        case HashMapChained: {
+            for (int i = 0; i < map->table_size; ++i) {
+                for (Entry *entry = map->table[i]; entry; entry = entry->next) {
+                    entry->hash = hash_key(map, entry->key);
+                }
+            }
+            break;
+        }
+        case HashMapOpen:
+        case HashMapSwiss:
+        case HashMapCompact:
+        case HashMapCuckoo: {
+            int end = map->backend == HashMapCompact ? map->entries_used
+                                                     : map->table_size;
+
+            for (int i = 0; i < end; ++i) {
+                Slot *slot = &map->slots[i];
+
+                // an empty open or compact slot has a hash of 0, the swiss
+                // and cuckoo backends use their control bytes
+                bool full = slot->hash != 0;
+
+                if (map->backend == HashMapSwiss) {
+                    full = map->ctrl[i] < 0x80;
+                } else if (map->backend == HashMapCuckoo) {
+                    full = map->ctrl[i] != 0;
+                }
+
+                if (full) {
+                    slot->hash = robin_slot_hash(hash_key(map, slot->key));
+                }
+            }
+            break;
+        }
+        case HashMapMapped:
+            break;
+    }
+}
+
+/** pick a new seed and rehash every key with it
+ *
+ * this runs at the start of the insert after one that had to probe past
+ * FLOOD_PROBE_LENGTH, a long probe is either very bad luck or keys that were
+ * picked to collide under the old seed, either way a new seed spreads them out
+ *
+ * the stored hashes have the old seed in them so every key goes through the
+ * hash_func again, to keep that amortized like a rehash the map has to double
+ * in size before it can reseed again, so keys that get the exact same hash
+ * from the hash_func, which no seed can fix, do not reseed on every insert
+ *
+ * @param map
+ *  the hashmap base, it is not reseeded while there are iters
+ */
+static void _reseed_hashmap(HashMapBase *map) {
+    map->flooded = false;
+
+    if (map->current_size < map->reseed_size || map->active_iters > 0) {
+        return;
+    }
+
+    // the old table is placed by the old hashes so it has to be moved first
+    if (map->old_table) {
+        _finish_migration(map);
+    }
+
+    uint64_t old_seed = map->seed;
+
+    map->seed = new_seed();
+
+    _rehash_keys(map);
+
+    // rebuild at the same size in one go, even with incremental rehashing on
+    bool incremental = map->incremental;
+
+    map->incremental = false;
+
+    enum HashMapResult result = resize_hashmap(map, map->table_size);
+
+    map->incremental = incremental;
+
+    // the table is still placed by the old seed
+    if (result != Success) {
+        map->seed = old_seed;
+
+        _rehash_keys(map);
+        return;
+    }
+
+    map->reseed_size = map->current_size * 2;
+    ++map->reseed_count;
+}
+
+/** find the value for a key that has already been hashed, adding the key if
+ * it is not there
+ *
+ * this is the one lookup inserts, upserts and the entry api all go through,
+ * it will rehash the table when it reaches the maps max_load_factor
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the key to find, if it is added this pointer is stored as the key
+ *
+ * @param found
+ *  set to true if the key was already in the map, a new key has a NULL value
+ *
+ * @param result
+ *  set to Success or to why the key could not be added
+ *
+ * @return
+ *  a pointer to where the value is stored or NULL if the key could not be
+ *  added, this is only valid until the map is changed
+ */
+void **entry_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key,
+                            bool *found, enum HashMapResult *result) {
+    *found = false;
+    *result = Success;
+
+    // a snapshot is read only
+    if (map->backend == HashMapMapped) {
+        *result = FailedToInsert;
+        return NULL;
+    }
+
+    if (map->flooded) {
+        _reseed_hashmap(map);
+    }
+
+    hash = seed_hash(map, hash);
+
+    // check if we need to resize
+    if (map->current_size + 1 >= map->threshold) {
+        *result = rehash_hashmap(map);
+
+        // if resizing failed
+        if (*result != Success) {
+            return NULL;
+        }
+    }
+
+    if (map->backend != HashMapChained) {
+        Slot *slot = NULL;
+
+        if (map->referenced) {
+            slot = entry_cache(map, hash, key, found);
+        } else if (map->backend == HashMapOpen) {
+            slot = entry_open(map, hash, key, found);
+        } else if (map->backend == HashMapSwiss) {
+            slot = entry_swiss(map, hash, key, found);
+        } else if (map->backend == HashMapCuckoo) {
+            slot = entry_cuckoo(map, hash, key, found);
+        } else {
+            slot = entry_compact(map, hash, key, found);
+        }
+
+        // the cuckoo backend marks the map as flooded when a key has no room
+        // and growing would not help
+        if (slot == NULL) {
+            *result = map->flooded ? FailedToInsert : FailedToRehashNoMemory;
+            return NULL;
+        }
+
+        if (!*found) {
+            ++map->current_size;
+        }
+
+        return &slot->value;
+    }
+
+    _rehash_step(map);
+
+    int probes;
+    Entry **link = _find_link(map, hash, key, &probes);
+
+    if (*link != NULL) {
+        *found = true;
+        return &(*link)->value;
+    }
+
+    CHECK_FLOODING(map, probes);
+
+    Entry *entry = create_entry(map, key, NULL, hash);
+
+    if (entry == NULL) {
+        *result = FailedToInsertNoMemory;
+        return NULL;
+    }
+
+    // the link is the end of the chain in the new table
+    *link = entry;
+
+    ++map->current_size;
+
+    return &entry->value;
+}
+
+/** insert a key that has already been hashed
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the new key to be inserted in to the hashmap
+ *
+ * @param value
+ *  the new value to be inserted in to the hasmap
  */
-enum HashMapResult _insert_hashmap(HashMapBase *map, Entry *entry) {
-    uint64_t key_hash = map->hash_func(entry->key) & (map->table_size - 1);
+enum HashMapResult insert_hashmap_hashed(HashMapBase *map, uint64_t hash,
+                                         void *key, void *value) {
+    enum HashMapResult result;
+    bool found;
 
-    // if the bucket entry is null then set the new entry as the start of the
-    // linked list for the given bucket
-    if (map->table[key_hash] == NULL) {
-        map->table[key_hash] = entry;
+    void **slot = entry_hashmap_hashed(map, hash, key, &found, &result);
 
-        return Success;
-    }
-
-    /*
-     * if there is data in a given bucket see if there is a matching key if not
-     * then add the new entry to the end of the buckets list
-     */
-
-    bool found = false;
-
-    Entry *table_entry = map->table[key_hash];
-
-    // check all entrys in the list
-    //
-    // if we are at the first entry and next is null the we skip the loop and go
-    // to the last key check
-    // else we check the key in the loop
-    while (table_entry->next != NULL && !found) {
-        // check if key is already in the table
-        if (map->comp_func(table_entry->key, entry->key)) {
-            found = true;
-        } else {
-            table_entry = table_entry->next;
-        }
+    if (slot == NULL) {
+        return result;
     }
 
-    // now check the last (or first) entry in the list for duplicates
-    if (found || map->comp_func(table_entry->key, entry->key)) {
+    if (found) {
         return FailedToInsertDuplicate;
     }
 
-    // just add the entry to the end of the list if there isn't a duplicate
-    table_entry->next = entry;
+    *slot = value;
 
-    // let the user know it was successful
     return Success;
 }
 
-/** rehash the whole table
+/** the insert entry point
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param key
+ *  the new key to be inserted in to the hashmap
+ *
+ * @param value
+ *  the new value to be inserted in to the hasmap
+ */
+enum HashMapResult insert_hashmap_base(HashMapBase *map, void *key,
+                                       void *value) {
+    return insert_hashmap_hashed(map, map->hash_func(key), key, value);
+}
+
+/** get the value slot for a key with one lookup
  *
- * this will rehash the whole table to a bigger size based on the GROWTH_FACTOR
+ * if the key is not in the map it is added with a NULL value, either way the
+ * caller can read or write the value through the returned pointer, so an
+ * insert or update or a get or create only hashes and probes once
  *
- * this will not reallocate entrys, this i kind of dangerous as it will leave
- * chains/linked lists half made if there is ever a problem
+ * the pointer is only valid until the next change to the map
  *
  * @param map
  *  the hashmap base
+ *
+ * @param key
+ *  the key to look up, if it is added this pointer is stored as the key
+ *
+ * @param found
+ *  set to true if the key was already in the map
+ *
+ * @return
+ *  a pointer to the value or NULL if there was no memory to add the key
  */
-enum HashMapResult rehash_hashmap(HashMapBase *map) {
-    enum HashMapResult result = Success;
+void **entry_hashmap_base(HashMapBase *map, void *key, bool *found) {
+    enum HashMapResult result;
 
-    // get the new table size
-    int new_table_size = map->table_size * GROWTH_FACTOR;
+    return entry_hashmap_hashed(map, map->hash_func(key), key, found, &result);
+}
 
-    // get a new base map with a larger table to insert in to
-    HashMapBase *temp_map = init_hashmap_base(map->hash_func, map->comp_func,
-                                              map->drop_func, new_table_size);
-    if (temp_map == NULL) {
-        return FailedToRehashNoMemory;
-    }
+/** insert a key or replace the value if the key is already there
+ *
+ * when the key is already in the map the old key is kept and the new key
+ * pointer is not stored
+ *
+ * @param old_value
+ *  NULL or a pointer that is set to the value that was replaced, NULL if the
+ *  key is new, the map does not drop the old value
+ */
+enum HashMapResult upsert_hashmap_base(HashMapBase *map, void *key,
+                                       void *value, void **old_value) {
+    enum HashMapResult result;
+    bool found;
 
-    Entry *entry = NULL;
-    Entry *temp_entry = NULL;
+    void **slot =
+        entry_hashmap_hashed(map, map->hash_func(key), key, &found, &result);
 
-    // go though the entry table rehashing all the entrys
-    for (int i = 0; i < map->table_size && result == Success; ++i) {
-        // iterate over the buckets linked list
-        entry = map->table[i];
+    if (old_value) {
+        *old_value = found ? *slot : NULL;
+    }
 
-        while (entry != NULL && result == Success) {
-            temp_entry = entry->next;
+    if (slot != NULL) {
+        *slot = value;
+    }
 
-            // this is necessary else the insert function might/will find the
-            // same entry its trying to rehash
-            //
-            // though this is also dangerous as it will leave the old table
-            // incomplete if there is an issue inserting or rehashing
-            entry->next = NULL;
+    return result;
+}
 
-            result = _insert_hashmap(temp_map, entry);
+/** get the value for a key or insert the given value if the key is not there
+ *
+ * @return
+ *  the value in the map after the call, NULL if the key could not be added
+ */
+void *get_or_insert_hashmap_base(HashMapBase *map, void *key, void *value) {
+    bool found;
+    void **slot = entry_hashmap_base(map, key, &found);
 
-            entry = temp_entry;
-        }
+    if (slot == NULL) {
+        return NULL;
     }
 
-    // if there was an error drop the temp and let the user know
-    if (result != Success) {
-        // dont free the entrys as data will still be in the original table and
-        // the user might want to do something with them
-        //
-        // TODO: this wont work right now, but I might switch to open addressing
-        // so the table wont be left in an incomplete state if there are errors
-        // during the rehashing
-        free(temp_map->table);
-        free(temp_map);
-
-    } else { // assign the new table to the user's hashmap
-
-        // drop the old table but dont drop the values
-        free(map->table);
+    if (!found) {
+        *slot = value;
+    }
 
-        // set the new table to the old hashmap
-        map->table = temp_map->table;
-        map->table_size = temp_map->table_size;
+    return *slot;
+}
 
-        // drop the temp map
-        free(temp_map);
+/** find the slot for a key in the backends that use slots
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the key to find
+ */
+static Slot *_find_slot(HashMapBase *map, uint64_t hash, void *key) {
+    switch (map->backend) {
+        case HashMapOpen:
+            return find_slot_open(map, hash, key);
+        case HashMapSwiss:
+            return find_slot_swiss(map, hash, key);
+        case HashMapCompact:
+            return find_slot_compact(map, hash, key);
+        case HashMapCuckoo:
+            return find_slot_cuckoo(map, hash, key);
+        case HashMapChained:
+        case HashMapMapped:
+            break;
     }
 
-    return result;
+    return NULL;
 }
 
-/** the insert entry point
- *
- * this will rehash when the table when it reaches the MAX_LOAD_FACTOR
+/** check if a key that has already been hashed is in the table
  *
  * @param map
  *  the hashmap base
  *
- * @param key
- *  the new key to be inserted in to the hashmap
+ * @param hash
+ *  the result of the hash_func for the key
  *
- * @param value
- *  the new value to be inserted in to the hasmap
+ * @param key
+ *  the key to check
  */
-enum HashMapResult insert_hashmap_base(HashMapBase *map, void *key,
-                                       void *value) {
-    enum HashMapResult result = Success;
+bool contains_key_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key) {
+    hash = seed_hash(map, hash);
 
-    // check if we need to resize
-    if ((map->current_size + 1) ==
-        (int)floor(map->table_size * MAX_LOAD_FACTOR)) {
+    if (map->backend == HashMapMapped) {
+        bool found;
 
-        result = rehash_hashmap(map);
-    }
+        find_value_mapped(map, hash, key, &found);
 
-    // if resizing failed
-    if (result != Success) {
-        return result;
+        return found;
     }
 
-    Entry *entry = create_entry(key, value);
-
-    if (entry == NULL) {
-        return FailedToInsertNoMemory;
-    }
+    if (map->backend != HashMapChained) {
+        Slot *slot = _find_slot(map, hash, key);
 
-    result = _insert_hashmap(map, entry);
+        if (map->referenced) {
+            count_cache_lookup(map, slot);
+        }
 
-    if (result != Success) {
-        return result;
+        return slot != NULL;
     }
 
-    // only increment if we know _insert_hashmap succeeded
-    ++map->current_size;
+    _rehash_step(map);
 
-    return Success;
+    return *find_link_chained(map, hash, key) != NULL;
 }
 
 /** check is a key is in the table
@@ -306,152 +1173,239 @@ enum HashMapResult insert_hashmap_base(HashMapBase *map, void *key,
  *  the key to check
  */
 bool contains_key_hashmap_base(HashMapBase *map, void *key) {
-    uint64_t key_hash = map->hash_func(key) & (map->table_size - 1);
+    return contains_key_hashmap_hashed(map, map->hash_func(key), key);
+}
 
-    bool found = false;
+/* get the value for a key that has already been hashed */
+void *get_value_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key) {
+    hash = seed_hash(map, hash);
 
-    Entry *entry = map->table[key_hash];
+    if (map->backend == HashMapMapped) {
+        bool found;
 
-    while (entry != NULL && !found) {
-        if (map->comp_func(entry->key, key)) {
-            found = true;
-        } else {
-            entry = entry->next;
-        }
+        return find_value_mapped(map, hash, key, &found);
     }
 
-    return found;
-}
-
-void *get_value_hashmap_base(HashMapBase *map, void *key) {
-    uint64_t key_hash = map->hash_func(key) & (map->table_size - 1);
-
-    void *value = NULL;
-    Entry *entry = map->table[key_hash];
+    if (map->backend != HashMapChained) {
+        Slot *slot = _find_slot(map, hash, key);
 
-    while (entry != NULL && value == NULL) {
-        if (map->comp_func(entry->key, key)) {
-            value = entry->value;
-        } else {
-            entry = entry->next;
+        if (map->referenced) {
+            count_cache_lookup(map, slot);
         }
+
+        return slot ? slot->value : NULL;
     }
 
-    return value;
+    _rehash_step(map);
+
+    Entry *entry = *find_link_chained(map, hash, key);
+
+    return entry ? entry->value : NULL;
 }
 
-/** delete the entry for the given key
+void *get_value_hashmap_base(HashMapBase *map, void *key) {
+    return get_value_hashmap_hashed(map, map->hash_func(key), key);
+}
+
+/** delete the entry for a key that has already been hashed
+ *
+ * the key is passed to the drop_func and the value is returned to the user
  *
  * @param map
  *  the hashmap base
  *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
  * @param key
  *  the key to find and remove
  */
-// TODO: this could probably be improved but will also change a lot if i switch
-// to open addressing
-void *remove_entry_hashmap_base(HashMapBase *map, void *key) {
-    uint64_t key_hash = map->hash_func(key) & (map->table_size - 1);
+void *remove_entry_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key) {
+    hash = seed_hash(map, hash);
+
+    switch (map->backend) {
+        case HashMapOpen:
+            return remove_entry_open(map, hash, key);
+        case HashMapSwiss:
+            return remove_entry_swiss(map, hash, key);
+        case HashMapCompact:
+            return remove_entry_compact(map, hash, key);
+        case HashMapCuckoo:
+            return remove_entry_cuckoo(map, hash, key);
+        case HashMapMapped:
+            return NULL;
+        case HashMapChained:
+            break;
+    }
 
-    bool stop = false;
+    _rehash_step(map);
 
     void *value = NULL;
 
-    Entry *prev;
-    Entry *entry = map->table[key_hash];
-
-    if (entry && map->comp_func(entry->key, key)) {
-
-        stop = true;
-
-        map->table[key_hash] = entry->next;
-
-        value = entry->value;
-
-        if (map->drop_func) {
-            map->drop_func((void *)entry->key, NULL);
-        }
-        free(entry);
+    // point at the link that points to the entry so the first entry in the
+    // bucket does not need to be handled on its own
+    Entry **link = find_link_chained(map, hash, key);
 
-        entry = NULL;
+    Entry *entry = *link;
 
-        --map->current_size;
-        return value;
+    if (entry == NULL) {
+        return NULL;
     }
 
-    prev = entry;
-    entry = NULL;
-
-    while (entry && !stop) {
-        if (map->comp_func(entry->key, key)) {
-            stop = true;
-
-            value = entry->value;
-            prev->next = entry->next;
+    *link = entry->next;
 
-            map->drop_func((void *)entry->key, NULL);
-            free(entry);
+    value = entry->value;
 
-            entry = NULL;
-        } else {
-            prev = entry;
-
-            entry = entry->next;
-        }
+    if (map->drop_func) {
+        map->drop_func((void *)entry->key, NULL);
     }
 
+    pool_free_entry(&map->pool, entry);
+
     --map->current_size;
+
     return value;
 }
 
+/** delete the entry for the given key
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param key
+ *  the key to find and remove
+ */
+void *remove_entry_hashmap_base(HashMapBase *map, void *key) {
+    return remove_entry_hashmap_hashed(map, map->hash_func(key), key);
+}
+
 /** get an iterator struct for a hashmap
  *
  * @param map
  *  the hashmap base
  */
 IterHashMap *get_iter_hashmap_base(HashMapBase *map) {
+    return get_iter_range_hashmap_base(map, 0, -1);
+}
+
+/** get an iterator over a range of the buckets
+ *
+ * the ranges of one map can be handed to different threads as long as nothing
+ * changes the map while they run, see get_bucket_count_hashmap_base for how
+ * many buckets there are
+ *
+ * the for_each_drop loop should only be used on an iter over all the buckets
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param begin_bucket
+ *  the first bucket
+ *
+ * @param end_bucket
+ *  the bucket after the last one or -1 to go to the end
+ */
+IterHashMap *get_iter_range_hashmap_base(HashMapBase *map, int begin_bucket,
+                                         int end_bucket) {
     IterHashMap *iter = malloc(sizeof(IterHashMap));
 
     if (iter == NULL) {
         return NULL;
     }
 
-    iter->current_index = -1;
+    iter->begin_index = begin_bucket;
+    iter->end_index = end_bucket;
+
+    iter->current_index = begin_bucket - 1;
     iter->current_entry = NULL;
 
     iter->base = map;
 
+    // hold any incremental rehash while the iter is alive
+    ++map->active_iters;
+
     return iter;
 }
 
+/** the amount of buckets an iter can cover
+ *
+ * this is the table size, during an incremental rehash of the chained backend
+ * the old table is counted as well and for the compact backend it is the
+ * length of the dense array
+ */
+int get_bucket_count_hashmap_base(HashMapBase *map) {
+    if (map->backend == HashMapCompact) {
+        return map->entries_used;
+    }
+
+    return map->table_size + (map->old_table ? map->old_table_size : 0);
+}
+
 /** free the hashmap struct
  *
  * @param iter
  *  the hashmap iter struct
  */
 void drop_iter_hashmap(IterHashMap *iter) {
+    --iter->base->active_iters;
+
     free(iter);
 }
 
+/* get a chained bucket for the iter
+ *
+ * during an incremental rehash the indexes past the new table are the buckets
+ * of the old table
+ */
+static inline Entry *_iter_bucket(HashMapBase *map, int index) {
+    if (index < map->table_size) {
+        return map->table[index];
+    }
+
+    return map->old_table[index - map->table_size];
+}
+
 void _iter_next_base(IterHashMap *iter) {
+    switch (iter->base->backend) {
+        case HashMapOpen:
+            iter_next_base_open(iter);
+            return;
+        case HashMapSwiss:
+            iter_next_base_swiss(iter);
+            return;
+        case HashMapCompact:
+            iter_next_base_compact(iter);
+            return;
+        case HashMapCuckoo:
+            iter_next_base_cuckoo(iter);
+            return;
+        case HashMapMapped:
+            iter_next_base_mapped(iter);
+            return;
+        case HashMapChained:
+            break;
+    }
+
+    HashMapBase *map = iter->base;
+    int end = iter_end(iter);
+
     // get to the next table index so we dont hit the current entry again
     ++iter->current_index;
 
-    if (iter->current_index >= iter->base->table_size) {
-        iter->current_entry = NULL;
-    }
+    // if there are no more full buckets the iteration is over
+    iter->current_entry = NULL;
 
     // find the next full bucket
-    while (iter->current_index < iter->base->table_size &&
-           iter->base->table[iter->current_index] == NULL) {
+    while (iter->current_index < end &&
+           _iter_bucket(map, iter->current_index) == NULL) {
 
         ++iter->current_index;
     }
 
     // set the new current_entry if we are in bounds
-    if (iter->current_index < iter->base->table_size) {
+    if (iter->current_index < end) {
         // set the new current_entry
-        iter->current_entry = iter->base->table[iter->current_index];
+        iter->current_entry = _iter_bucket(map, iter->current_index);
     }
 }
 
@@ -473,6 +1427,21 @@ void _iter_next_base(IterHashMap *iter) {
  *   iterated over during the for each loop
  */
 bool iter_next_hashmap(IterHashMap *iter, void **key, void **value) {
+    switch (iter->base->backend) {
+        case HashMapOpen:
+            return iter_next_open(iter, key, value);
+        case HashMapSwiss:
+            return iter_next_swiss(iter, key, value);
+        case HashMapCompact:
+            return iter_next_compact(iter, key, value);
+        case HashMapCuckoo:
+            return iter_next_cuckoo(iter, key, value);
+        case HashMapMapped:
+            return iter_next_mapped(iter, key, value);
+        case HashMapChained:
+            break;
+    }
+
     bool got_value = false;
 
     if (iter->current_entry) {
@@ -495,6 +1464,22 @@ bool iter_next_hashmap(IterHashMap *iter, void **key, void **value) {
 }
 
 bool iter_next_drop_hashmap(IterHashMap *iter, void **key, void **value) {
+    switch (iter->base->backend) {
+        case HashMapOpen:
+            return iter_next_drop_open(iter, key, value);
+        case HashMapSwiss:
+            return iter_next_drop_swiss(iter, key, value);
+        case HashMapCompact:
+            return iter_next_drop_compact(iter, key, value);
+        case HashMapCuckoo:
+            return iter_next_drop_cuckoo(iter, key, value);
+        case HashMapMapped:
+            // the keys and values are in the file so there is nothing to free
+            return iter_next_mapped(iter, key, value);
+        case HashMapChained:
+            break;
+    }
+
     bool got_value = false;
 
     if (iter->current_entry) {
@@ -507,7 +1492,7 @@ bool iter_next_drop_hashmap(IterHashMap *iter, void **key, void **value) {
         Entry *temp = iter->current_entry;
         iter->current_entry = iter->current_entry->next;
 
-        free(temp);
+        pool_free_entry(&iter->base->pool, temp);
 
         if (iter->current_entry == NULL) {
             _iter_next_base(iter);
@@ -515,7 +1500,10 @@ bool iter_next_drop_hashmap(IterHashMap *iter, void **key, void **value) {
 
         if (iter->current_entry == NULL) {
             free(iter->base->table);
+            free(iter->base->old_table);
+
             iter->base->table = NULL;
+            iter->base->old_table = NULL;
         }
     }
 
@@ -523,14 +1511,30 @@ bool iter_next_drop_hashmap(IterHashMap *iter, void **key, void **value) {
 }
 
 int get_longest_chain_base(HashMapBase *map) {
+    switch (map->backend) {
+        case HashMapOpen:
+            return get_longest_chain_open(map);
+        case HashMapSwiss:
+            return get_longest_chain_swiss(map);
+        case HashMapCompact:
+            return get_longest_chain_compact(map);
+        case HashMapCuckoo:
+            return get_longest_chain_cuckoo(map);
+        case HashMapMapped:
+            return get_longest_chain_mapped(map);
+        case HashMapChained:
+            break;
+    }
+
     int counter = 0;
     int longest = 0;
+    int end = map->table_size + (map->old_table ? map->old_table_size : 0);
 
     Entry *entry = NULL;
 
-    for (int i = 0; i < map->table_size; ++i) {
+    for (int i = 0; i < end; ++i) {
         counter = 0;
-        entry = map->table[i];
+        entry = _iter_bucket(map, i);
 
         while (entry != NULL) {
             ++counter;
@@ -545,6 +1549,120 @@ int get_longest_chain_base(HashMapBase *map) {
     return longest;
 }
 
+/* the layout stats for the chained backend, both tables during a rehash */
+static void _get_stats_chained(HashMapBase *map, HashMapStats *stats) {
+    int end = map->table_size + (map->old_table ? map->old_table_size : 0);
+    int buckets = 0;
+    int empty = 0;
+    uint64_t hit_probes = 0;
+
+    for (int i = 0; i < end; ++i) {
+        // the moved buckets of the old table are not really buckets anymore
+        if (i >= map->table_size &&
+            i - map->table_size < map->migrate_index) {
+            continue;
+        }
+
+        int length = 0;
+
+        for (Entry *entry = _iter_bucket(map, i); entry; entry = entry->next) {
+            ++length;
+
+            hit_probes += length;
+        }
+
+        if (length == 0) {
+            ++empty;
+        }
+
+        ++buckets;
+        stats_add_length(stats, length);
+    }
+
+    stats->empty_fraction = (double)empty / buckets;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+
+    // a miss compares every entry in its chain
+    stats->miss_probes = (double)map->current_size / buckets;
+    stats->bytes_used = sizeof(Entry *) * buckets + pool_bytes(&map->pool);
+}
+
+/** get the stats for a hashmap
+ *
+ * this walks the whole table so it is about as slow as iterating, it should
+ * be called every now and then to export to metrics and not on every request
+ *
+ * the lookup counters are only kept when the library is built with
+ * HASHMAP_STATS defined, for example with make CFLAGS="-DHASHMAP_STATS", they
+ * cost an add or two per lookup
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param stats
+ *  the struct to fill in
+ */
+void get_stats_hashmap_base(HashMapBase *map, HashMapStats *stats) {
+    memset(stats, 0, sizeof(HashMapStats));
+
+    switch (map->backend) {
+        case HashMapChained:
+            _get_stats_chained(map, stats);
+            break;
+        case HashMapOpen:
+            get_stats_open(map, stats);
+            break;
+        case HashMapSwiss:
+            get_stats_swiss(map, stats);
+            break;
+        case HashMapCompact:
+            get_stats_compact(map, stats);
+            break;
+        case HashMapCuckoo:
+            get_stats_cuckoo(map, stats);
+            break;
+        case HashMapMapped:
+            get_stats_mapped(map, stats);
+            break;
+    }
+
+    stats->size = map->current_size;
+    stats->table_size = map->table_size;
+
+    if (map->backend == HashMapSwiss) {
+        stats->deleted_size = map->deleted_size;
+    }
+
+    stats->load_factor = (double)map->current_size / map->table_size;
+
+    stats->hit_lookups = map->lookups[1];
+    stats->miss_lookups = map->lookups[0];
+
+    if (map->lookups[1]) {
+        stats->measured_hit_probes =
+            (double)map->lookup_probes[1] / map->lookups[1];
+    }
+
+    if (map->lookups[0]) {
+        stats->measured_miss_probes =
+            (double)map->lookup_probes[0] / map->lookups[0];
+    }
+
+    stats->rehash_count = map->rehash_count;
+    stats->rehash_ns = map->rehash_ns;
+    stats->max_pause_ns = map->max_pause_ns;
+    stats->reseed_count = map->reseed_count;
+
+    stats->cache_hits = map->cache_hits;
+    stats->cache_misses = map->cache_misses;
+    stats->cache_evictions = map->cache_evictions;
+
+    stats->bytes_used += sizeof(HashMapBase);
+    stats->bytes_per_entry =
+        map->current_size ? (double)stats->bytes_used / map->current_size : 0;
+}
+
 /* this was taken from
  * https://github.com/DavidLeeds/hashmap/
  * blob/137d60b3818c22c79d2be5560150eb2eff981a68/src/hashmap.c#L601
@@ -577,6 +1695,133 @@ size_t data_hash64(const void *data, size_t len) {
     return hash;
 }
 
+/* wyhash needs the full 128 bit product of two 64 bit ints */
+__extension__ typedef unsigned __int128 uint128_t;
+
+/* the default secret from wyhash */
+static const uint64_t wy_secret[4] = {
+    UINT64_C(0x2d358dccaa6c78a5),
+    UINT64_C(0x8bb84b93962eacc9),
+    UINT64_C(0x4b33a62ed433d4a3),
+    UINT64_C(0x4d5a2da51de1aa47),
+};
+
+/* multiply and fold the 128 bit result back in to 64 bits */
+static inline uint64_t _wy_mix(uint64_t a, uint64_t b) {
+    uint128_t product = (uint128_t)a * b;
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/* the reads use memcpy so the data does not need to be aligned */
+static inline uint64_t _wy_read8(const uint8_t *data) {
+    uint64_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+static inline uint64_t _wy_read4(const uint8_t *data) {
+    uint32_t value;
+
+    memcpy(&value, data, sizeof(value));
+
+    return value;
+}
+
+/* read 1 to 3 bytes */
+static inline uint64_t _wy_read3(const uint8_t *data, size_t len) {
+    return ((uint64_t)data[0] << 16) | ((uint64_t)data[len >> 1] << 8) |
+           data[len - 1];
+}
+
+/** fast hash function for data keys
+ *
+ * this is wyhash (final version 4) from https://github.com/wangyi-fudan/wyhash
+ * which is public domain
+ *
+ * unlike data_hash64 this reads 8 to 16 bytes per step, keys over 48 bytes are
+ * hashed in three independent lanes so the multiplies can run in parallel
+ * instead of waiting on each other
+ *
+ * the output depends on the byte order of the machine
+ *
+ * @param data
+ *  a pointer to the data to hash
+ *
+ * @param len
+ *  the length of the data in bytes
+ *
+ * @param seed
+ *  a seed to mix in to the hash, different seeds give unrelated hashes
+ */
+uint64_t fast_hash64(const void *data, size_t len, uint64_t seed) {
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint64_t a;
+    uint64_t b;
+
+    seed ^= _wy_mix(seed ^ wy_secret[0], wy_secret[1]);
+
+    if (len <= 16) {
+        if (len >= 4) {
+            size_t offset = (len >> 3) << 2;
+
+            a = (_wy_read4(bytes) << 32) | _wy_read4(bytes + offset);
+            b = (_wy_read4(bytes + len - 4) << 32) |
+                _wy_read4(bytes + len - 4 - offset);
+        } else if (len > 0) {
+            a = _wy_read3(bytes, len);
+            b = 0;
+        } else {
+            a = 0;
+            b = 0;
+        }
+    } else {
+        size_t left = len;
+
+        if (left > 48) {
+            uint64_t seed_1 = seed;
+            uint64_t seed_2 = seed;
+
+            do {
+                seed = _wy_mix(_wy_read8(bytes) ^ wy_secret[1],
+                               _wy_read8(bytes + 8) ^ seed);
+                seed_1 = _wy_mix(_wy_read8(bytes + 16) ^ wy_secret[2],
+                                 _wy_read8(bytes + 24) ^ seed_1);
+                seed_2 = _wy_mix(_wy_read8(bytes + 32) ^ wy_secret[3],
+                                 _wy_read8(bytes + 40) ^ seed_2);
+
+                bytes += 48;
+                left -= 48;
+            } while (left > 48);
+
+            seed ^= seed_1 ^ seed_2;
+        }
+
+        while (left > 16) {
+            seed = _wy_mix(_wy_read8(bytes) ^ wy_secret[1],
+                           _wy_read8(bytes + 8) ^ seed);
+
+            bytes += 16;
+            left -= 16;
+        }
+
+        // the last 16 bytes, these can overlap with the ones already read
+        a = _wy_read8(bytes + left - 16);
+        b = _wy_read8(bytes + left - 8);
+    }
+
+    a ^= wy_secret[1];
+    b ^= seed;
+
+    uint128_t product = (uint128_t)a * b;
+    a = (uint64_t)product;
+    b = (uint64_t)(product >> 64);
+
+    return _wy_mix(a ^ wy_secret[0] ^ len, b ^ wy_secret[1]);
+}
+
 /** integer hash function
  *
  * this is taken from this stackoverflow
@@ -622,6 +1867,10 @@ void print_hashmap_error(enum HashMapResult h_result) {
             printf("failed to insert -- no memory\n");
             break;
         }
+        case FailedToSaveFile: {
+            printf("failed to save file\n");
+            break;
+        }
         case FailedToRehashNoMemory: {
             printf("failed to rehash -- no memory\n");
             break;
@@ -2,6 +2,12 @@
 #define MY_HASHMAP
 
 #include "hashmap_base.h"
+#include "hashmap_concurrent.h"
+#include "hashmap_inline.h"
+#include "hashmap_int.h"
+#include "hashmap_lockfree.h"
+#include "hashmap_set.h"
+#include "hashmap_str.h"
 
 /** general info
  *
@@ -28,10 +34,13 @@
             uint64_t (*hash_func_t)(key_type *);                               \
             bool (*compare_func_t)(key_type *, key_type *);                    \
             void (*drop_func_t)(key_type *, data_type *);                      \
+            void (*for_each_func_t)(key_type *, data_type *, void *, int);     \
         } _data_types;                                                         \
     } name
 
 /* allocate memory for the  given hashmap;
+ *
+ * this uses the chained backend, see init_hashmap_backend to pick another one
  *
  * this will allocate all the needed memory for a given hashmap
  *
@@ -50,6 +59,22 @@
  *  a function to free the keys and values
  */
 #define init_hashmap(hashmap, hash_func, comp_func, drop_func)                 \
+    init_hashmap_backend(hashmap, HashMapChained, hash_func, comp_func,        \
+                         drop_func)
+
+/* allocate memory for the given hashmap using the given backend
+ *
+ * @param hashmap
+ *  a new hashmap to instantiate
+ *
+ * @param backend
+ *  a HashMapBackend, HashMapChained, HashMapOpen, HashMapSwiss, HashMapCompact
+ *  or HashMapCuckoo
+ *
+ * the rest of the params are the same as init_hashmap
+ */
+#define init_hashmap_backend(hashmap, backend, hash_func, comp_func,           \
+                             drop_func)                                        \
     do {                                                                       \
         typeof(hashmap->_data_types.hash_func_t) _hash_func = hash_func;       \
                                                                                \
@@ -62,7 +87,33 @@
         if (hashmap != NULL) {                                                 \
             hashmap->map_base =                                                \
                 init_hashmap_base((HashFunc)_hash_func, (CompFunc)_comp_func,  \
-                                  (DropFunc)_drop_func, STARTING_SIZE);        \
+                                  (DropFunc)_drop_func, STARTING_SIZE,         \
+                                  backend);                                    \
+        }                                                                      \
+    } while (0)
+
+/* allocate memory for the given hashmap with room for capacity entrys
+ *
+ * @param capacity
+ *  the amount of entrys the map should hold before it has to grow
+ *
+ * the rest of the params are the same as init_hashmap_backend
+ */
+#define init_hashmap_with_capacity(hashmap, backend, capacity, hash_func,      \
+                                   comp_func, drop_func)                       \
+    do {                                                                       \
+        typeof(hashmap->_data_types.hash_func_t) _hash_func = hash_func;       \
+                                                                               \
+        typeof(hashmap->_data_types.compare_func_t) _comp_func = comp_func;    \
+                                                                               \
+        typeof(hashmap->_data_types.drop_func_t) _drop_func = drop_func;       \
+                                                                               \
+        hashmap = malloc(sizeof(*hashmap));                                    \
+                                                                               \
+        if (hashmap != NULL) {                                                 \
+            hashmap->map_base = init_hashmap_with_capacity_base(               \
+                (HashFunc)_hash_func, (CompFunc)_comp_func,                    \
+                (DropFunc)_drop_func, capacity, backend);                      \
         }                                                                      \
     } while (0)
 
@@ -102,6 +153,64 @@
                                       (void *)_value);                         \
     } while (0)
 
+/** get a pointer to the value for a key after one lookup
+ *
+ * if the key is not in the map it is added with a NULL value and the caller
+ * fills it in through the pointer, see entry_hashmap_base
+ *
+ * @param key
+ *  the key to look up, this is stored if the key is new
+ *
+ * @param value_ptr
+ *  a data_type ** variable that is set to where the value lives, NULL if there
+ *  was no memory to add the key
+ *
+ * @param found
+ *  a bool variable that is set to true if the key was already in the map
+ */
+#define entry_hashmap(hashmap, key, value_ptr, found)                          \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+                                                                               \
+        value_ptr = (typeof(hashmap->_data_types.data_t) *)entry_hashmap_base( \
+            hashmap->map_base, (void *)_key, &found);                          \
+    } while (0)
+
+/** insert a key and value or replace the value if the key is already there
+ *
+ * @param old_value
+ *  a variable that is set to the replaced value or NULL if the key is new, it
+ *  is not dropped by the map
+ *
+ * @param success
+ *  a HashMapResult variable
+ */
+#define upsert_hashmap(hashmap, key, value, old_value, success)                \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+        typeof(hashmap->_data_types.data_t) _value = value;                    \
+        void *_old_value;                                                      \
+                                                                               \
+        success = upsert_hashmap_base(hashmap->map_base, (void *)_key,         \
+                                      (void *)_value, &_old_value);            \
+        old_value = _old_value;                                                \
+    } while (0)
+
+/** get the value for a key or insert the given one if the key is not there
+ *
+ * @param result
+ *  a variable that is set to the value in the map after the call, NULL if
+ *  there was no memory to add the key
+ */
+#define get_or_insert_hashmap(hashmap, key, value, result)                     \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+        typeof(hashmap->_data_types.data_t) _value = value;                    \
+                                                                               \
+        result = get_or_insert_hashmap_base(hashmap->map_base, (void *)_key,   \
+                                            (void *)_value);                   \
+    } while (0)
+
 /** check if the hashmap contains a given key
  *
  * @param key
@@ -124,6 +233,78 @@
         value = get_value_hashmap_base(hashmap->map_base, _key);               \
     } while (0)
 
+/** fill an empty hashmap from an array of keys and an array of values
+ *
+ * the table is sized once and filled by nthreads threads, see
+ * build_hashmap_from_arrays_base
+ *
+ * @param keys
+ *  an array of n key pointers
+ *
+ * @param values
+ *  an array of n value pointers, values[i] goes with keys[i]
+ *
+ * @param out_duplicates
+ *  NULL or an array of n bools that is set for the pairs that were left out
+ *  because an earlier pair had the same key
+ *
+ * @param success
+ *  a HashMapResult variable, FailedToInsertDuplicate if any pair was left out
+ */
+#define build_hashmap_from_arrays(hashmap, keys, values, n, nthreads,          \
+                                  out_duplicates, success)                     \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) *_keys = keys;                      \
+        typeof(hashmap->_data_types.data_t) *_values = values;                 \
+                                                                               \
+        success = build_hashmap_from_arrays_base(                              \
+            hashmap->map_base, (void **)_keys, (void **)_values, n, nthreads,  \
+            out_duplicates);                                                   \
+    } while (0)
+
+/** get the values for an array of keys
+ *
+ * the keys are hashed and their buckets prefetched in groups so the memory
+ * latency of the lookups overlaps, this is a lot faster than calling
+ * get_value_hashmap in a loop once the table does not fit in the cache
+ *
+ * @param keys
+ *  an array of key pointers
+ *
+ * @param n
+ *  the amount of keys
+ *
+ * @param values
+ *  an array of n value pointers to fill, a key that is not found gets NULL
+ */
+#define get_values_hashmap(hashmap, keys, n, values)                           \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) *_keys = keys;                      \
+        typeof(hashmap->_data_types.data_t) *_values = values;                 \
+                                                                               \
+        get_values_hashmap_base(hashmap->map_base, (void **)_keys, n,          \
+                                (void **)_values);                             \
+    } while (0)
+
+/** check if the hashmap contains each key in an array
+ *
+ * @param keys
+ *  an array of key pointers
+ *
+ * @param n
+ *  the amount of keys
+ *
+ * @param contains
+ *  an array of n bools to fill
+ */
+#define contains_keys_hashmap(hashmap, keys, n, contains)                      \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) *_keys = keys;                      \
+                                                                               \
+        contains_keys_hashmap_base(hashmap->map_base, (void **)_keys, n,       \
+                                   contains);                                  \
+    } while (0)
+
 /* remove an entry and return the value
  *
  * the returned value needs to be freed by the user
@@ -160,6 +341,39 @@
 #define get_iter_hashmap(hashmap, iter)                                        \
     iter = get_iter_hashmap_base(hashmap->map_base);
 
+/** get an iter over the buckets from begin_bucket up to end_bucket
+ *
+ * this is used with for_each like any other iter, the ranges can be split
+ * between threads as long as the map is not changed
+ *
+ * @param end_bucket
+ *  the bucket after the last one, see get_bucket_count_hashmap
+ */
+#define get_iter_range_hashmap(hashmap, begin_bucket, end_bucket, iter)        \
+    iter = get_iter_range_hashmap_base(hashmap->map_base, begin_bucket,        \
+                                       end_bucket);
+
+/* the amount of buckets to split between range iters */
+#define get_bucket_count_hashmap(hashmap)                                      \
+    get_bucket_count_hashmap_base(hashmap->map_base)
+
+/** call func on every key and value using nthreads threads
+ *
+ * @param func
+ *  a function taking a key, a value, the ctx and the id of the thread calling
+ *  it, the ids go from 0 to nthreads so results can be kept per thread
+ *
+ * @param ctx
+ *  a pointer passed to every call
+ */
+#define parallel_for_each_hashmap(hashmap, nthreads, func, ctx)                \
+    do {                                                                       \
+        typeof(hashmap->_data_types.for_each_func_t) _for_each_func = func;    \
+                                                                               \
+        parallel_for_each_hashmap_base(hashmap->map_base, nthreads,            \
+                                       (ForEachFunc)_for_each_func, ctx);      \
+    } while (0)
+
 /** iterate over the hash map (unsafe)
  *
  * call iter_next_hashmap() in a loop until the iter index is the same or larger
@@ -177,7 +391,7 @@
  *  a value variable to assign each next value to
  */
 #define for_each(iter, key, value)                                             \
-    iter->current_index = 0;                                                   \
+    iter->current_index = iter->begin_index - 1;                               \
     iter->current_entry = NULL;                                                \
     _iter_next_base(iter);                                                     \
                                                                                \
@@ -188,7 +402,7 @@
 
 /* same as the other for_each but it is safe to remove entrys while iterating */
 #define for_each_drop(iter, key, value)                                        \
-    iter->current_index = -1;                                                  \
+    iter->current_index = iter->begin_index - 1;                               \
     iter->current_entry = NULL;                                                \
     _iter_next_base(iter);                                                     \
                                                                                \
@@ -199,6 +413,340 @@
 
 #define get_longest_chain(hashmap) get_longest_chain_base(hashmap->map_base);
 
+/** spread rehashing out over the following operations
+ *
+ * only the chained backend supports this
+ *
+ * @param incremental
+ *  true to turn incremental rehashing on
+ *
+ * @return
+ *  false if the backend does not support it
+ */
+#define set_incremental_rehash(hashmap, incremental)                           \
+    set_incremental_rehash_base(hashmap->map_base, incremental)
+
+/** get the chained entrys from a user arena
+ *
+ * this needs to be called before anything is inserted, the memory from the
+ * arena is never freed by the hashmap
+ *
+ * @param arena_alloc
+ *  a function that returns memory from the arena
+ *
+ * @param arena
+ *  the arena to pass to arena_alloc
+ *
+ * @return
+ *  false if the backend is not chained or something was already inserted
+ */
+#define set_arena_hashmap(hashmap, arena_alloc, arena)                         \
+    set_arena_hashmap_base(hashmap->map_base, arena_alloc, arena)
+
+/* the longest time in nanoseconds a single call spent rehashing */
+#define get_max_pause(hashmap) get_max_pause_base(hashmap->map_base)
+
+/** make room for capacity entrys so inserting them does not rehash
+ *
+ * @return
+ *  a HashMapResult, Success if there already was room
+ */
+#define reserve_hashmap(hashmap, capacity)                                     \
+    reserve_hashmap_base(hashmap->map_base, capacity)
+
+/* shrink the table to the smallest size that fits the entrys it has */
+#define shrink_to_fit_hashmap(hashmap)                                         \
+    shrink_to_fit_hashmap_base(hashmap->map_base)
+
+/** set the load factor and growth factor for this map
+ *
+ * see set_load_factor_hashmap_base for the ranges
+ *
+ * @return
+ *  false if one of the factors is out of range
+ */
+#define set_load_factor_hashmap(hashmap, max_load_factor, growth_factor)       \
+    set_load_factor_hashmap_base(hashmap->map_base, max_load_factor,           \
+                                 growth_factor)
+
+/** make the map a cache that holds at most capacity entrys
+ *
+ * only the open backend supports this, inserting a new key in to a full cache
+ * evicts a key that has not been used lately and passes it to the drop_func,
+ * the hits, misses and evictions are counted in the stats
+ *
+ * @param capacity
+ *  the most entrys the map will hold or 0 to stop being a cache
+ *
+ * @return
+ *  false if the backend is not HashMapOpen or there was no memory
+ */
+#define set_cache_capacity_hashmap(hashmap, capacity)                          \
+    set_cache_capacity_hashmap_base(hashmap->map_base, capacity)
+
+/** fill a HashMapStats struct with how healthy the table is
+ *
+ * @param stats
+ *  a pointer to the HashMapStats to fill in
+ */
+#define get_stats_hashmap(hashmap, stats)                                      \
+    get_stats_hashmap_base(hashmap->map_base, stats)
+
+/** save the map to a file that load_hashmap_mmap can map back in
+ *
+ * @param key_size
+ *  a function returning the amount of bytes in a key
+ *
+ * @param value_size
+ *  a function returning the amount of bytes in a value
+ *
+ * @return
+ *  a HashMapResult, FailedToSaveFile if the file could not be written
+ */
+#define save_hashmap(hashmap, path, key_size, value_size)                      \
+    save_hashmap_base(hashmap->map_base, path, key_size, value_size)
+
+/** load a file written by save_hashmap as a read only map
+ *
+ * the keys and values point in to the file so they should not be changed or
+ * kept after the map is dropped, hashmap is NULL if the file could not be
+ * loaded
+ *
+ * @param hash_func
+ *  the hash function the map was saved with
+ *
+ * @param comp_func
+ *  a function to compare keys
+ */
+#define load_hashmap_mmap(hashmap, path, hash_func, comp_func)                 \
+    do {                                                                       \
+        typeof(hashmap->_data_types.hash_func_t) _hash_func = hash_func;       \
+                                                                               \
+        typeof(hashmap->_data_types.compare_func_t) _comp_func = comp_func;    \
+                                                                               \
+        hashmap = malloc(sizeof(*hashmap));                                    \
+                                                                               \
+        if (hashmap != NULL) {                                                 \
+            hashmap->map_base = load_hashmap_mmap_base(                        \
+                path, (HashFunc)_hash_func, (CompFunc)_comp_func);             \
+                                                                               \
+            if (hashmap->map_base == NULL) {                                   \
+                free(hashmap);                                                 \
+                hashmap = NULL;                                                \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+/* a macro to define a (kinda) type safe concurrent hashmap
+ *
+ * this works like the HASHMAP macro but the map_base is a ConcurrentHashMap,
+ * all the operations on it are thread safe
+ */
+#define CONCURRENT_HASHMAP(name, key_type, data_type)                          \
+    typedef struct {                                                           \
+        ConcurrentHashMap *map_base;                                           \
+        struct {                                                               \
+            key_type *key_t;                                                   \
+            data_type *data_t;                                                 \
+            uint64_t (*hash_func_t)(key_type *);                               \
+            bool (*compare_func_t)(key_type *, key_type *);                    \
+            void (*drop_func_t)(key_type *, data_type *);                      \
+        } _data_types;                                                         \
+    } name
+
+/* allocate memory for the given concurrent hashmap
+ *
+ * @param shard_bits
+ *  the map is split in to 2^shard_bits independently locked shards
+ *
+ * the rest of the params are the same as init_hashmap_backend
+ */
+#define init_concurrent_hashmap(hashmap, shard_bits, backend, hash_func,       \
+                                comp_func, drop_func)                          \
+    do {                                                                       \
+        typeof(hashmap->_data_types.hash_func_t) _hash_func = hash_func;       \
+                                                                               \
+        typeof(hashmap->_data_types.compare_func_t) _comp_func = comp_func;    \
+                                                                               \
+        typeof(hashmap->_data_types.drop_func_t) _drop_func = drop_func;       \
+                                                                               \
+        hashmap = malloc(sizeof(*hashmap));                                    \
+                                                                               \
+        if (hashmap != NULL) {                                                 \
+            hashmap->map_base = init_concurrent_hashmap_base(                  \
+                (HashFunc)_hash_func, (CompFunc)_comp_func,                    \
+                (DropFunc)_drop_func, shard_bits, backend);                    \
+        }                                                                      \
+    } while (0)
+
+#define drop_concurrent_hashmap(hashmap)                                       \
+    do {                                                                       \
+        drop_concurrent_hashmap_base(hashmap->map_base);                       \
+                                                                               \
+        free(hashmap);                                                         \
+    } while (0)
+
+#define insert_concurrent_hashmap(hashmap, key, value, success)                \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+        typeof(hashmap->_data_types.data_t) _value = value;                    \
+                                                                               \
+        success = insert_concurrent_hashmap_base(                              \
+            hashmap->map_base, (void *)_key, (void *)_value);                  \
+    } while (0)
+
+#define contains_key_concurrent_hashmap(hashmap, key, contains)                \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+                                                                               \
+        contains = contains_key_concurrent_hashmap_base(hashmap->map_base,     \
+                                                        (void *)_key);         \
+    } while (0)
+
+#define get_value_concurrent_hashmap(hashmap, key, value)                      \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+                                                                               \
+        value = get_value_concurrent_hashmap_base(hashmap->map_base, _key);    \
+    } while (0)
+
+#define remove_entry_concurrent_hashmap(hashmap, key, value_to_fill)           \
+    do {                                                                       \
+        typeof(hashmap->_data_types.key_t) _key = key;                         \
+                                                                               \
+        typeof(hashmap->_data_types.data_t) *_value = &value_to_fill;          \
+                                                                               \
+        *_value =                                                              \
+            remove_entry_concurrent_hashmap_base(hashmap->map_base, _key);     \
+    } while (0)
+
+/* a macro to define a (kinda) type safe hashset
+ *
+ * this works like the HASHMAP macro but the set_base is a HashSetBase which
+ * has no values
+ */
+#define HASHSET(name, key_type)                                                \
+    typedef struct {                                                           \
+        HashSetBase *set_base;                                                 \
+        struct {                                                               \
+            key_type *key_t;                                                   \
+            uint64_t (*hash_func_t)(key_type *);                               \
+            bool (*compare_func_t)(key_type *, key_type *);                    \
+            void (*drop_func_t)(key_type *);                                   \
+        } _data_types;                                                         \
+    } name
+
+/* allocate memory for the given hashset
+ *
+ * @param capacity
+ *  the amount of keys the set should hold before it has to grow
+ *
+ * @param drop_func
+ *  a function to free the keys or NULL
+ *
+ * the rest of the params are the same as init_hashmap
+ */
+#define init_hashset(hashset, capacity, hash_func, comp_func, drop_func)       \
+    do {                                                                       \
+        typeof(hashset->_data_types.hash_func_t) _hash_func = hash_func;       \
+                                                                               \
+        typeof(hashset->_data_types.compare_func_t) _comp_func = comp_func;    \
+                                                                               \
+        typeof(hashset->_data_types.drop_func_t) _drop_func = drop_func;       \
+                                                                               \
+        hashset = malloc(sizeof(*hashset));                                    \
+                                                                               \
+        if (hashset != NULL) {                                                 \
+            hashset->set_base = init_hashset_base(                             \
+                (HashFunc)_hash_func, (CompFunc)_comp_func,                    \
+                (SetDropFunc)_drop_func, capacity);                            \
+        }                                                                      \
+    } while (0)
+
+#define drop_hashset(hashset)                                                  \
+    do {                                                                       \
+        drop_hashset_base(hashset->set_base);                                  \
+                                                                               \
+        free(hashset);                                                         \
+    } while (0)
+
+/** insert a key in to the hashset
+ *
+ * @param success
+ *  a HashMapResult variable, FailedToInsertDuplicate if the key was there
+ */
+#define insert_hashset(hashset, key, success)                                  \
+    do {                                                                       \
+        typeof(hashset->_data_types.key_t) _key = key;                         \
+                                                                               \
+        success = insert_hashset_base(hashset->set_base, (void *)_key);        \
+    } while (0)
+
+#define contains_key_hashset(hashset, key, contains)                           \
+    do {                                                                       \
+        typeof(hashset->_data_types.key_t) _key = key;                         \
+                                                                               \
+        contains = contains_key_hashset_base(hashset->set_base, (void *)_key); \
+    } while (0)
+
+/** remove a key from the hashset
+ *
+ * @param key_to_fill
+ *  a variable that is set to the key that was in the set or NULL, it needs to
+ *  be freed by the user
+ */
+#define remove_key_hashset(hashset, key, key_to_fill)                          \
+    do {                                                                       \
+        typeof(hashset->_data_types.key_t) _key = key;                         \
+                                                                               \
+        typeof(hashset->_data_types.key_t) *_stored = &key_to_fill;            \
+                                                                               \
+        *_stored = remove_key_hashset_base(hashset->set_base, (void *)_key);   \
+    } while (0)
+
+/** make a new hashset from two others, see union_hashset_base
+ *
+ * the new set shares its keys with the two sets and does not drop them
+ *
+ * @param result
+ *  a new hashset of the same type, NULL if there was no memory
+ */
+#define _set_op_hashset(op, set_1, set_2, result)                              \
+    do {                                                                       \
+        typeof(set_1) _set_2 = set_2;                                          \
+                                                                               \
+        result = malloc(sizeof(*result));                                      \
+                                                                               \
+        if (result != NULL) {                                                  \
+            result->set_base = op(set_1->set_base, _set_2->set_base);          \
+                                                                               \
+            if (result->set_base == NULL) {                                    \
+                free(result);                                                  \
+                result = NULL;                                                 \
+            }                                                                  \
+        }                                                                      \
+    } while (0)
+
+#define union_hashset(set_1, set_2, result)                                    \
+    _set_op_hashset(union_hashset_base, set_1, set_2, result)
+
+#define intersection_hashset(set_1, set_2, result)                             \
+    _set_op_hashset(intersection_hashset_base, set_1, set_2, result)
+
+#define difference_hashset(set_1, set_2, result)                               \
+    _set_op_hashset(difference_hashset_base, set_1, set_2, result)
+
+/** iterate over the keys of a hashset
+ *
+ * it is not safe to insert or remove while iterating
+ *
+ * @param key
+ *  a key variable to assign each key to
+ */
+#define for_each_set(hashset, key)                                             \
+    for (int _set_index = -1; iter_next_hashset_base(                          \
+             hashset->set_base, &_set_index, (void **)&key);)
+
 /** print a what a hashmap HashMapResult is
  *
  * @param h_result
@@ -208,7 +756,8 @@ void print_hashmap_error(enum HashMapResult h_result);
 
 /* expose the hash functions to be used by the user */
 uint64_t integer_hash64(uint64_t x);
-uint64_t integer_hash32(uint64_t x);
+uint32_t integer_hash32(uint32_t x);
 size_t data_hash64(const void *data, size_t len);
+uint64_t fast_hash64(const void *data, size_t len, uint64_t seed);
 
 #endif
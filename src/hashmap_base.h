@@ -9,6 +9,46 @@
 #define GROWTH_FACTOR 2
 #define MAX_LOAD_FACTOR 0.7
 
+/* the smallest table reserve and shrink_to_fit will make and the largest one */
+#define MIN_TABLE_SIZE 16
+#define MAX_TABLE_SIZE (1 << 30)
+
+/* how many old buckets each operation moves during an incremental rehash */
+#define INCREMENTAL_REHASH_STEP 4
+
+/* an insert that has to look at more entrys or slots than this makes the map
+ * pick a new seed, see _reseed_hashmap in hashmap.c, the int, string, set and
+ * inline maps do the same
+ */
+#define FLOOD_PROBE_LENGTH 64
+
+/* a new random seed for a map, see hashmap.c */
+uint64_t new_seed(void);
+
+/** mix a seed in to a hash from the hash_func
+ *
+ * this is a 128 bit multiply folded back to 64 bits like wyhash, every bit of
+ * the hash and the seed reaches the low bits that pick the bucket
+ *
+ * every map seeds its hashes with this, it is here and not in
+ * hashmap_internal.h as HASHMAP_INLINE needs it in the code that uses it
+ */
+static inline uint64_t mix_seed(uint64_t seed, uint64_t hash) {
+    __extension__ unsigned __int128 product =
+        (unsigned __int128)(hash ^ seed) * UINT64_C(0x9e3779b97f4a7c15);
+
+    return (uint64_t)product ^ (uint64_t)(product >> 64);
+}
+
+/* the amount of entrys in the first and the largest entry pool blocks */
+#define POOL_START_BLOCK 64
+#define POOL_MAX_BLOCK 16384
+
+/* the amount of lengths in the histogram of HashMapStats, the last one counts
+ * every length from there up
+ */
+#define STATS_HISTOGRAM_SIZE 16
+
 /* the function signature to hash the key
  *
  * this will be stored with the struct
@@ -23,41 +63,262 @@ typedef bool (*CompFunc)(const void *key_1, const void *key_2);
  */
 typedef void (*DropFunc)(void *key, void *value);
 
+/* the function signature to get memory from a user arena
+ *
+ * the memory is never freed by the hashmap
+ */
+typedef void *(*ArenaAllocFunc)(void *arena, size_t size);
+
+/* the function signature to get the amount of bytes a key or value takes up
+ *
+ * this is used to save a map to a snapshot file
+ */
+typedef size_t (*SizeFunc)(const void *data);
+
+/* the function signature for parallel_for_each_hashmap_base
+ *
+ * thread_id is from 0 to the amount of threads so it can index per thread
+ * results that are combined once the call returns
+ */
+typedef void (*ForEachFunc)(void *key, void *value, void *ctx, int thread_id);
+
 /* a way to signal what went wrong */
 enum HashMapResult {
     FailedToInsert,
     FailedToInsertNoMemory,
     FailedToInsertDuplicate,
     FailedToRehashNoMemory,
+    FailedToSaveFile,
     Success,
 };
 
-/* a entry in the hashmap */
+/* the storage layout the hashmap uses
+ *
+ * HashMapChained
+ *  a table of pointers to linked lists of Entry structs, the original layout
+ *
+ * HashMapOpen
+ *  open addressing with robin hood probing, the key, value and hash are
+ *  stored contiguously in the table so there is no allocation per entry and no
+ *  pointer chasing on lookups
+ *
+ * HashMapSwiss
+ *  open addressing with a control byte per slot holding 7 bits of the hash,
+ *  whole groups of control bytes are checked at once with sse2/avx2 so the
+ *  comp_func is only called on likely matches
+ *
+ * HashMapCompact
+ *  a sparse array of indexes in to a dense array of slots kept in insertion
+ *  order, iteration walks the dense array and goes in the order the keys were
+ *  added, see hashmap_compact.c
+ *
+ * HashMapMapped
+ *  a read only snapshot mapped from a file, see hashmap_mmap.c, maps with this
+ *  backend come from load_hashmap_mmap_base and not init_hashmap_base
+ *
+ * HashMapCuckoo
+ *  buckets of 4 slots where every key can only be in one of two buckets, a
+ *  lookup looks at two buckets at most so the slow lookups are not much slower
+ *  than the rest, see hashmap_cuckoo.c
+ */
+enum HashMapBackend {
+    HashMapChained,
+    HashMapOpen,
+    HashMapSwiss,
+    HashMapMapped,
+    HashMapCompact,
+    HashMapCuckoo,
+};
+
+/* a entry in the hashmap
+ *
+ * the full hash is kept so rehashing does not call the hash_func and chain
+ * walks can skip keys with a different hash without calling the comp_func
+ */
 typedef struct Entry {
     void *value;
     void *key;
+    uint64_t hash;
     struct Entry *next;
 } Entry;
 
+/* a block of entrys in the entry pool */
+typedef struct EntryBlock {
+    struct EntryBlock *next;
+    int size;
+    Entry entries[];
+} EntryBlock;
+
+/* where the chained backend gets its entrys from, see hashmap_pool.c */
+typedef struct {
+    EntryBlock *blocks;
+    Entry *free_list;
+    int block_used;
+    ArenaAllocFunc arena_alloc;
+    void *arena;
+} EntryPool;
+
+/* a slot in the open addressing table
+ *
+ * a hash of zero marks the slot as empty, see robin_slot_hash,
+ * the swiss backend uses its control bytes for that instead
+ */
+typedef struct {
+    uint64_t hash;
+    void *key;
+    void *value;
+} Slot;
+
 /* the main hashmap */
 typedef struct {
     int table_size;
     int current_size;
+    enum HashMapBackend backend;
     Entry **table;
+    EntryPool pool;
+    Slot *slots;
+    uint8_t *ctrl;
+    int deleted_size;
+
+    /* the compact backend, slots is its dense array, entries_used counts the
+     * holes left by removes as well
+     */
+    int32_t *indexes;
+    int entries_used;
+    int entries_capacity;
+
+    /* the snapshot file for the mapped backend */
+    const void *mapped;
+    size_t mapped_size;
+
+    /* the table grows when an insert would bring current_size to threshold,
+     * this is table_size * max_load_factor worked out once per resize
+     */
+    int threshold;
+    double max_load_factor;
+    int growth_factor;
+
+    /* incremental rehashing, only used by the chained backend
+     *
+     * while old_table is set the buckets before migrate_index have been moved
+     * to the new table and the rest are still in the old one
+     */
+    Entry **old_table;
+    int old_table_size;
+    int migrate_index;
+    bool incremental;
+    int active_iters;
+
+    /* the cache mode of the open backend, see hashmap_cache.c
+     *
+     * referenced has a CLOCK bit for every slot and is NULL unless the map is
+     * a cache, clock_hand is the next slot the eviction looks at
+     */
+    int cache_capacity;
+    int clock_hand;
+    uint8_t *referenced;
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t cache_evictions;
+
+    /* every hash from the hash_func has the seed mixed in before it picks a
+     * bucket, so keys that collide in one map do not collide in another
+     *
+     * flooded is set by an insert that probed past FLOOD_PROBE_LENGTH and the
+     * next insert reseeds, reseed_size is the size the map has to reach before
+     * it can reseed again
+     */
+    uint64_t seed;
+    bool flooded;
+    int reseed_size;
+    uint64_t reseed_count;
+
+    /* the longest time a single call spent rehashing */
+    uint64_t max_pause_ns;
+
+    /* totals for get_stats_hashmap_base, the lookup counters are indexed by
+     * whether the key was found and only count when built with HASHMAP_STATS
+     */
+    uint64_t rehash_count;
+    uint64_t rehash_ns;
+    uint64_t lookups[2];
+    uint64_t lookup_probes[2];
+
     HashFunc hash_func;
     DropFunc drop_func;
     CompFunc comp_func;
 } HashMapBase;
 
-/* the iteration data */
+/** how healthy the table is, filled by get_stats_hashmap_base
+ *
+ * a length is the same thing get_longest_chain_base measures, entrys in a
+ * bucket for the chained backend, slots probed for the open backend and groups
+ * probed for the swiss backend
+ *
+ * the chained histogram counts buckets so length 0 is the empty buckets, the
+ * others count keys by how long the lookup for them is
+ */
+typedef struct {
+    int size;
+    int table_size;
+    int deleted_size;
+    double load_factor;
+    double empty_fraction;
+
+    int length_histogram[STATS_HISTOGRAM_SIZE];
+    int longest;
+
+    /* the average entrys or slots or groups a lookup has to look at, worked
+     * out from the current layout of the table
+     */
+    double hit_probes;
+    double miss_probes;
+
+    /* the same averages measured on the real lookups, these stay at 0 unless
+     * the library is built with HASHMAP_STATS
+     */
+    uint64_t hit_lookups;
+    uint64_t miss_lookups;
+    double measured_hit_probes;
+    double measured_miss_probes;
+
+    uint64_t rehash_count;
+    uint64_t rehash_ns;
+    uint64_t max_pause_ns;
+    uint64_t reseed_count;
+
+    /* the lookups and evictions of a cache, see hashmap_cache.c */
+    uint64_t cache_hits;
+    uint64_t cache_misses;
+    uint64_t cache_evictions;
+
+    /* the memory the map holds, not counting the keys and values */
+    size_t bytes_used;
+    double bytes_per_entry;
+} HashMapStats;
+
+/* the iteration data
+ *
+ * the iter covers the bucket indexes from begin_index up to end_index, an
+ * end_index of -1 is the end of the table at the time of each step
+ */
 typedef struct {
     int current_index;
     Entry *current_entry;
     HashMapBase *base;
+    int begin_index;
+    int end_index;
 } IterHashMap;
 
 HashMapBase *init_hashmap_base(HashFunc hash_func, CompFunc comp_func,
-                               DropFunc drop_func, uint64_t size);
+                               DropFunc drop_func, uint64_t size,
+                               enum HashMapBackend backend);
+
+HashMapBase *init_hashmap_with_capacity_base(HashFunc hash_func,
+                                             CompFunc comp_func,
+                                             DropFunc drop_func,
+                                             size_t capacity,
+                                             enum HashMapBackend backend);
 
 void drop_hashmap_base(HashMapBase *map);
 
@@ -65,13 +326,39 @@ void drop_entry(Entry *prev_entry, Entry *current_entry);
 
 enum HashMapResult insert_hashmap_base(HashMapBase *map, void *, void *value);
 
+void **entry_hashmap_base(HashMapBase *map, void *key, bool *found);
+
+enum HashMapResult upsert_hashmap_base(HashMapBase *map, void *key,
+                                       void *value, void **old_value);
+
+void *get_or_insert_hashmap_base(HashMapBase *map, void *key, void *value);
+
 void *remove_entry_hashmap_base(HashMapBase *map, void *key);
 
 bool contains_key_hashmap_base(HashMapBase *map, void *key);
 
 void *get_value_hashmap_base(HashMapBase *map, void *key);
 
+enum HashMapResult build_hashmap_from_arrays_base(HashMapBase *map,
+                                                  void **keys, void **values,
+                                                  size_t n, int nthreads,
+                                                  bool *out_duplicates);
+
+void get_values_hashmap_base(HashMapBase *map, void **keys, size_t n,
+                             void **out_values);
+
+void contains_keys_hashmap_base(HashMapBase *map, void **keys, size_t n,
+                                bool *out_contains);
+
 IterHashMap *get_iter_hashmap_base(HashMapBase *map);
+
+IterHashMap *get_iter_range_hashmap_base(HashMapBase *map, int begin_bucket,
+                                         int end_bucket);
+
+int get_bucket_count_hashmap_base(HashMapBase *map);
+
+void parallel_for_each_hashmap_base(HashMapBase *map, int nthreads,
+                                    ForEachFunc func, void *ctx);
 void drop_iter_hashmap(IterHashMap *iter);
 
 void _iter_next_base(IterHashMap *iter);
@@ -84,4 +371,28 @@ bool iter_next_drop_hashmap(IterHashMap *iter, void **key, void **value);
 // **value);
 
 int get_longest_chain_base(HashMapBase *map);
+
+bool set_incremental_rehash_base(HashMapBase *map, bool incremental);
+
+bool set_arena_hashmap_base(HashMapBase *map, ArenaAllocFunc arena_alloc,
+                            void *arena);
+
+uint64_t get_max_pause_base(HashMapBase *map);
+
+enum HashMapResult reserve_hashmap_base(HashMapBase *map, size_t capacity);
+
+enum HashMapResult shrink_to_fit_hashmap_base(HashMapBase *map);
+
+bool set_load_factor_hashmap_base(HashMapBase *map, double max_load_factor,
+                                  int growth_factor);
+
+bool set_cache_capacity_hashmap_base(HashMapBase *map, int capacity);
+
+void get_stats_hashmap_base(HashMapBase *map, HashMapStats *stats);
+
+enum HashMapResult save_hashmap_base(HashMapBase *map, const char *path,
+                                     SizeFunc key_size, SizeFunc value_size);
+
+HashMapBase *load_hashmap_mmap_base(const char *path, HashFunc hash_func,
+                                    CompFunc comp_func);
 #endif
@@ -0,0 +1,198 @@
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** batched lookups
+ *
+ * looking up one key at a time pays the full memory latency for every key as
+ * each lookup has to wait for its bucket to load before it can do anything
+ *
+ * the batched versions work on groups of keys, all the keys in a group are
+ * hashed first and their buckets prefetched, for the chained backend the first
+ * entry of each chain is prefetched as well, by the time the keys are resolved
+ * most of the loads are already on their way so the latency overlaps
+ */
+
+/* how many keys are hashed and prefetched before they are resolved */
+#define BATCH_GROUP 16
+
+/* start loading the memory the lookup for the hash will look at first */
+static inline void _prefetch_bucket(HashMapBase *map, uint64_t hash) {
+    switch (map->backend) {
+        case HashMapChained: {
+            __builtin_prefetch(&map->table[hash & (map->table_size - 1)]);
+            break;
+        }
+        case HashMapOpen: {
+            uint64_t slot_hash = robin_slot_hash(hash);
+
+            __builtin_prefetch(&map->slots[slot_hash & (map->table_size - 1)]);
+            break;
+        }
+        case HashMapSwiss: {
+            const uint8_t *ctrl;
+            const Slot *slots;
+
+            first_group_swiss(map, hash, &ctrl, &slots);
+
+            __builtin_prefetch(ctrl);
+            __builtin_prefetch(slots);
+            break;
+        }
+        case HashMapCompact: {
+            prefetch_compact(map, hash);
+            break;
+        }
+        case HashMapCuckoo: {
+            prefetch_cuckoo(map, hash);
+            break;
+        }
+        case HashMapMapped: {
+            prefetch_mapped(map, hash);
+            break;
+        }
+    }
+}
+
+/* the chained backend has one more pointer to follow, the bucket was
+ * prefetched already so load it and prefetch the first entry
+ */
+static inline void _prefetch_chain(HashMapBase *map, uint64_t hash) {
+    Entry *entry = map->table[hash & (map->table_size - 1)];
+
+    if (entry) {
+        __builtin_prefetch(entry);
+    }
+}
+
+/** find a key that has already been hashed
+ *
+ * @param found
+ *  set to true if the key is in the table
+ *
+ * @return
+ *  the value for the key or NULL
+ */
+static inline void *_find_hashed(HashMapBase *map, uint64_t hash, void *key,
+                                 bool *found) {
+    Slot *slot = NULL;
+
+    switch (map->backend) {
+        case HashMapChained: {
+            Entry *entry = *find_link_chained(map, hash, key);
+
+            *found = entry != NULL;
+
+            return entry ? entry->value : NULL;
+        }
+        case HashMapOpen: {
+            slot = find_slot_open(map, hash, key);
+
+            if (map->referenced) {
+                count_cache_lookup(map, slot);
+            }
+            break;
+        }
+        case HashMapSwiss: {
+            slot = find_slot_swiss(map, hash, key);
+            break;
+        }
+        case HashMapCompact: {
+            slot = find_slot_compact(map, hash, key);
+            break;
+        }
+        case HashMapCuckoo: {
+            slot = find_slot_cuckoo(map, hash, key);
+            break;
+        }
+        case HashMapMapped: {
+            return find_value_mapped(map, hash, key, found);
+        }
+    }
+
+    *found = slot != NULL;
+
+    return slot ? slot->value : NULL;
+}
+
+/** hash and prefetch a group of keys
+ *
+ * @param hashes
+ *  filled with the hash of each key
+ */
+static void _prefetch_group(HashMapBase *map, void **keys, size_t count,
+                            uint64_t *hashes) {
+    for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_key(map, keys[i]);
+
+        _prefetch_bucket(map, hashes[i]);
+    }
+
+    if (map->backend == HashMapChained) {
+        for (size_t i = 0; i < count; ++i) {
+            _prefetch_chain(map, hashes[i]);
+        }
+    }
+}
+
+/** get the values for many keys at once
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param keys
+ *  an array of keys to look up
+ *
+ * @param n
+ *  the amount of keys
+ *
+ * @param out_values
+ *  an array of n pointers, each is set to the value for the key at the same
+ *  index or NULL if the key is not in the table
+ */
+void get_values_hashmap_base(HashMapBase *map, void **keys, size_t n,
+                             void **out_values) {
+    uint64_t hashes[BATCH_GROUP];
+    bool found;
+
+    for (size_t start = 0; start < n; start += BATCH_GROUP) {
+        size_t count = n - start < BATCH_GROUP ? n - start : BATCH_GROUP;
+
+        _prefetch_group(map, keys + start, count, hashes);
+
+        for (size_t i = 0; i < count; ++i) {
+            out_values[start + i] =
+                _find_hashed(map, hashes[i], keys[start + i], &found);
+        }
+    }
+}
+
+/** check if many keys are in the table at once
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param keys
+ *  an array of keys to check
+ *
+ * @param n
+ *  the amount of keys
+ *
+ * @param out_contains
+ *  an array of n bools, each is set to true if the key at the same index is in
+ *  the table
+ */
+void contains_keys_hashmap_base(HashMapBase *map, void **keys, size_t n,
+                                bool *out_contains) {
+    uint64_t hashes[BATCH_GROUP];
+
+    for (size_t start = 0; start < n; start += BATCH_GROUP) {
+        size_t count = n - start < BATCH_GROUP ? n - start : BATCH_GROUP;
+
+        _prefetch_group(map, keys + start, count, hashes);
+
+        for (size_t i = 0; i < count; ++i) {
+            _find_hashed(map, hashes[i], keys[start + i],
+                         &out_contains[start + i]);
+        }
+    }
+}
@@ -0,0 +1,385 @@
+#include <string.h>
+
+#include "hashmap_internal.h"
+
+/** building a map from arrays of keys and values
+ *
+ * inserting pairs one at a time rehashes over and over as the map fills and
+ * does everything on one thread, the build instead sizes the table once and
+ * splits the work up
+ *
+ *  1. every thread hashes a chunk of the keys and counts how many land in
+ *     each partition, a partition is a range of the table picked by the high
+ *     bits of the bucket index
+ *  2. the pairs are radix partitioned, every thread writes the indexes of its
+ *     chunk to where they go in the partition order
+ *  3. every thread fills the table ranges of its own partitions, the ranges
+ *     dont overlap so no locking is needed
+ *
+ * for the chained backend the entrys come from one array taken from the pool
+ * up front, for the open backend a key that would push entrys past the end of
+ * its range is left for a single threaded pass at the end, the swiss backend
+ * probes across the whole table so its fill is single threaded in the
+ * partition order, the compact backend keeps insertion order so its fill is
+ * single threaded in the order of the arrays
+ *
+ * the pairs in a partition are always handled in the order they are in the
+ * arrays and duplicates always end up in the same partition, so the first
+ * pair for a key is the one that is kept
+ */
+
+/* what happened to each pair */
+enum BuildStatus {
+    BuildInserted,
+    BuildDuplicate,
+    BuildDeferred,
+};
+
+/* everything the threads share */
+typedef struct {
+    HashMapBase *map;
+    void **keys;
+    void **values;
+    size_t n;
+    int thread_count;
+    int partition_count;
+    int partition_shift;
+    uint64_t *hashes;
+    size_t *order;
+    size_t *counts;
+    uint8_t *status;
+    Entry *entries;
+} BuildData;
+
+typedef struct {
+    BuildData *data;
+    int id;
+} BuildThread;
+
+/* the partition for a hash, this is the top bits of the bucket index */
+static inline int _partition(BuildData *data, uint64_t hash) {
+    HashMapBase *map = data->map;
+
+    // the open backend moves a hash of 0 to 1, see robin_slot_hash
+    if (map->backend == HashMapOpen && hash == 0) {
+        hash = 1;
+    }
+
+    return (hash & (map->table_size - 1)) >> data->partition_shift;
+}
+
+/* the chunk of the arrays a thread hashes and partitions */
+static inline void _chunk(BuildThread *thread, size_t *start, size_t *end) {
+    BuildData *data = thread->data;
+
+    *start = data->n * thread->id / data->thread_count;
+    *end = data->n * (thread->id + 1) / data->thread_count;
+}
+
+/* hash a chunk and count the pairs in every partition */
+static void *_hash_chunk(void *arg) {
+    BuildThread *thread = arg;
+    BuildData *data = thread->data;
+    size_t *counts = data->counts + thread->id * data->partition_count;
+    size_t start;
+    size_t end;
+
+    _chunk(thread, &start, &end);
+
+    for (size_t i = start; i < end; ++i) {
+        data->hashes[i] = hash_key(data->map, data->keys[i]);
+
+        ++counts[_partition(data, data->hashes[i])];
+    }
+
+    return NULL;
+}
+
+/* write the indexes of a chunk in to the partition order, the counts have
+ * been turned in to offsets by then
+ */
+static void *_scatter_chunk(void *arg) {
+    BuildThread *thread = arg;
+    BuildData *data = thread->data;
+    size_t *offsets = data->counts + thread->id * data->partition_count;
+    size_t start;
+    size_t end;
+
+    _chunk(thread, &start, &end);
+
+    for (size_t i = start; i < end; ++i) {
+        data->order[offsets[_partition(data, data->hashes[i])]++] = i;
+    }
+
+    return NULL;
+}
+
+/* add a pair to its bucket, appending keeps the first pair for a key */
+static void _fill_chained(BuildData *data, size_t i) {
+    HashMapBase *map = data->map;
+    uint64_t hash = data->hashes[i];
+    Entry **link = &map->table[hash & (map->table_size - 1)];
+
+    while (*link) {
+        Entry *entry = *link;
+
+        if (entry->hash == hash && map->comp_func(entry->key, data->keys[i])) {
+            data->status[i] = BuildDuplicate;
+            return;
+        }
+
+        link = &(*link)->next;
+    }
+
+    Entry *entry = &data->entries[i];
+
+    entry->key = data->keys[i];
+    entry->value = data->values[i];
+    entry->hash = hash;
+    entry->next = NULL;
+
+    *link = entry;
+    data->status[i] = BuildInserted;
+}
+
+static void _fill_open(BuildData *data, size_t i, int end) {
+    enum HashMapResult result = insert_range_open(
+        data->map, data->hashes[i], data->keys[i], data->values[i], end);
+
+    if (result == Success) {
+        data->status[i] = BuildInserted;
+    } else if (result == FailedToInsertDuplicate) {
+        data->status[i] = BuildDuplicate;
+    } else {
+        data->status[i] = BuildDeferred;
+    }
+}
+
+/** fill the table ranges of every partition the thread owns
+ *
+ * the partitions are handed out round robin, the partition starts are the
+ * offsets the last thread ended with
+ */
+static void *_fill_partitions(void *arg) {
+    BuildThread *thread = arg;
+    BuildData *data = thread->data;
+    size_t *ends =
+        data->counts + (data->thread_count - 1) * data->partition_count;
+    int range = data->map->table_size / data->partition_count;
+
+    for (int p = thread->id; p < data->partition_count;
+         p += data->thread_count) {
+        size_t start = p == 0 ? 0 : ends[p - 1];
+
+        for (size_t k = start; k < ends[p]; ++k) {
+            size_t i = data->order[k];
+
+            if (data->map->backend == HashMapChained) {
+                _fill_chained(data, i);
+            } else {
+                _fill_open(data, i, (p + 1) * range);
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* turn the per thread partition counts in to the offset each thread starts
+ * writing at, partition by partition and thread by thread
+ */
+static void _counts_to_offsets(BuildData *data) {
+    size_t total = 0;
+
+    for (int p = 0; p < data->partition_count; ++p) {
+        for (int t = 0; t < data->thread_count; ++t) {
+            size_t *count = &data->counts[t * data->partition_count + p];
+            size_t offset = total;
+
+            total += *count;
+            *count = offset;
+        }
+    }
+}
+
+/* size the table for n entrys, an incremental rehash is finished first as
+ * the threads only fill the new table
+ */
+static enum HashMapResult _reserve_for_build(HashMapBase *map, size_t n) {
+    bool incremental = map->incremental;
+
+    if (incremental) {
+        set_incremental_rehash_base(map, false);
+    }
+
+    enum HashMapResult result = reserve_hashmap_base(map, n);
+
+    map->incremental = incremental;
+
+    return result;
+}
+
+/** fill an empty map from arrays of keys and values using many threads
+ *
+ * the hash_func is called from all the threads at once so it can not change
+ * any shared state
+ *
+ * @param map
+ *  the hashmap base, this has to be empty
+ *
+ * @param keys
+ *  an array of n keys
+ *
+ * @param values
+ *  an array of n values, the value for keys[i] is values[i]
+ *
+ * @param n
+ *  the amount of pairs
+ *
+ * @param nthreads
+ *  the amount of threads to use, up to 64
+ *
+ * @param out_duplicates
+ *  NULL or an array of n bools, each is set to true if the pair was not
+ *  inserted because an earlier pair had the same key
+ *
+ * @return
+ *  Success, FailedToInsertDuplicate if there were duplicates, every other pair
+ *  is still inserted, or FailedToInsert if the map was not empty or is a
+ *  snapshot or a cache
+ */
+enum HashMapResult build_hashmap_from_arrays_base(HashMapBase *map,
+                                                  void **keys, void **values,
+                                                  size_t n, int nthreads,
+                                                  bool *out_duplicates) {
+    if (map->current_size != 0 || map->backend == HashMapMapped ||
+        map->referenced) {
+        return FailedToInsert;
+    }
+
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    enum HashMapResult result = _reserve_for_build(map, n);
+
+    if (result != Success) {
+        return result;
+    }
+
+    BuildData data = {
+        .map = map,
+        .keys = keys,
+        .values = values,
+        .n = n,
+        .thread_count = nthreads,
+        .partition_count = 1,
+        .partition_shift = __builtin_ctz(map->table_size),
+    };
+
+    // a power of two partitions so they are a whole amount of buckets
+    while (data.partition_count < nthreads && data.partition_shift > 0) {
+        data.partition_count *= 2;
+        --data.partition_shift;
+    }
+
+    data.hashes = malloc(sizeof(uint64_t) * n);
+    data.order = malloc(sizeof(size_t) * n);
+    data.status = malloc(n);
+    data.counts = calloc(nthreads * data.partition_count, sizeof(size_t));
+
+    if (map->backend == HashMapChained && n > 0) {
+        data.entries = pool_alloc_entries(&map->pool, n);
+    }
+
+    if ((n > 0 && (!data.hashes || !data.order || !data.status)) ||
+        !data.counts || (map->backend == HashMapChained && n > 0 &&
+                         !data.entries)) {
+        free(data.hashes);
+        free(data.order);
+        free(data.status);
+        free(data.counts);
+
+        return FailedToInsertNoMemory;
+    }
+
+    BuildThread threads[MAX_THREADS];
+
+    for (int t = 0; t < nthreads; ++t) {
+        threads[t].data = &data;
+        threads[t].id = t;
+    }
+
+    run_threads(threads, sizeof(BuildThread), nthreads, _hash_chunk);
+
+    _counts_to_offsets(&data);
+
+    run_threads(threads, sizeof(BuildThread), nthreads, _scatter_chunk);
+
+    if (map->backend == HashMapSwiss || map->backend == HashMapCompact ||
+        map->backend == HashMapCuckoo) {
+        memset(data.status, BuildDeferred, n);
+    } else {
+        run_threads(threads, sizeof(BuildThread), nthreads, _fill_partitions);
+    }
+
+    // anything left over goes in one at a time, still in the partition order
+    // so the first pair for a key is kept
+    for (size_t k = 0; k < n; ++k) {
+        size_t i = map->backend == HashMapCompact ? k : data.order[k];
+
+        if (data.status[i] != BuildDeferred) {
+            continue;
+        }
+
+        enum HashMapResult inserted;
+
+        if (map->backend == HashMapOpen) {
+            inserted = insert_open(map, data.hashes[i], keys[i], values[i]);
+        } else if (map->backend == HashMapSwiss) {
+            inserted = insert_swiss(map, data.hashes[i], keys[i], values[i]);
+        } else if (map->backend == HashMapCuckoo) {
+            inserted = insert_cuckoo(map, data.hashes[i], keys[i], values[i]);
+        } else {
+            inserted = insert_compact(map, data.hashes[i], keys[i], values[i]);
+        }
+
+        data.status[i] = inserted == Success ? BuildInserted : BuildDuplicate;
+
+        // the swiss, compact and cuckoo inserts look at the size when they
+        // clean up or grow
+        if (inserted == Success) {
+            ++map->current_size;
+        }
+    }
+
+    size_t duplicates = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        bool duplicate = data.status[i] == BuildDuplicate;
+
+        if (out_duplicates) {
+            out_duplicates[i] = duplicate;
+        }
+
+        if (duplicate) {
+            ++duplicates;
+
+            // the entry set aside for the pair can be used by later inserts
+            if (map->backend == HashMapChained) {
+                pool_free_entry(&map->pool, &data.entries[i]);
+            }
+        }
+    }
+
+    map->current_size = n - duplicates;
+
+    free(data.hashes);
+    free(data.order);
+    free(data.status);
+    free(data.counts);
+
+    return duplicates ? FailedToInsertDuplicate : Success;
+}
@@ -0,0 +1,134 @@
+#include "hashmap_internal.h"
+
+/** the cache mode
+ *
+ * a cache is an open backend map that never holds more than cache_capacity
+ * entrys, inserting a new key in to a full cache evicts another one first and
+ * passes it to the drop_func
+ *
+ * the eviction is CLOCK, every slot has a referenced bit that a hit sets, the
+ * clock hand sweeps the table clearing the bits it passes and evicts the first
+ * full slot it finds with a clear bit, so an entry that was used since the
+ * hand last went by gets another lap
+ *
+ * a hit only adds a store to the referenced bit and a counter to a lookup, the
+ * bits are moved with their slots by the robin hood swaps and the backward
+ * shift in hashmap_open.c
+ */
+
+/** evict the next entry the clock hand finds without its referenced bit
+ *
+ * this ends within two laps of the table as the first lap clears every bit
+ */
+static void _evict(HashMapBase *map) {
+    int mask = map->table_size - 1;
+    int index = map->clock_hand & mask;
+
+    while (true) {
+        if (map->slots[index].hash != 0) {
+            if (!map->referenced[index]) {
+                break;
+            }
+
+            map->referenced[index] = 0;
+        }
+
+        index = (index + 1) & mask;
+    }
+
+    Slot evicted = map->slots[index];
+
+    // the slot after the evicted one shifts back in to it, so the hand stays
+    // here to look at it next
+    remove_slot_open(map, index);
+
+    map->clock_hand = index;
+    ++map->cache_evictions;
+
+    if (map->drop_func) {
+        map->drop_func(evicted.key, evicted.value);
+    }
+}
+
+/** find the slot for a key in a cache, adding the key if it is not there
+ *
+ * this is entry_open for caches, if the cache is full the key is looked up
+ * first so an eviction only happens for a key that is really new
+ *
+ * @param found
+ *  set to true if the key was already in the cache
+ */
+Slot *entry_cache(HashMapBase *map, uint64_t hash, void *key, bool *found) {
+    if (map->current_size >= map->cache_capacity) {
+        Slot *slot = find_slot_open(map, hash, key);
+
+        count_cache_lookup(map, slot);
+
+        if (slot != NULL) {
+            *found = true;
+            return slot;
+        }
+
+        _evict(map);
+
+        return entry_open(map, hash, key, found);
+    }
+
+    Slot *slot = entry_open(map, hash, key, found);
+
+    count_cache_lookup(map, *found ? slot : NULL);
+
+    return slot;
+}
+
+/** turn a map in to a cache that holds at most capacity entrys
+ *
+ * the table is reserved for the capacity up front so a cache never rehashes,
+ * if the map already has more entrys than capacity the extra ones are evicted
+ * now, the hits, misses and evictions are in get_stats_hashmap_base
+ *
+ * only the open backend supports this
+ *
+ * @param capacity
+ *  the most entrys the map will hold or 0 to make it a normal map again
+ *
+ * @return
+ *  false if the map is not an open backend map or there was no memory
+ */
+bool set_cache_capacity_hashmap_base(HashMapBase *map, int capacity) {
+    if (map->backend != HashMapOpen || capacity < 0) {
+        return false;
+    }
+
+    if (capacity == 0) {
+        free(map->referenced);
+
+        map->referenced = NULL;
+        map->cache_capacity = 0;
+
+        return true;
+    }
+
+    // a full cache checks for room for one more before it evicts
+    if (reserve_hashmap_base(map, (size_t)capacity + 1) != Success) {
+        return false;
+    }
+
+    if (map->referenced == NULL) {
+        map->referenced = calloc(map->table_size, sizeof(uint8_t));
+
+        if (map->referenced == NULL) {
+            return false;
+        }
+
+        map->clock_hand = 0;
+    }
+
+    map->cache_capacity = capacity;
+
+    while (map->current_size > capacity) {
+        _evict(map);
+    }
+
+    return true;
+}
@@ -0,0 +1,424 @@
+#include <string.h>
+
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** the compact backend
+ *
+ * this is the layout python uses for its dict, the table is a sparse array of
+ * int32 indexes in to a dense array of slots, the slots are added to the end
+ * of the dense array so it stays in insertion order and iteration walks it
+ * without skipping empty buckets
+ *
+ * the dense array only needs room for table_size * max_load_factor slots and
+ * an index is 4 bytes, so it takes less memory than the open backend
+ *
+ * the index array uses linear probing with backward shift deletion, a removed
+ * slot leaves a hole in the dense array that is cleaned up the next time the
+ * table is rebuilt, a hole has a hash of 0 like an empty open slot
+ */
+
+/* an empty bucket in the index array */
+#define COMPACT_EMPTY -1
+
+/* how far the bucket at index is from the home bucket of the hash */
+static inline int _compact_distance(HashMapBase *map, uint64_t hash,
+                                    int index) {
+    return (index - (int)(hash & (map->table_size - 1))) &
+           (map->table_size - 1);
+}
+
+/* the room the dense array needs for a table size */
+static inline int _compact_capacity(HashMapBase *map, int table_size) {
+    int capacity = table_size * map->max_load_factor;
+
+    // after the load factor is lowered the map can hold more than that until
+    // it grows
+    return capacity > map->current_size ? capacity : map->current_size + 1;
+}
+
+/** allocate the index and dense arrays for map->table_size
+ *
+ * @return
+ *  false if there was no memory
+ */
+bool alloc_table_compact(HashMapBase *map) {
+    int capacity = _compact_capacity(map, map->table_size);
+
+    map->indexes = malloc(sizeof(int32_t) * map->table_size);
+    map->slots = malloc(sizeof(Slot) * capacity);
+
+    if (map->indexes == NULL || map->slots == NULL) {
+        free(map->indexes);
+        free(map->slots);
+
+        map->indexes = NULL;
+        map->slots = NULL;
+
+        return false;
+    }
+
+    // every byte 0xff is -1
+    memset(map->indexes, 0xff, sizeof(int32_t) * map->table_size);
+
+    map->entries_used = 0;
+    map->entries_capacity = capacity;
+
+    return true;
+}
+
+/* drop the keys and values in insertion order and free both arrays */
+void drop_table_compact(HashMapBase *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->entries_used; ++i) {
+            if (map->slots[i].hash != 0) {
+                map->drop_func(map->slots[i].key, map->slots[i].value);
+            }
+        }
+    }
+
+    free(map->indexes);
+    free(map->slots);
+
+    map->indexes = NULL;
+    map->slots = NULL;
+}
+
+/* put a dense index in the first empty bucket from the home of the hash */
+static inline void _place_index(HashMapBase *map, uint64_t hash, int32_t at) {
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+
+    while (map->indexes[index] != COMPACT_EMPTY) {
+        index = (index + 1) & mask;
+    }
+
+    map->indexes[index] = at;
+}
+
+/** rebuild the table at a new size
+ *
+ * the slots are copied to a new dense array in order without the holes, the
+ * old arrays are only freed once the new ones are full
+ *
+ * @param new_table_size
+ *  the new table size, this can be the same as the old one to clean up holes
+ */
+enum HashMapResult rehash_compact(HashMapBase *map, int new_table_size) {
+    int32_t *old_indexes = map->indexes;
+    Slot *old_slots = map->slots;
+    int old_table_size = map->table_size;
+    int old_used = map->entries_used;
+    int old_capacity = map->entries_capacity;
+
+    map->table_size = new_table_size;
+
+    if (!alloc_table_compact(map)) {
+        map->indexes = old_indexes;
+        map->slots = old_slots;
+        map->table_size = old_table_size;
+        map->entries_used = old_used;
+        map->entries_capacity = old_capacity;
+
+        return FailedToRehashNoMemory;
+    }
+
+    for (int i = 0; i < old_used; ++i) {
+        if (old_slots[i].hash != 0) {
+            map->slots[map->entries_used] = old_slots[i];
+
+            _place_index(map, old_slots[i].hash, map->entries_used);
+
+            ++map->entries_used;
+        }
+    }
+
+    free(old_indexes);
+    free(old_slots);
+
+    return Success;
+}
+
+/** find the bucket in the index array that holds a key
+ *
+ * @param probes
+ *  set to how many buckets were looked at
+ *
+ * @return
+ *  the bucket or the empty bucket the key would go in
+ */
+static inline int _find_bucket(HashMapBase *map, uint64_t hash, void *key,
+                               int *probes) {
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+
+    *probes = 1;
+
+    while (map->indexes[index] != COMPACT_EMPTY) {
+        Slot *slot = &map->slots[map->indexes[index]];
+
+        if (slot->hash == hash && map->comp_func(slot->key, key)) {
+            return index;
+        }
+
+        index = (index + 1) & mask;
+        ++*probes;
+    }
+
+    return index;
+}
+
+/** find the slot for a key, adding it to the end of the dense array if it is
+ * not there
+ *
+ * @param found
+ *  set to true if the key was already in the table, if not the new slot has a
+ *  NULL value
+ *
+ * @return
+ *  the slot or NULL if the table needed cleaning up and there was no memory
+ */
+Slot *entry_compact(HashMapBase *map, uint64_t hash, void *key, bool *found) {
+    hash = robin_slot_hash(hash);
+
+    int probes;
+    int index = _find_bucket(map, hash, key, &probes);
+
+    if (map->indexes[index] != COMPACT_EMPTY) {
+        COUNT_LOOKUP(map, true, probes);
+
+        *found = true;
+        return &map->slots[map->indexes[index]];
+    }
+
+    COUNT_LOOKUP(map, false, probes);
+    CHECK_FLOODING(map, probes);
+
+    // the dense array is full of holes, rebuilding at the same size moves the
+    // live slots together, through resize_hashmap so it is counted as a pause
+    if (map->entries_used >= map->entries_capacity) {
+        if (resize_hashmap(map, map->table_size) != Success) {
+            return NULL;
+        }
+
+        index = _find_bucket(map, hash, key, &probes);
+    }
+
+    Slot *slot = &map->slots[map->entries_used];
+
+    slot->hash = hash;
+    slot->key = key;
+    slot->value = NULL;
+
+    map->indexes[index] = map->entries_used++;
+
+    *found = false;
+    return slot;
+}
+
+/** insert a key and value
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the table
+ */
+enum HashMapResult insert_compact(HashMapBase *map, uint64_t hash, void *key,
+                                  void *value) {
+    bool found;
+    Slot *slot = entry_compact(map, hash, key, &found);
+
+    if (slot == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    slot->value = value;
+
+    return Success;
+}
+
+/** find the slot holding the given key
+ *
+ * @return
+ *  the slot in the dense array or NULL if the key is not in the table
+ */
+Slot *find_slot_compact(HashMapBase *map, uint64_t hash, void *key) {
+    int probes;
+    int index = _find_bucket(map, robin_slot_hash(hash), key, &probes);
+    bool found = map->indexes[index] != COMPACT_EMPTY;
+
+    COUNT_LOOKUP(map, found, probes);
+
+    return found ? &map->slots[map->indexes[index]] : NULL;
+}
+
+/** remove a key and return its value
+ *
+ * the slot becomes a hole in the dense array, unless it is the last one, and
+ * the following buckets are shifted back over the removed one
+ */
+void *remove_entry_compact(HashMapBase *map, uint64_t hash, void *key) {
+    int probes;
+    int index = _find_bucket(map, robin_slot_hash(hash), key, &probes);
+
+    if (map->indexes[index] == COMPACT_EMPTY) {
+        return NULL;
+    }
+
+    int32_t at = map->indexes[index];
+    Slot *slot = &map->slots[at];
+    void *value = slot->value;
+
+    if (map->drop_func) {
+        map->drop_func(slot->key, NULL);
+    }
+
+    slot->hash = 0;
+
+    if (at == map->entries_used - 1) {
+        --map->entries_used;
+    }
+
+    int mask = map->table_size - 1;
+    int next = (index + 1) & mask;
+
+    // a bucket can move back if the gap is not before its home
+    while (map->indexes[next] != COMPACT_EMPTY) {
+        uint64_t next_hash = map->slots[map->indexes[next]].hash;
+
+        if (_compact_distance(map, next_hash, next) >=
+            ((next - index) & mask)) {
+            map->indexes[index] = map->indexes[next];
+            index = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    map->indexes[index] = COMPACT_EMPTY;
+
+    --map->current_size;
+
+    return value;
+}
+
+/* start loading the bucket a lookup for the hash looks at first */
+void prefetch_compact(HashMapBase *map, uint64_t hash) {
+    int index = robin_slot_hash(hash) & (map->table_size - 1);
+
+    __builtin_prefetch(&map->indexes[index]);
+}
+
+/** move the iter to the next slot in the dense array that is not a hole */
+void iter_next_base_compact(IterHashMap *iter) {
+    ++iter->current_index;
+
+    while (iter->current_index < iter_end(iter) &&
+           iter->base->slots[iter->current_index].hash == 0) {
+
+        ++iter->current_index;
+    }
+}
+
+bool iter_next_compact(IterHashMap *iter, void **key, void **value) {
+    if (iter->current_index >= iter_end(iter)) {
+        return false;
+    }
+
+    Slot *slot = &iter->base->slots[iter->current_index];
+
+    *key = slot->key;
+    *value = slot->value;
+
+    iter_next_base_compact(iter);
+
+    return true;
+}
+
+/** same as iter_next_compact but the arrays are freed after the last slot
+ *
+ * the dense array is one block so it goes in a single free
+ */
+bool iter_next_drop_compact(IterHashMap *iter, void **key, void **value) {
+    bool got_value = iter_next_compact(iter, key, value);
+
+    if (got_value && iter->current_index >= iter->base->entries_used) {
+        free(iter->base->indexes);
+        free(iter->base->slots);
+
+        iter->base->indexes = NULL;
+        iter->base->slots = NULL;
+    }
+
+    return got_value;
+}
+
+/* the longest probe sequence any key needs */
+int get_longest_chain_compact(HashMapBase *map) {
+    int longest = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->indexes[i] != COMPACT_EMPTY) {
+            uint64_t hash = map->slots[map->indexes[i]].hash;
+            int length = _compact_distance(map, hash, i) + 1;
+
+            if (length > longest) {
+                longest = length;
+            }
+        }
+    }
+
+    return longest;
+}
+
+/** fill in the parts of the stats that depend on the layout
+ *
+ * with linear probing a miss walks to the first empty bucket, the holes in
+ * the dense array are counted as deleted
+ */
+void get_stats_compact(HashMapBase *map, HashMapStats *stats) {
+    int mask = map->table_size - 1;
+    uint64_t hit_probes = 0;
+    uint64_t miss_probes = 0;
+    int empty = 0;
+    int run = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->indexes[i] == COMPACT_EMPTY) {
+            ++empty;
+        } else {
+            uint64_t hash = map->slots[map->indexes[i]].hash;
+            int length = _compact_distance(map, hash, i) + 1;
+
+            stats_add_length(stats, length);
+            hit_probes += length;
+        }
+    }
+
+    // a miss starting in a run of full buckets walks to the end of the run,
+    // going backwards from an empty bucket gives every run length at once
+    for (int i = 0; i < map->table_size && empty > 0; ++i) {
+        if (map->indexes[i] == COMPACT_EMPTY) {
+            run = i;
+            break;
+        }
+    }
+
+    for (int step = 0, left = 0; step < map->table_size && empty > 0;
+         ++step) {
+        int i = (run - step) & mask;
+
+        left = map->indexes[i] == COMPACT_EMPTY ? 0 : left + 1;
+        miss_probes += left + 1;
+    }
+
+    stats->deleted_size = map->entries_used - map->current_size;
+    stats->empty_fraction = (double)empty / map->table_size;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+    stats->miss_probes = (double)miss_probes / map->table_size;
+    stats->bytes_used = sizeof(int32_t) * map->table_size +
+                        sizeof(Slot) * map->entries_capacity;
+}
@@ -0,0 +1,195 @@
+#include "hashmap_concurrent.h"
+#include "hashmap_internal.h"
+
+/** the sharded concurrent hashmap
+ *
+ * every operation hashes the key once, takes the lock of the shard the high
+ * bits of the hash point to and then does the same thing the single threaded
+ * map does with the hash it already has
+ *
+ * lookups take the read lock so they only wait on writers to the same shard,
+ * inserts and removes take the write lock
+ *
+ * the chained backends incremental rehashing moves buckets during lookups so it
+ * can not be used here, every shard rehashes in one go under its write lock
+ */
+
+/* the shard for a hash */
+static inline HashMapShard *_get_shard(ConcurrentHashMap *map, uint64_t hash) {
+    if (map->shard_bits == 0) {
+        return &map->shards[0];
+    }
+
+    return &map->shards[hash >> (64 - map->shard_bits)];
+}
+
+/** init the concurrent hashmap
+ *
+ * @param hash_func
+ *  the hash function, all 64 bits should be well mixed as the high bits pick
+ *  the shard
+ *
+ * @param comp_func
+ *  a function that should return true if the keys match and false if they dont
+ *
+ * @param drop_func
+ *  a function that will receive the key and value for each entry
+ *
+ * @param shard_bits
+ *  there will be 2^shard_bits shards, something like 4 to 8 times the amount
+ *  of threads using the map works well
+ *
+ * @param backend
+ *  the storage layout each shard uses
+ */
+ConcurrentHashMap *init_concurrent_hashmap_base(HashFunc hash_func,
+                                                CompFunc comp_func,
+                                                DropFunc drop_func,
+                                                int shard_bits,
+                                                enum HashMapBackend backend) {
+    if (shard_bits < 0 || shard_bits > 16) {
+        return NULL;
+    }
+
+    ConcurrentHashMap *map = malloc(sizeof(ConcurrentHashMap));
+
+    if (map == NULL) {
+        return NULL;
+    }
+
+    int shard_count = 1 << shard_bits;
+
+    map->shard_bits = shard_bits;
+    map->hash_func = hash_func;
+    map->shards = aligned_alloc(64, sizeof(HashMapShard) * shard_count);
+
+    if (map->shards == NULL) {
+        free(map);
+        return NULL;
+    }
+
+    // the total starting size is the same as a single map
+    int shard_size = STARTING_SIZE >> shard_bits;
+
+    if (shard_size < 16) {
+        shard_size = 16;
+    }
+
+    for (int i = 0; i < shard_count; ++i) {
+        HashMapShard *shard = &map->shards[i];
+
+        shard->map = init_hashmap_base(hash_func, comp_func, drop_func,
+                                       shard_size, backend);
+
+        if (shard->map == NULL) {
+            for (int j = 0; j < i; ++j) {
+                pthread_rwlock_destroy(&map->shards[j].lock);
+                drop_hashmap_base(map->shards[j].map);
+            }
+
+            free(map->shards);
+            free(map);
+
+            return NULL;
+        }
+
+        pthread_rwlock_init(&shard->lock, NULL);
+    }
+
+    return map;
+}
+
+/** drop all the shards
+ *
+ * no other thread can be using the map at this point
+ */
+void drop_concurrent_hashmap_base(ConcurrentHashMap *map) {
+    int shard_count = 1 << map->shard_bits;
+
+    for (int i = 0; i < shard_count; ++i) {
+        pthread_rwlock_destroy(&map->shards[i].lock);
+        drop_hashmap_base(map->shards[i].map);
+    }
+
+    free(map->shards);
+    free(map);
+}
+
+enum HashMapResult insert_concurrent_hashmap_base(ConcurrentHashMap *map,
+                                                  void *key, void *value) {
+    uint64_t hash = map->hash_func(key);
+    HashMapShard *shard = _get_shard(map, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+
+    enum HashMapResult result =
+        insert_hashmap_hashed(shard->map, hash, key, value);
+
+    pthread_rwlock_unlock(&shard->lock);
+
+    return result;
+}
+
+bool contains_key_concurrent_hashmap_base(ConcurrentHashMap *map, void *key) {
+    uint64_t hash = map->hash_func(key);
+    HashMapShard *shard = _get_shard(map, hash);
+
+    pthread_rwlock_rdlock(&shard->lock);
+
+    bool found = contains_key_hashmap_hashed(shard->map, hash, key);
+
+    pthread_rwlock_unlock(&shard->lock);
+
+    return found;
+}
+
+/** get the value for a key
+ *
+ * the value is not protected once the lock is released, if other threads can
+ * remove the key the caller has to make sure the value stays alive
+ */
+void *get_value_concurrent_hashmap_base(ConcurrentHashMap *map, void *key) {
+    uint64_t hash = map->hash_func(key);
+    HashMapShard *shard = _get_shard(map, hash);
+
+    pthread_rwlock_rdlock(&shard->lock);
+
+    void *value = get_value_hashmap_hashed(shard->map, hash, key);
+
+    pthread_rwlock_unlock(&shard->lock);
+
+    return value;
+}
+
+void *remove_entry_concurrent_hashmap_base(ConcurrentHashMap *map, void *key) {
+    uint64_t hash = map->hash_func(key);
+    HashMapShard *shard = _get_shard(map, hash);
+
+    pthread_rwlock_wrlock(&shard->lock);
+
+    void *value = remove_entry_hashmap_hashed(shard->map, hash, key);
+
+    pthread_rwlock_unlock(&shard->lock);
+
+    return value;
+}
+
+/** the amount of entrys in all the shards
+ *
+ * the shards are locked one at a time so this is only exact if no other thread
+ * is inserting or removing
+ */
+int get_size_concurrent_hashmap_base(ConcurrentHashMap *map) {
+    int shard_count = 1 << map->shard_bits;
+    int size = 0;
+
+    for (int i = 0; i < shard_count; ++i) {
+        pthread_rwlock_rdlock(&map->shards[i].lock);
+
+        size += map->shards[i].map->current_size;
+
+        pthread_rwlock_unlock(&map->shards[i].lock);
+    }
+
+    return size;
+}
@@ -0,0 +1,49 @@
+#ifndef MY_HASHMAP_CONCURRENT
+#define MY_HASHMAP_CONCURRENT
+
+#include <pthread.h>
+
+#include "hashmap_base.h"
+
+/* a shard of the concurrent hashmap
+ *
+ * each shard is a whole HashMapBase with its own lock, the shards are cache
+ * line aligned so locking one shard does not slow down the ones next to it
+ */
+typedef struct {
+    pthread_rwlock_t lock;
+    HashMapBase *map;
+} __attribute__((aligned(64))) HashMapShard;
+
+/* a thread safe hashmap split in to independent shards
+ *
+ * the high bits of the hash pick the shard and the shard mixes in its own seed
+ * to pick the bucket, so every shard grows and rehashes on its own under its
+ * own lock
+ */
+typedef struct {
+    int shard_bits;
+    HashFunc hash_func;
+    HashMapShard *shards;
+} ConcurrentHashMap;
+
+ConcurrentHashMap *init_concurrent_hashmap_base(HashFunc hash_func,
+                                                CompFunc comp_func,
+                                                DropFunc drop_func,
+                                                int shard_bits,
+                                                enum HashMapBackend backend);
+
+void drop_concurrent_hashmap_base(ConcurrentHashMap *map);
+
+enum HashMapResult insert_concurrent_hashmap_base(ConcurrentHashMap *map,
+                                                  void *key, void *value);
+
+bool contains_key_concurrent_hashmap_base(ConcurrentHashMap *map, void *key);
+
+void *get_value_concurrent_hashmap_base(ConcurrentHashMap *map, void *key);
+
+void *remove_entry_concurrent_hashmap_base(ConcurrentHashMap *map, void *key);
+
+int get_size_concurrent_hashmap_base(ConcurrentHashMap *map);
+
+#endif
@@ -0,0 +1,488 @@
+#include <string.h>
+
+#include "hashmap_internal.h"
+
+/** the bucketized cuckoo backend
+ *
+ * the slots are split in to buckets of CUCKOO_WAYS and every key can only be
+ * in one of two buckets, the low bits of the hash pick the first and the high
+ * bits the second, so a lookup never looks at more than two buckets no matter
+ * how full the table is
+ *
+ * next to the slots there is one tag byte per slot with 8 bits of the hash, 0
+ * marks an empty slot, the 4 tags of a bucket are in the same cache line so a
+ * lookup reads one line of tags per bucket and only loads a slot when its tag
+ * matches, a miss almost never leaves the tags
+ *
+ * when both buckets of a new key are full a breadth first search looks for
+ * the shortest chain of keys that can each move to their other bucket to
+ * free up a slot, if there is none in CUCKOO_BFS_NODES buckets the table
+ * grows
+ */
+
+#define CUCKOO_WAYS 4
+
+/* the most buckets the search for a free slot will look at */
+#define CUCKOO_BFS_NODES 256
+
+/* the smallest table, two buckets so every key has a second one */
+int min_table_size_cuckoo(void) {
+    return CUCKOO_WAYS * 2;
+}
+
+/* the tag of a hash, never 0 so it can not look like an empty slot */
+static inline uint8_t _cuckoo_tag(uint64_t hash) {
+    uint8_t tag = hash >> 56;
+
+    return tag == 0 ? 1 : tag;
+}
+
+static inline int _first_bucket(HashMapBase *map, uint64_t hash) {
+    return hash & (map->table_size / CUCKOO_WAYS - 1);
+}
+
+/* the second bucket is never the same as the first so every key has two */
+static inline int _second_bucket(HashMapBase *map, uint64_t hash) {
+    int first = _first_bucket(map, hash);
+    int second = (hash >> 32) & (map->table_size / CUCKOO_WAYS - 1);
+
+    return second == first ? first ^ 1 : second;
+}
+
+/* the bucket a key in the given bucket could move to */
+static inline int _other_bucket(HashMapBase *map, uint64_t hash, int bucket) {
+    int first = _first_bucket(map, hash);
+
+    return bucket == first ? _second_bucket(map, hash) : first;
+}
+
+/** find a key in one bucket
+ *
+ * @return
+ *  the index of the slot or -1 if it is not in the bucket
+ */
+static inline int _find_in_bucket(HashMapBase *map, int bucket, uint8_t tag,
+                                  uint64_t hash, void *key) {
+    const uint8_t *tags = map->ctrl + bucket * CUCKOO_WAYS;
+
+    for (int i = 0; i < CUCKOO_WAYS; ++i) {
+        if (tags[i] == tag) {
+            Slot *slot = &map->slots[bucket * CUCKOO_WAYS + i];
+
+            if (slot->hash == hash && map->comp_func(slot->key, key)) {
+                return bucket * CUCKOO_WAYS + i;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/* the index of an empty slot in a bucket or -1 if it is full */
+static inline int _free_in_bucket(HashMapBase *map, int bucket) {
+    const uint8_t *tags = map->ctrl + bucket * CUCKOO_WAYS;
+
+    for (int i = 0; i < CUCKOO_WAYS; ++i) {
+        if (tags[i] == 0) {
+            return bucket * CUCKOO_WAYS + i;
+        }
+    }
+
+    return -1;
+}
+
+/** find the slot of a key
+ *
+ * @param probes
+ *  set to how many buckets were looked at
+ */
+static inline int _find_index(HashMapBase *map, uint64_t hash, void *key,
+                              int *probes) {
+    uint8_t tag = _cuckoo_tag(hash);
+    int index = _find_in_bucket(map, _first_bucket(map, hash), tag, hash, key);
+
+    *probes = 1;
+
+    if (index == -1) {
+        *probes = 2;
+        index = _find_in_bucket(map, _second_bucket(map, hash), tag, hash, key);
+    }
+
+    return index;
+}
+
+/** allocate the tags and slots for map->table_size
+ *
+ * table_size needs to be a power of two that is at least
+ * min_table_size_cuckoo
+ *
+ * @return
+ *  false if there was no memory
+ */
+bool alloc_table_cuckoo(HashMapBase *map) {
+    map->ctrl = calloc(map->table_size, sizeof(uint8_t));
+    map->slots = malloc(sizeof(Slot) * map->table_size);
+
+    if (map->ctrl == NULL || map->slots == NULL) {
+        free(map->ctrl);
+        free(map->slots);
+
+        map->ctrl = NULL;
+        map->slots = NULL;
+
+        return false;
+    }
+
+    return true;
+}
+
+/* drop every key and value and free the table */
+void drop_table_cuckoo(HashMapBase *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->table_size; ++i) {
+            if (map->ctrl[i] != 0) {
+                map->drop_func(map->slots[i].key, map->slots[i].value);
+            }
+        }
+    }
+
+    free(map->ctrl);
+    free(map->slots);
+
+    map->ctrl = NULL;
+    map->slots = NULL;
+}
+
+static inline void _set_slot(HashMapBase *map, int index, Slot slot) {
+    map->ctrl[index] = _cuckoo_tag(slot.hash);
+    map->slots[index] = slot;
+}
+
+/** make room for a key in one of its buckets
+ *
+ * the search goes out from both buckets of the hash one bucket at a time, a
+ * bucket is not queued if it is already on the path to it so the keys on the
+ * path that is found are all in different buckets and can be moved from the
+ * end of the path back to the start without any of them being moved twice
+ *
+ * @return
+ *  the free slot in one of the buckets of the hash or -1 if there was no path
+ */
+static int _make_room(HashMapBase *map, uint64_t hash) {
+    struct {
+        int bucket;
+        int parent;
+        int way;
+    } queue[CUCKOO_BFS_NODES];
+
+    int tail = 2;
+
+    queue[0].bucket = _first_bucket(map, hash);
+    queue[0].parent = -1;
+    queue[1].bucket = _second_bucket(map, hash);
+    queue[1].parent = -1;
+
+    for (int head = 0; head < tail; ++head) {
+        int index = _free_in_bucket(map, queue[head].bucket);
+
+        if (index != -1) {
+            // walk back to the start moving each key in to the slot the one
+            // after it left
+            for (int node = head; queue[node].parent != -1;
+                 node = queue[node].parent) {
+
+                int from = queue[queue[node].parent].bucket * CUCKOO_WAYS +
+                           queue[node].way;
+
+                _set_slot(map, index, map->slots[from]);
+                map->ctrl[from] = 0;
+
+                index = from;
+            }
+
+            return index;
+        }
+
+        for (int way = 0; way < CUCKOO_WAYS && tail < CUCKOO_BFS_NODES;
+             ++way) {
+
+            Slot *slot = &map->slots[queue[head].bucket * CUCKOO_WAYS + way];
+            int other = _other_bucket(map, slot->hash, queue[head].bucket);
+            bool on_path = false;
+
+            for (int node = head; node != -1 && !on_path;
+                 node = queue[node].parent) {
+
+                on_path = queue[node].bucket == other;
+            }
+
+            if (!on_path) {
+                queue[tail].bucket = other;
+                queue[tail].parent = head;
+                queue[tail].way = way;
+                ++tail;
+            }
+        }
+    }
+
+    return -1;
+}
+
+/** place every full slot of an old table in the current one
+ *
+ * @return
+ *  false if one of them did not fit
+ */
+static bool _place_all(HashMapBase *map, const uint8_t *old_ctrl,
+                       const Slot *old_slots, int old_table_size) {
+    for (int i = 0; i < old_table_size; ++i) {
+        if (old_ctrl[i] == 0) {
+            continue;
+        }
+
+        int index = _make_room(map, old_slots[i].hash);
+
+        if (index == -1) {
+            return false;
+        }
+
+        _set_slot(map, index, old_slots[i]);
+    }
+
+    return true;
+}
+
+/** rehash in to a new table of the given size
+ *
+ * if a key does not fit the new table is thrown away and one twice the size is
+ * tried, that only happens when the table is being shrunk or reseeded
+ *
+ * @param new_table_size
+ *  the new table size, a power of two, the table can end up bigger
+ */
+enum HashMapResult rehash_cuckoo(HashMapBase *map, int new_table_size) {
+    uint8_t *old_ctrl = map->ctrl;
+    Slot *old_slots = map->slots;
+    int old_table_size = map->table_size;
+
+    map->table_size = new_table_size;
+
+    while (alloc_table_cuckoo(map)) {
+        if (_place_all(map, old_ctrl, old_slots, old_table_size)) {
+            free(old_ctrl);
+            free(old_slots);
+
+            return Success;
+        }
+
+        free(map->ctrl);
+        free(map->slots);
+
+        if (map->table_size >= MAX_TABLE_SIZE) {
+            break;
+        }
+
+        map->table_size *= 2;
+    }
+
+    map->ctrl = old_ctrl;
+    map->slots = old_slots;
+    map->table_size = old_table_size;
+
+    return FailedToRehashNoMemory;
+}
+
+/** find the slot for a key, adding the key if it is not there
+ *
+ * if there is no room for the key the table grows, unless it is under half
+ * full, then the keys must share a lot more than their bucket bits and a
+ * bigger table would not help, the map is marked as flooded so the next
+ * insert reseeds and this one fails
+ *
+ * @param found
+ *  set to true if the key was already in the table, if not the new slot has a
+ *  NULL value
+ *
+ * @return
+ *  the slot or NULL if the key could not be placed
+ */
+Slot *entry_cuckoo(HashMapBase *map, uint64_t hash, void *key, bool *found) {
+    int probes;
+    int index = _find_index(map, hash, key, &probes);
+
+    COUNT_LOOKUP(map, index != -1, probes);
+
+    *found = index != -1;
+
+    if (index != -1) {
+        return &map->slots[index];
+    }
+
+    while ((index = _make_room(map, hash)) == -1) {
+        if (map->current_size < map->table_size / 2) {
+            map->flooded = true;
+            return NULL;
+        }
+
+        if (map->table_size > MAX_TABLE_SIZE / map->growth_factor ||
+            resize_hashmap(map, map->table_size * map->growth_factor) !=
+                Success) {
+            return NULL;
+        }
+    }
+
+    Slot slot = {.hash = hash, .key = key, .value = NULL};
+
+    _set_slot(map, index, slot);
+
+    return &map->slots[index];
+}
+
+/* insert a key and value, the slot for it is found with entry_cuckoo */
+enum HashMapResult insert_cuckoo(HashMapBase *map, uint64_t hash, void *key,
+                                 void *value) {
+    bool found;
+    Slot *slot = entry_cuckoo(map, hash, key, &found);
+
+    if (slot == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    slot->value = value;
+
+    return Success;
+}
+
+Slot *find_slot_cuckoo(HashMapBase *map, uint64_t hash, void *key) {
+    int probes;
+    int index = _find_index(map, hash, key, &probes);
+
+    COUNT_LOOKUP(map, index != -1, probes);
+
+    return index == -1 ? NULL : &map->slots[index];
+}
+
+/** remove a key and return its value
+ *
+ * nothing ever probes past a slot so clearing the tag is enough
+ */
+void *remove_entry_cuckoo(HashMapBase *map, uint64_t hash, void *key) {
+    int probes;
+    int index = _find_index(map, hash, key, &probes);
+
+    if (index == -1) {
+        return NULL;
+    }
+
+    void *value = map->slots[index].value;
+
+    if (map->drop_func) {
+        map->drop_func(map->slots[index].key, NULL);
+    }
+
+    map->ctrl[index] = 0;
+
+    --map->current_size;
+
+    return value;
+}
+
+/* start loading the tags of both buckets and the slots of the first */
+void prefetch_cuckoo(HashMapBase *map, uint64_t hash) {
+    int first = _first_bucket(map, hash) * CUCKOO_WAYS;
+
+    __builtin_prefetch(&map->ctrl[first]);
+    __builtin_prefetch(&map->ctrl[_second_bucket(map, hash) * CUCKOO_WAYS]);
+    __builtin_prefetch(&map->slots[first]);
+}
+
+/** move the iter to the next full slot */
+void iter_next_base_cuckoo(IterHashMap *iter) {
+    ++iter->current_index;
+
+    while (iter->current_index < iter_end(iter) &&
+           iter->base->ctrl[iter->current_index] == 0) {
+
+        ++iter->current_index;
+    }
+}
+
+bool iter_next_cuckoo(IterHashMap *iter, void **key, void **value) {
+    if (iter->current_index >= iter_end(iter)) {
+        return false;
+    }
+
+    Slot *slot = &iter->base->slots[iter->current_index];
+
+    *key = slot->key;
+    *value = slot->value;
+
+    iter_next_base_cuckoo(iter);
+
+    return true;
+}
+
+bool iter_next_drop_cuckoo(IterHashMap *iter, void **key, void **value) {
+    bool got_value = iter_next_cuckoo(iter, key, value);
+
+    if (got_value && iter->current_index >= iter->base->table_size) {
+        free(iter->base->ctrl);
+        free(iter->base->slots);
+
+        iter->base->ctrl = NULL;
+        iter->base->slots = NULL;
+    }
+
+    return got_value;
+}
+
+/* how many buckets the lookup for the key in a slot looks at */
+static inline int _slot_length(HashMapBase *map, int index) {
+    return _first_bucket(map, map->slots[index].hash) == index / CUCKOO_WAYS
+               ? 1
+               : 2;
+}
+
+/* the most buckets any key has to look at, this is never more than 2 */
+int get_longest_chain_cuckoo(HashMapBase *map) {
+    int longest = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->ctrl[i] != 0 && _slot_length(map, i) > longest) {
+            longest = _slot_length(map, i);
+        }
+    }
+
+    return longest;
+}
+
+/** fill in the parts of the stats that depend on the layout
+ *
+ * a miss always looks at both buckets
+ */
+void get_stats_cuckoo(HashMapBase *map, HashMapStats *stats) {
+    uint64_t hit_probes = 0;
+    int empty = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->ctrl[i] == 0) {
+            ++empty;
+            continue;
+        }
+
+        int length = _slot_length(map, i);
+
+        stats_add_length(stats, length);
+        hit_probes += length;
+    }
+
+    stats->empty_fraction = (double)empty / map->table_size;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+    stats->miss_probes = 2;
+    stats->bytes_used = (sizeof(Slot) + sizeof(uint8_t)) * map->table_size;
+}
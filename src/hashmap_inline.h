@@ -0,0 +1,263 @@
+#ifndef MY_HASHMAP_INLINE
+#define MY_HASHMAP_INLINE
+
+#include "hashmap_base.h"
+#include "hashmap_robin.h"
+
+/** general info
+ *
+ * the HASHMAP_INLINE macro generates a whole hashmap for one key and value
+ * type, unlike the HASHMAP macro nothing goes through HashMapBase
+ *
+ * the keys and values are stored by value in the slots and the hash and compare
+ * functions are called directly so the compiler can inline them, this means
+ * there is no allocation per entry and no function pointers
+ *
+ * the table uses the same robin hood probing as the HashMapOpen backend from
+ * hashmap_robin.h, a hash of zero marks an empty slot
+ *
+ * the hashes are mixed with the seed of the map, see FLOOD_PROBE_LENGTH
+ *
+ * the generated functions are all static inline so the macro can be used in a
+ * header
+ */
+
+/* a macro to define a type specialized hashmap with inline storage
+ *
+ * @param name
+ *  the name of the map type, the functions are named after it, for example
+ *  init_##name and insert_##name
+ *
+ * @param key_type
+ *  the key type, this is copied in to the table
+ *
+ * @param data_type
+ *  the value type, this is copied in to the table
+ *
+ * @param hash_func
+ *  a function or macro that takes a key_type and returns a uint64_t
+ *
+ * @param comp_func
+ *  a function or macro that takes two key_type and returns true if they match
+ */
+#define HASHMAP_INLINE(name, key_type, data_type, hash_func, comp_func)        \
+    typedef struct {                                                           \
+        uint64_t hash;                                                         \
+        key_type key;                                                          \
+        data_type value;                                                       \
+    } name##Slot;                                                              \
+                                                                               \
+    typedef struct {                                                           \
+        int table_size;                                                        \
+        int current_size;                                                      \
+        int threshold;                                                         \
+        name##Slot *slots;                                                     \
+        uint64_t seed;                                                         \
+        bool flooded;                                                          \
+        int reseed_size;                                                       \
+    } name;                                                                    \
+                                                                               \
+    ROBIN_HOOD_SLOTS(name, name##Slot)                                         \
+                                                                               \
+    static inline uint64_t _hash_##name(name *map, key_type key) {             \
+        return robin_slot_hash(mix_seed(map->seed, hash_func(key)));           \
+    }                                                                          \
+                                                                               \
+    /* size needs to be a power of two */                                      \
+    static inline name *init_##name(int size) {                                \
+        name *map = malloc(sizeof(name));                                      \
+                                                                               \
+        if (map == NULL) {                                                     \
+            return NULL;                                                       \
+        }                                                                      \
+                                                                               \
+        map->slots = calloc(size, sizeof(name##Slot));                         \
+                                                                               \
+        if (map->slots == NULL) {                                              \
+            free(map);                                                         \
+            return NULL;                                                       \
+        }                                                                      \
+                                                                               \
+        map->table_size = size;                                                \
+        map->current_size = 0;                                                 \
+        map->threshold = size * MAX_LOAD_FACTOR;                               \
+        map->seed = new_seed();                                                \
+        map->flooded = false;                                                  \
+        map->reseed_size = 0;                                                  \
+                                                                               \
+        return map;                                                            \
+    }                                                                          \
+                                                                               \
+    static inline void drop_##name(name *map) {                                \
+        free(map->slots);                                                      \
+        free(map);                                                             \
+    }                                                                          \
+                                                                               \
+    static inline enum HashMapResult _rehash_##name(name *map) {               \
+        int old_table_size = map->table_size;                                  \
+        name##Slot *old_slots = map->slots;                                    \
+                                                                               \
+        map->slots = calloc(old_table_size * GROWTH_FACTOR,                    \
+                            sizeof(name##Slot));                               \
+                                                                               \
+        if (map->slots == NULL) {                                              \
+            map->slots = old_slots;                                            \
+            return FailedToRehashNoMemory;                                     \
+        }                                                                      \
+                                                                               \
+        map->table_size = old_table_size * GROWTH_FACTOR;                      \
+        map->threshold = map->table_size * MAX_LOAD_FACTOR;                    \
+                                                                               \
+        robin_move_all_##name(map->slots, NULL, map->table_size - 1,           \
+                              old_slots, NULL, old_table_size);                \
+                                                                               \
+        free(old_slots);                                                       \
+                                                                               \
+        return Success;                                                        \
+    }                                                                          \
+                                                                               \
+    /* the hash of a slot under a new seed for robin_reseed_##name */          \
+    static inline uint64_t _reseed_hash_##name(void *map,                      \
+                                               const name##Slot *slot) {       \
+        return _hash_##name(map, slot->key);                                   \
+    }                                                                          \
+                                                                               \
+    /* find the index of the slot for a key or -1 */                           \
+    static inline int _find_##name(name *map, key_type key) {                  \
+        uint64_t hash = _hash_##name(map, key);                                \
+        int mask = map->table_size - 1;                                        \
+        int index = hash & mask;                                               \
+        int distance = 0;                                                      \
+                                                                               \
+        while (robin_probe_##name(map->slots, mask, hash, &index,              \
+                                  &distance)) {                                \
+            if (comp_func(map->slots[index].key, key)) {                       \
+                return index;                                                  \
+            }                                                                  \
+                                                                               \
+            index = (index + 1) & mask;                                        \
+            ++distance;                                                        \
+        }                                                                      \
+                                                                               \
+        return -1;                                                             \
+    }                                                                          \
+                                                                               \
+    /* one walk finds a duplicate or the slot for the key, see entry_open */   \
+    static inline enum HashMapResult insert_##name(name *map, key_type key,    \
+                                                   data_type value) {          \
+        if (map->flooded) {                                                    \
+            robin_reseed_##name(map, &map->slots, map->table_size,             \
+                                map->current_size, &map->seed,                 \
+                                &map->flooded, &map->reseed_size,              \
+                                _reseed_hash_##name);                          \
+        }                                                                      \
+                                                                               \
+        if (map->current_size + 1 >= map->threshold) {                         \
+            enum HashMapResult result = _rehash_##name(map);                   \
+                                                                               \
+            if (result != Success) {                                           \
+                return result;                                                 \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        uint64_t hash = _hash_##name(map, key);                                \
+        int mask = map->table_size - 1;                                        \
+        int index = hash & mask;                                               \
+        int distance = 0;                                                      \
+                                                                               \
+        while (robin_probe_##name(map->slots, mask, hash, &index,              \
+                                  &distance)) {                                \
+            if (comp_func(map->slots[index].key, key)) {                       \
+                return FailedToInsertDuplicate;                                \
+            }                                                                  \
+                                                                               \
+            index = (index + 1) & mask;                                        \
+            ++distance;                                                        \
+        }                                                                      \
+                                                                               \
+        /* CHECK_FLOODING is internal so the check is written out here */      \
+        if (distance + 1 > FLOOD_PROBE_LENGTH) {                               \
+            map->flooded = true;                                               \
+        }                                                                      \
+                                                                               \
+        name##Slot slot = {.hash = hash, .key = key, .value = value};          \
+                                                                               \
+        robin_place_##name(map->slots, NULL, mask, slot, 0, index, distance);  \
+                                                                               \
+        ++map->current_size;                                                   \
+                                                                               \
+        return Success;                                                        \
+    }                                                                          \
+                                                                               \
+    /* returns a pointer to the value in the table or NULL */                  \
+    static inline data_type *get_value_##name(name *map, key_type key) {       \
+        int index = _find_##name(map, key);                                    \
+                                                                               \
+        return index == -1 ? NULL : &map->slots[index].value;                  \
+    }                                                                          \
+                                                                               \
+    static inline bool contains_key_##name(name *map, key_type key) {          \
+        return _find_##name(map, key) != -1;                                   \
+    }                                                                          \
+                                                                               \
+    /* copy the removed value to value_to_fill if it is not NULL */            \
+    static inline bool remove_entry_##name(name *map, key_type key,            \
+                                           data_type *value_to_fill) {         \
+        int index = _find_##name(map, key);                                    \
+                                                                               \
+        if (index == -1) {                                                     \
+            return false;                                                      \
+        }                                                                      \
+                                                                               \
+        if (value_to_fill) {                                                   \
+            *value_to_fill = map->slots[index].value;                          \
+        }                                                                      \
+                                                                               \
+        robin_shift_##name(map->slots, NULL, map->table_size - 1, index);      \
+                                                                               \
+        --map->current_size;                                                   \
+                                                                               \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    /* move index to the next full slot and copy out its key and value */      \
+    static inline bool iter_next_##name(name *map, int *index, key_type *key,  \
+                                        data_type *value) {                    \
+        do {                                                                   \
+            ++*index;                                                          \
+        } while (*index < map->table_size && map->slots[*index].hash == 0);    \
+                                                                               \
+        if (*index >= map->table_size) {                                       \
+            return false;                                                      \
+        }                                                                      \
+                                                                               \
+        *key = map->slots[*index].key;                                         \
+        *value = map->slots[*index].value;                                     \
+                                                                               \
+        return true;                                                           \
+    }                                                                          \
+                                                                               \
+    /* end on a declaration so the macro can be used with a semicolon */       \
+    static inline void drop_##name(name *map)
+
+/** iterate over a map from HASHMAP_INLINE
+ *
+ * it is not safe to insert or remove while iterating
+ *
+ * @param name
+ *  the name given to HASHMAP_INLINE
+ *
+ * @param map
+ *  the map to iterate over
+ *
+ * @param key
+ *  a key_type variable to copy each key to
+ *
+ * @param value
+ *  a data_type variable to copy each value to
+ */
+#define for_each_inline(name, map, key, value)                                 \
+    for (int _inline_index = -1;                                               \
+         iter_next_##name(map, &_inline_index, &key, &value);)
+
+#endif
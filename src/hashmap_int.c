@@ -0,0 +1,378 @@
+#include <string.h>
+
+#include "hashmap_int.h"
+#include "hashmap_internal.h"
+
+/** the uint64_t key map
+ *
+ * the table uses linear probing, a key is always in the run of full slots that
+ * starts at its home slot so a lookup can stop at the first empty slot, removes
+ * shift the following keys back so there are no tombstones
+ *
+ * a probe loads a group of 4 keys, compares them all and only then branches,
+ * the compares have no dependency on each other so they run in parallel
+ *
+ * the keys and values are kept together rather than in two arrays, with two
+ * arrays a miss reads a little less memory but a hit has to load both
+ */
+
+/* the amount of keys a probe checks at once */
+#define INT_GROUP 4
+
+/* the seeded hash of a key, mix_seed is a full multiply of the key so the key
+ * goes straight in to it
+ */
+static inline uint64_t _int_hash(IntHashMap *map, uint64_t key) {
+    return mix_seed(map->seed, key);
+}
+
+/* set a key and keep the mirrored slots at the end of the table in sync */
+static inline void _set_key(IntHashMap *map, int index, uint64_t key) {
+    map->slots[index].key = key;
+
+    if (index < INT_GROUP - 1) {
+        map->slots[map->table_size + index].key = key;
+    }
+}
+
+/* bit i is set if slots[i] has the key */
+static inline unsigned _match_group(const IntSlot *slots, uint64_t key) {
+    return (unsigned)(slots[0].key == key) |
+           (unsigned)(slots[1].key == key) << 1 |
+           (unsigned)(slots[2].key == key) << 2 |
+           (unsigned)(slots[3].key == key) << 3;
+}
+
+/** allocate the arrays for a table size
+ *
+ * @return
+ *  false if there was no memory
+ */
+static bool _alloc_table(IntHashMap *map, int table_size) {
+    size_t bytes = sizeof(IntSlot) * (table_size + INT_GROUP - 1);
+    IntSlot *slots = malloc(bytes);
+
+    if (slots == NULL) {
+        return false;
+    }
+
+    // every byte 0xff is INT_EMPTY_KEY, the values are set on insert
+    memset(slots, 0xff, bytes);
+
+    map->slots = slots;
+    map->table_size = table_size;
+    map->threshold = table_size * MAX_LOAD_FACTOR;
+
+    return true;
+}
+
+/** init an IntHashMap
+ *
+ * @param drop_func
+ *  a function that will receive the key and value for each entry or NULL
+ */
+IntHashMap *init_int_hashmap(IntDropFunc drop_func) {
+    IntHashMap *map = malloc(sizeof(IntHashMap));
+
+    if (map == NULL) {
+        return NULL;
+    }
+
+    if (!_alloc_table(map, STARTING_SIZE)) {
+        free(map);
+        return NULL;
+    }
+
+    map->current_size = 0;
+    map->seed = new_seed();
+    map->flooded = false;
+    map->reseed_size = 0;
+    map->has_empty_key = false;
+    map->empty_key_value = NULL;
+    map->drop_func = drop_func;
+
+    return map;
+}
+
+/* drop every value with the drop_func and free the map */
+void drop_int_hashmap(IntHashMap *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->table_size; ++i) {
+            if (map->slots[i].key != INT_EMPTY_KEY) {
+                map->drop_func(map->slots[i].key, map->slots[i].value);
+            }
+        }
+
+        if (map->has_empty_key) {
+            map->drop_func(INT_EMPTY_KEY, map->empty_key_value);
+        }
+    }
+
+    free(map->slots);
+    free(map);
+}
+
+/** find the slot for a key
+ *
+ * @param found
+ *  set to true if the key is in the table
+ *
+ * @param probes
+ *  set to how many groups from the home slot of the key it is, counted in
+ *  groups like the swiss backend as linear probing has long runs on its own
+ *
+ * @return
+ *  the slot of the key or the empty slot it would go in
+ */
+static inline int _find_slot(IntHashMap *map, uint64_t key, bool *found,
+                             int *probes) {
+    int mask = map->table_size - 1;
+    int home = _int_hash(map, key) & mask;
+    int index = home;
+
+    while (true) {
+        const IntSlot *group = &map->slots[index];
+        unsigned match = _match_group(group, key);
+        unsigned empty = _match_group(group, INT_EMPTY_KEY);
+
+        // keys are unique and a key can not be past an empty slot from its
+        // home, so any match is the key
+        if (match || empty) {
+            *found = match != 0;
+            index = (index + __builtin_ctz(match ? match : empty)) & mask;
+            *probes = ((index - home) & mask) / INT_GROUP + 1;
+
+            return index;
+        }
+
+        index = (index + INT_GROUP) & mask;
+    }
+}
+
+/* move the keys in to a new table, the keys are hashed again as they are not
+ * stored, this is also how the map is reseeded
+ */
+static enum HashMapResult _rehash(IntHashMap *map, int table_size) {
+    IntSlot *old_slots = map->slots;
+    int old_table_size = map->table_size;
+
+    if (!_alloc_table(map, table_size)) {
+        return FailedToRehashNoMemory;
+    }
+
+    for (int i = 0; i < old_table_size; ++i) {
+        if (old_slots[i].key != INT_EMPTY_KEY) {
+            bool found;
+            int probes;
+            int index = _find_slot(map, old_slots[i].key, &found, &probes);
+
+            _set_key(map, index, old_slots[i].key);
+            map->slots[index].value = old_slots[i].value;
+        }
+    }
+
+    free(old_slots);
+
+    return Success;
+}
+
+/* pick a new seed after an insert probed too far */
+static void _reseed(IntHashMap *map) {
+    map->flooded = false;
+
+    if (map->current_size < map->reseed_size) {
+        return;
+    }
+
+    uint64_t old_seed = map->seed;
+
+    map->seed = new_seed();
+
+    if (_rehash(map, map->table_size) != Success) {
+        map->seed = old_seed;
+        return;
+    }
+
+    map->reseed_size = map->current_size * 2;
+}
+
+/** get the value slot for a key, adding the key if it is not there
+ *
+ * this is the fast way to keep counters, the value can be read and written
+ * through the pointer with one lookup
+ *
+ * @param found
+ *  set to true if the key was already in the map, a new key has a NULL value
+ *
+ * @return
+ *  a pointer to the value or NULL if the table could not grow, this is only
+ *  valid until the map is changed
+ */
+void **entry_int_hashmap(IntHashMap *map, uint64_t key, bool *found) {
+    if (key == INT_EMPTY_KEY) {
+        *found = map->has_empty_key;
+
+        if (!map->has_empty_key) {
+            map->has_empty_key = true;
+            map->empty_key_value = NULL;
+            ++map->current_size;
+        }
+
+        return &map->empty_key_value;
+    }
+
+    if (map->flooded) {
+        _reseed(map);
+    }
+
+    if (map->current_size + 1 >= map->threshold &&
+        (map->table_size > MAX_TABLE_SIZE / GROWTH_FACTOR ||
+         _rehash(map, map->table_size * GROWTH_FACTOR) != Success)) {
+
+        *found = false;
+        return NULL;
+    }
+
+    int probes;
+    int index = _find_slot(map, key, found, &probes);
+
+    if (!*found) {
+        CHECK_FLOODING(map, probes);
+
+        _set_key(map, index, key);
+        map->slots[index].value = NULL;
+
+        ++map->current_size;
+    }
+
+    return &map->slots[index].value;
+}
+
+/** insert a key and value
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the map
+ */
+enum HashMapResult insert_int_hashmap(IntHashMap *map, uint64_t key,
+                                      void *value) {
+    bool found;
+    void **slot = entry_int_hashmap(map, key, &found);
+
+    if (slot == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    *slot = value;
+
+    return Success;
+}
+
+bool contains_key_int_hashmap(IntHashMap *map, uint64_t key) {
+    if (key == INT_EMPTY_KEY) {
+        return map->has_empty_key;
+    }
+
+    bool found;
+    int probes;
+
+    _find_slot(map, key, &found, &probes);
+
+    return found;
+}
+
+void *get_value_int_hashmap(IntHashMap *map, uint64_t key) {
+    if (key == INT_EMPTY_KEY) {
+        return map->has_empty_key ? map->empty_key_value : NULL;
+    }
+
+    bool found;
+    int probes;
+    int index = _find_slot(map, key, &found, &probes);
+
+    return found ? map->slots[index].value : NULL;
+}
+
+/** remove a key and return its value
+ *
+ * the value is not passed to the drop_func, the keys after it are shifted
+ * back over the gap unless that would move them before their home slot
+ */
+void *remove_entry_int_hashmap(IntHashMap *map, uint64_t key) {
+    if (key == INT_EMPTY_KEY) {
+        if (!map->has_empty_key) {
+            return NULL;
+        }
+
+        map->has_empty_key = false;
+        --map->current_size;
+
+        return map->empty_key_value;
+    }
+
+    bool found;
+    int probes;
+    int index = _find_slot(map, key, &found, &probes);
+
+    if (!found) {
+        return NULL;
+    }
+
+    void *value = map->slots[index].value;
+    int mask = map->table_size - 1;
+    int next = (index + 1) & mask;
+
+    while (map->slots[next].key != INT_EMPTY_KEY) {
+        int home = _int_hash(map, map->slots[next].key) & mask;
+
+        if (((next - home) & mask) >= ((next - index) & mask)) {
+            _set_key(map, index, map->slots[next].key);
+            map->slots[index].value = map->slots[next].value;
+
+            index = next;
+        }
+
+        next = (next + 1) & mask;
+    }
+
+    _set_key(map, index, INT_EMPTY_KEY);
+
+    --map->current_size;
+
+    return value;
+}
+
+/** move index to the next key and copy out the key and value
+ *
+ * an index of -2 is the start, -1 is INT_EMPTY_KEY if the map has it
+ */
+bool iter_next_int_hashmap(IntHashMap *map, int *index, uint64_t *key,
+                           void **value) {
+    if (*index == -2) {
+        *index = -1;
+
+        if (map->has_empty_key) {
+            *key = INT_EMPTY_KEY;
+            *value = map->empty_key_value;
+
+            return true;
+        }
+    }
+
+    do {
+        ++*index;
+    } while (*index < map->table_size &&
+             map->slots[*index].key == INT_EMPTY_KEY);
+
+    if (*index >= map->table_size) {
+        return false;
+    }
+
+    *key = map->slots[*index].key;
+    *value = map->slots[*index].value;
+
+    return true;
+}
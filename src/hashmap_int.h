@@ -0,0 +1,81 @@
+#ifndef MY_HASHMAP_INT
+#define MY_HASHMAP_INT
+
+#include "hashmap_base.h"
+
+/* the key that marks an empty slot, a map can still hold it as a key, see
+ * IntHashMap
+ */
+#define INT_EMPTY_KEY UINT64_MAX
+
+/* the function signature to drop a value of an IntHashMap
+ *
+ * if the function is null then the value is not dropped
+ */
+typedef void (*IntDropFunc)(uint64_t key, void *value);
+
+/* a slot of an IntHashMap */
+typedef struct {
+    uint64_t key;
+    void *value;
+} IntSlot;
+
+/* a hashmap with uint64_t keys
+ *
+ * the keys are stored in the table by value, mixed with the seed of the map
+ * by mix_seed and compared with ==, so there are no function pointers on the
+ * lookup path
+ *
+ * a slot is a key and its value so a hit is one cache line, a probe checks 4
+ * keys at a time and the table has 3 extra slots at the end that mirror the
+ * keys of the first 3 so a group of 4 never has to wrap around
+ *
+ * INT_EMPTY_KEY marks an empty slot, if it is used as a key its value is kept
+ * on the side in empty_key_value
+ */
+typedef struct {
+    int table_size;
+    int current_size;
+    int threshold;
+    IntSlot *slots;
+    uint64_t seed;
+    bool flooded;
+    int reseed_size;
+    bool has_empty_key;
+    void *empty_key_value;
+    IntDropFunc drop_func;
+} IntHashMap;
+
+IntHashMap *init_int_hashmap(IntDropFunc drop_func);
+
+void drop_int_hashmap(IntHashMap *map);
+
+void **entry_int_hashmap(IntHashMap *map, uint64_t key, bool *found);
+
+enum HashMapResult insert_int_hashmap(IntHashMap *map, uint64_t key,
+                                      void *value);
+
+bool contains_key_int_hashmap(IntHashMap *map, uint64_t key);
+
+void *get_value_int_hashmap(IntHashMap *map, uint64_t key);
+
+void *remove_entry_int_hashmap(IntHashMap *map, uint64_t key);
+
+bool iter_next_int_hashmap(IntHashMap *map, int *index, uint64_t *key,
+                           void **value);
+
+/** iterate over an IntHashMap
+ *
+ * it is not safe to insert or remove while iterating
+ *
+ * @param key
+ *  a uint64_t variable to copy each key to
+ *
+ * @param value
+ *  a pointer variable to copy each value to
+ */
+#define for_each_int(map, key, value)                                          \
+    for (int _int_index = -2;                                                  \
+         iter_next_int_hashmap(map, &_int_index, &key, (void **)&value);)
+
+#endif
@@ -0,0 +1,269 @@
+#ifndef MY_HASHMAP_INTERNAL
+#define MY_HASHMAP_INTERNAL
+
+#include "hashmap_base.h"
+
+/* functions shared between the backends, these are not part of the public
+ * interface and should only be included from the .c files in src
+ */
+
+/** count a lookup for get_stats_hashmap_base
+ *
+ * this is compiled out unless HASHMAP_STATS is defined so the lookups do not
+ * pay for it, probes is still used so the counting variables dont warn
+ *
+ * the adds are atomic as the shards of a ConcurrentHashMap are looked up under
+ * the read lock by many threads at once
+ */
+#ifdef HASHMAP_STATS
+#define COUNT_LOOKUP(map, found, probes)                                       \
+    do {                                                                       \
+        __atomic_fetch_add(&(map)->lookups[(found) ? 1 : 0], 1,                \
+                           __ATOMIC_RELAXED);                                  \
+        __atomic_fetch_add(&(map)->lookup_probes[(found) ? 1 : 0], (probes),   \
+                           __ATOMIC_RELAXED);                                  \
+    } while (0)
+#else
+#define COUNT_LOOKUP(map, found, probes) ((void)(probes))
+#endif
+
+/* rehash to a new table size and record the pause, see hashmap.c */
+enum HashMapResult resize_hashmap(HashMapBase *map, int new_table_size);
+
+/* mix the seed of the map in to a hash from the hash_func */
+static inline uint64_t seed_hash(HashMapBase *map, uint64_t hash) {
+    return mix_seed(map->seed, hash);
+}
+
+/* hash a key with the hash_func and the seed of the map */
+static inline uint64_t hash_key(HashMapBase *map, const void *key) {
+    return seed_hash(map, map->hash_func(key));
+}
+
+/* mark the map to reseed when an insert probed too far */
+#define CHECK_FLOODING(map, probes)                                            \
+    do {                                                                       \
+        if ((probes) > FLOOD_PROBE_LENGTH) {                                   \
+            (map)->flooded = true;                                             \
+        }                                                                      \
+    } while (0)
+
+/* add a length to the histogram and keep track of the longest */
+static inline void stats_add_length(HashMapStats *stats, int length) {
+    int index = length < STATS_HISTOGRAM_SIZE ? length
+                                              : STATS_HISTOGRAM_SIZE - 1;
+
+    ++stats->length_histogram[index];
+
+    if (length > stats->longest) {
+        stats->longest = length;
+    }
+}
+
+/* the index after the last bucket an iter looks at
+ *
+ * during an incremental rehash the buckets of the old table come after the
+ * new one
+ */
+static inline int iter_end(IterHashMap *iter) {
+    HashMapBase *map = iter->base;
+    int end = map->table_size + (map->old_table ? map->old_table_size : 0);
+
+    // the compact backend iterates its dense array
+    if (map->backend == HashMapCompact) {
+        end = map->entries_used;
+    }
+
+    if (iter->end_index >= 0 && iter->end_index < end) {
+        return iter->end_index;
+    }
+
+    return end;
+}
+
+/* count a lookup in a cache and set the CLOCK bit of a hit */
+static inline void count_cache_lookup(HashMapBase *map, Slot *slot) {
+    if (slot) {
+        ++map->cache_hits;
+        map->referenced[slot - map->slots] = 1;
+    } else {
+        ++map->cache_misses;
+    }
+}
+
+/* the most threads the parallel functions will use */
+#define MAX_THREADS 64
+
+/* run func on count threads, see hashmap_parallel.c */
+void run_threads(void *args, size_t arg_size, int count,
+                 void *(*func)(void *));
+
+/* entry pool for the chained backend, see hashmap_pool.c */
+void init_pool(EntryPool *pool);
+
+Entry *pool_alloc_entry(EntryPool *pool);
+
+Entry *pool_alloc_entries(EntryPool *pool, int count);
+
+void pool_free_entry(EntryPool *pool, Entry *entry);
+
+void drop_pool(EntryPool *pool);
+
+size_t pool_bytes(EntryPool *pool);
+
+/* the operations for a key that has already been hashed, see hashmap.c */
+enum HashMapResult insert_hashmap_hashed(HashMapBase *map, uint64_t hash,
+                                         void *key, void *value);
+
+void **entry_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key,
+                            bool *found, enum HashMapResult *result);
+
+bool contains_key_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key);
+
+void *get_value_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key);
+
+void *remove_entry_hashmap_hashed(HashMapBase *map, uint64_t hash, void *key);
+
+/* chained backend, see hashmap.c */
+Entry **find_link_chained(HashMapBase *map, uint64_t hash, void *key);
+
+/* open addressing backend, see hashmap_open.c */
+Slot *alloc_slots_open(int size);
+
+void drop_table_open(HashMapBase *map);
+
+enum HashMapResult rehash_open(HashMapBase *map, int new_table_size);
+
+Slot *entry_open(HashMapBase *map, uint64_t hash, void *key, bool *found);
+
+enum HashMapResult insert_open(HashMapBase *map, uint64_t hash, void *key,
+                               void *value);
+
+enum HashMapResult insert_range_open(HashMapBase *map, uint64_t hash,
+                                     void *key, void *value, int end);
+
+Slot *find_slot_open(HashMapBase *map, uint64_t hash, void *key);
+
+void remove_slot_open(HashMapBase *map, int index);
+
+void *remove_entry_open(HashMapBase *map, uint64_t hash, void *key);
+
+void iter_next_base_open(IterHashMap *iter);
+
+bool iter_next_open(IterHashMap *iter, void **key, void **value);
+
+bool iter_next_drop_open(IterHashMap *iter, void **key, void **value);
+
+int get_longest_chain_open(HashMapBase *map);
+
+void get_stats_open(HashMapBase *map, HashMapStats *stats);
+
+/* swiss table backend, see hashmap_swiss.c */
+int min_table_size_swiss(void);
+
+bool alloc_table_swiss(HashMapBase *map);
+
+void drop_table_swiss(HashMapBase *map);
+
+enum HashMapResult rehash_swiss(HashMapBase *map, int new_table_size);
+
+Slot *entry_swiss(HashMapBase *map, uint64_t hash, void *key, bool *found);
+
+enum HashMapResult insert_swiss(HashMapBase *map, uint64_t hash, void *key,
+                                void *value);
+
+Slot *find_slot_swiss(HashMapBase *map, uint64_t hash, void *key);
+
+void first_group_swiss(HashMapBase *map, uint64_t hash, const uint8_t **ctrl,
+                       const Slot **slots);
+
+void *remove_entry_swiss(HashMapBase *map, uint64_t hash, void *key);
+
+void iter_next_base_swiss(IterHashMap *iter);
+
+bool iter_next_swiss(IterHashMap *iter, void **key, void **value);
+
+bool iter_next_drop_swiss(IterHashMap *iter, void **key, void **value);
+
+int get_longest_chain_swiss(HashMapBase *map);
+
+void get_stats_swiss(HashMapBase *map, HashMapStats *stats);
+
+/* insertion ordered backend, see hashmap_compact.c */
+bool alloc_table_compact(HashMapBase *map);
+
+void drop_table_compact(HashMapBase *map);
+
+enum HashMapResult rehash_compact(HashMapBase *map, int new_table_size);
+
+Slot *entry_compact(HashMapBase *map, uint64_t hash, void *key, bool *found);
+
+enum HashMapResult insert_compact(HashMapBase *map, uint64_t hash, void *key,
+                                  void *value);
+
+Slot *find_slot_compact(HashMapBase *map, uint64_t hash, void *key);
+
+void *remove_entry_compact(HashMapBase *map, uint64_t hash, void *key);
+
+void prefetch_compact(HashMapBase *map, uint64_t hash);
+
+void iter_next_base_compact(IterHashMap *iter);
+
+bool iter_next_compact(IterHashMap *iter, void **key, void **value);
+
+bool iter_next_drop_compact(IterHashMap *iter, void **key, void **value);
+
+int get_longest_chain_compact(HashMapBase *map);
+
+void get_stats_compact(HashMapBase *map, HashMapStats *stats);
+
+/* bucketized cuckoo backend, see hashmap_cuckoo.c */
+int min_table_size_cuckoo(void);
+
+bool alloc_table_cuckoo(HashMapBase *map);
+
+void drop_table_cuckoo(HashMapBase *map);
+
+enum HashMapResult rehash_cuckoo(HashMapBase *map, int new_table_size);
+
+Slot *entry_cuckoo(HashMapBase *map, uint64_t hash, void *key, bool *found);
+
+enum HashMapResult insert_cuckoo(HashMapBase *map, uint64_t hash, void *key,
+                                 void *value);
+
+Slot *find_slot_cuckoo(HashMapBase *map, uint64_t hash, void *key);
+
+void *remove_entry_cuckoo(HashMapBase *map, uint64_t hash, void *key);
+
+void prefetch_cuckoo(HashMapBase *map, uint64_t hash);
+
+void iter_next_base_cuckoo(IterHashMap *iter);
+
+bool iter_next_cuckoo(IterHashMap *iter, void **key, void **value);
+
+bool iter_next_drop_cuckoo(IterHashMap *iter, void **key, void **value);
+
+int get_longest_chain_cuckoo(HashMapBase *map);
+
+void get_stats_cuckoo(HashMapBase *map, HashMapStats *stats);
+
+/* read only snapshots, see hashmap_mmap.c */
+void drop_table_mapped(HashMapBase *map);
+
+void *find_value_mapped(HashMapBase *map, uint64_t hash, void *key,
+                        bool *found);
+
+void prefetch_mapped(HashMapBase *map, uint64_t hash);
+
+void iter_next_base_mapped(IterHashMap *iter);
+
+bool iter_next_mapped(IterHashMap *iter, void **key, void **value);
+
+int get_longest_chain_mapped(HashMapBase *map);
+
+void get_stats_mapped(HashMapBase *map, HashMapStats *stats);
+
+/* the cache mode of the open backend, see hashmap_cache.c */
+Slot *entry_cache(HashMapBase *map, uint64_t hash, void *key, bool *found);
+
+#endif
@@ -0,0 +1,625 @@
+#include <sched.h>
+#include <string.h>
+
+#include "hashmap_internal.h"
+#include "hashmap_lockfree.h"
+
+/** the lock free read map
+ *
+ * the sharded map still takes a lock for every lookup and the lock is a cache
+ * line every reader of the shard writes to, here a lookup only writes to the
+ * reader count of its own stripe
+ *
+ * memory is reclaimed with epochs, the map has an epoch counter and a reader
+ * adds itself to the count for the parity of the epoch it starts in, anything
+ * a writer takes out is stamped with the epoch it was taken out in
+ *
+ * when a writer sees nobody is left in the epoch before the current one, every
+ * reader that could have started before the things retired up to then were
+ * taken out has finished, so those are freed and the epoch moves on, the
+ * counts only need two slots as that is as far apart as live readers can be
+ *
+ * a resize works like the transfer of java's ConcurrentHashMap, the writer
+ * that starts it publishes the new table as next of the old one and the
+ * buckets are moved a chunk at a time by whoever claims the chunk, a moved
+ * bucket keeps its old chain for the readers already on it but its head is
+ * tagged so new lookups go on to the new table
+ *
+ * writers are locked out until the resize is done, so the old chains do not
+ * change while they are copied, and the table size is a power of two so every
+ * new bucket gets keys from one old bucket and no two threads write the same
+ * new bucket
+ */
+
+/* a bucket that has been moved to the next table has the low bit of its head
+ * set, the rest is the old chain so it can still be freed with the table
+ */
+#define FORWARDED(entry) ((uintptr_t)(entry)&1)
+
+static inline LockFreeEntry *_untag(LockFreeEntry *entry) {
+    return (LockFreeEntry *)((uintptr_t)entry & ~(uintptr_t)1);
+}
+
+/* the stripe of the calling thread, given out in turn as threads first read */
+static inline int _reader_stripe(void) {
+    static int next_stripe = 0;
+    static _Thread_local int stripe = -1;
+
+    if (stripe == -1) {
+        stripe = __atomic_fetch_add(&next_stripe, 1, __ATOMIC_RELAXED) %
+                 LOCKFREE_STRIPES;
+    }
+
+    return stripe;
+}
+
+/** count the calling thread as a reader of the current epoch
+ *
+ * if the epoch moved on between loading it and adding to the count the writer
+ * might have already checked the count, so it is tried again
+ *
+ * @return
+ *  the count to pass to _leave_epoch
+ */
+static inline uint64_t *_enter_epoch(LockFreeHashMap *map) {
+    LockFreeStripe *stripe = &map->stripes[_reader_stripe()];
+
+    while (true) {
+        uint64_t epoch = __atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST);
+        uint64_t *active = &stripe->active[epoch & 1];
+
+        __atomic_fetch_add(active, 1, __ATOMIC_SEQ_CST);
+
+        if (__atomic_load_n(&map->epoch, __ATOMIC_SEQ_CST) == epoch) {
+            return active;
+        }
+
+        __atomic_fetch_sub(active, 1, __ATOMIC_RELEASE);
+    }
+}
+
+static inline void _leave_epoch(uint64_t *active) {
+    __atomic_fetch_sub(active, 1, __ATOMIC_RELEASE);
+}
+
+/* true if any reader is still in an epoch with the given parity */
+static bool _has_readers(LockFreeHashMap *map, int parity) {
+    for (int i = 0; i < LOCKFREE_STRIPES; ++i) {
+        uint64_t *active = &map->stripes[i].active[parity];
+
+        if (__atomic_load_n(active, __ATOMIC_SEQ_CST)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static LockFreeTable *_alloc_table(int size) {
+    LockFreeTable *table =
+        calloc(1, sizeof(LockFreeTable) + sizeof(LockFreeEntry *) * size);
+
+    if (table) {
+        table->size = size;
+    }
+
+    return table;
+}
+
+/* true if the entry is one of the copies in the block of the table */
+static inline bool _in_block(LockFreeTable *table, LockFreeEntry *entry) {
+    uintptr_t start = (uintptr_t)table->block;
+    uintptr_t end = (uintptr_t)(table->block + table->block_size);
+
+    return (uintptr_t)entry >= start && (uintptr_t)entry < end;
+}
+
+/** free a table and the entries in its chains
+ *
+ * @param drop
+ *  true to give the keys and values to the drop_func, the chains of an old
+ *  table are the same keys as the table after it so they are not dropped
+ */
+static void _free_table(LockFreeHashMap *map, LockFreeTable *table,
+                        bool drop) {
+    for (int i = 0; i < table->size; ++i) {
+        LockFreeEntry *entry = _untag(table->buckets[i]);
+
+        while (entry) {
+            LockFreeEntry *next = entry->next;
+
+            if (drop && map->drop_func) {
+                map->drop_func(entry->key, entry->value);
+            }
+
+            if (!_in_block(table, entry)) {
+                free(entry);
+            }
+
+            entry = next;
+        }
+    }
+
+    free(table->block);
+    free(table);
+}
+
+/** free a retired entry or table
+ *
+ * a removed entry gives its key to the drop_func now that no reader can be
+ * comparing it
+ */
+static void _free_retired(LockFreeHashMap *map, LockFreeRetired *retired) {
+    if (retired->kind == RetiredTable) {
+        _free_table(map, retired->ptr, false);
+        return;
+    }
+
+    LockFreeEntry *entry = retired->ptr;
+
+    if (map->drop_func) {
+        map->drop_func(entry->key, NULL);
+    }
+
+    if (retired->kind == RetiredEntry) {
+        free(entry);
+    }
+}
+
+/** free what no reader can see any more and move to the next epoch
+ *
+ * this is a no op while readers from the epoch before are still running, the
+ * caller has to hold write_lock
+ *
+ * @return
+ *  true if the epoch moved on
+ */
+static bool _reclaim(LockFreeHashMap *map) {
+    uint64_t epoch = map->epoch;
+
+    // the epoch before has the same parity as the one after
+    if (_has_readers(map, (epoch + 1) & 1)) {
+        return false;
+    }
+
+    int kept = 0;
+
+    for (int i = 0; i < map->retired_count; ++i) {
+        if (map->retired[i].epoch < epoch) {
+            _free_retired(map, &map->retired[i]);
+        } else {
+            map->retired[kept++] = map->retired[i];
+        }
+    }
+
+    map->retired_count = kept;
+
+    __atomic_store_n(&map->epoch, epoch + 1, __ATOMIC_SEQ_CST);
+
+    return true;
+}
+
+/** take something out of the map and free it once no reader can see it
+ *
+ * if the retired list can not grow this waits for the readers instead, two
+ * epochs on every reader that could have seen it is gone
+ *
+ * the entries and old tables are retired in the order they are taken out, so
+ * an entry is always freed before the table whose block it might be in
+ */
+static void _retire(LockFreeHashMap *map, void *ptr,
+                    enum LockFreeRetiredKind kind) {
+    LockFreeRetired retired = {ptr, kind, map->epoch};
+
+    if (map->retired_count == map->retired_capacity) {
+        int capacity = map->retired_capacity * 2;
+        LockFreeRetired *grown =
+            realloc(map->retired, sizeof(LockFreeRetired) * capacity);
+
+        if (grown == NULL) {
+            uint64_t target = map->epoch + 2;
+
+            while (map->epoch < target) {
+                if (!_reclaim(map)) {
+                    sched_yield();
+                }
+            }
+
+            _free_retired(map, &retired);
+            return;
+        }
+
+        map->retired = grown;
+        map->retired_capacity = capacity;
+    }
+
+    map->retired[map->retired_count++] = retired;
+
+    if (map->retired_count >= LOCKFREE_RECLAIM_BATCH || kind == RetiredTable) {
+        _reclaim(map);
+    }
+}
+
+/** init the lock free map
+ *
+ * @param hash_func
+ *  the hash function should return a 64bit int aka uint64_t
+ *
+ * @param comp_func
+ *  a function that should return true if the keys match and false if they dont
+ *
+ * @param drop_func
+ *  a function that will receive the key and value for each entry, for a
+ *  removed entry it gets the key once no reader can be looking at it
+ */
+LockFreeHashMap *init_lockfree_hashmap_base(HashFunc hash_func,
+                                            CompFunc comp_func,
+                                            DropFunc drop_func) {
+    LockFreeHashMap *map = aligned_alloc(64, sizeof(LockFreeHashMap));
+
+    if (map == NULL) {
+        return NULL;
+    }
+
+    memset(map, 0, sizeof(LockFreeHashMap));
+
+    map->table = _alloc_table(STARTING_SIZE);
+    map->retired_capacity = LOCKFREE_RECLAIM_BATCH;
+    map->retired = malloc(sizeof(LockFreeRetired) * map->retired_capacity);
+
+    if (map->table == NULL || map->retired == NULL) {
+        free(map->table);
+        free(map->retired);
+        free(map);
+
+        return NULL;
+    }
+
+    pthread_mutex_init(&map->write_lock, NULL);
+
+    map->threshold = STARTING_SIZE * MAX_LOAD_FACTOR;
+    map->seed = new_seed();
+    map->hash_func = hash_func;
+    map->comp_func = comp_func;
+    map->drop_func = drop_func;
+
+    return map;
+}
+
+/** drop the map
+ *
+ * no other thread can be using the map at this point
+ */
+void drop_lockfree_hashmap_base(LockFreeHashMap *map) {
+    for (int i = 0; i < map->retired_count; ++i) {
+        _free_retired(map, &map->retired[i]);
+    }
+
+    _free_table(map, map->table, true);
+
+    pthread_mutex_destroy(&map->write_lock);
+
+    free(map->retired);
+    free(map);
+}
+
+/** copy the buckets of a chunk in to the next table
+ *
+ * the entries of the chunk are counted first so the copies can be taken from
+ * the block of the next table with one atomic add, each bucket is tagged with
+ * a release store once its copies are in place
+ */
+static void _move_buckets(LockFreeTable *table, LockFreeTable *next,
+                          int chunk) {
+    int begin = chunk * LOCKFREE_TRANSFER_CHUNK;
+    int end = begin + LOCKFREE_TRANSFER_CHUNK < table->size
+                  ? begin + LOCKFREE_TRANSFER_CHUNK
+                  : table->size;
+    int count = 0;
+
+    for (int i = begin; i < end; ++i) {
+        for (LockFreeEntry *entry = table->buckets[i]; entry;
+             entry = entry->next) {
+
+            ++count;
+        }
+    }
+
+    LockFreeEntry *copy =
+        next->block +
+        __atomic_fetch_add(&next->block_used, count, __ATOMIC_RELAXED);
+
+    for (int i = begin; i < end; ++i) {
+        LockFreeEntry *head = table->buckets[i];
+
+        for (LockFreeEntry *entry = head; entry; entry = entry->next) {
+            LockFreeEntry **bucket =
+                &next->buckets[entry->hash & (next->size - 1)];
+
+            *copy = *entry;
+            copy->next = *bucket;
+            *bucket = copy++;
+        }
+
+        __atomic_store_n(&table->buckets[i],
+                         (LockFreeEntry *)((uintptr_t)head | 1),
+                         __ATOMIC_RELEASE);
+    }
+}
+
+/** claim the next chunk of a resize of the table and move it
+ *
+ * the caller has to be in an epoch or be the writer doing the resize
+ *
+ * @return
+ *  false if the table is not being resized or every chunk is claimed
+ */
+static bool _move_chunk(LockFreeTable *table) {
+    LockFreeTable *next = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+
+    if (next == NULL) {
+        return false;
+    }
+
+    // once every chunk is claimed the lookups until the swap only read the
+    // header instead of all adding to it
+    if (__atomic_load_n(&table->transfer_index, __ATOMIC_RELAXED) >=
+        table->chunk_count) {
+
+        return false;
+    }
+
+    int chunk = __atomic_fetch_add(&table->transfer_index, 1, __ATOMIC_RELAXED);
+
+    if (chunk >= table->chunk_count) {
+        return false;
+    }
+
+    _move_buckets(table, next, chunk);
+
+    __atomic_fetch_add(&table->transfer_done, 1, __ATOMIC_RELEASE);
+
+    return true;
+}
+
+/** move one chunk of the resize that is going on, if there is one
+ *
+ * a lookup only ever moves one chunk so a resize of a big table is spread
+ * over many lookups instead of stalling the first one to see it
+ *
+ * @return
+ *  true if a chunk was moved
+ */
+static inline bool _help_resize(LockFreeHashMap *map) {
+    return _move_chunk(__atomic_load_n(&map->table, __ATOMIC_ACQUIRE));
+}
+
+/** take write_lock
+ *
+ * while another writer holds it to resize the map this moves chunks of the
+ * resize, once there are none left to claim it waits on the lock
+ */
+static void _lock_writer(LockFreeHashMap *map) {
+    while (pthread_mutex_trylock(&map->write_lock) != 0) {
+        uint64_t *active = _enter_epoch(map);
+        bool helped = _help_resize(map);
+
+        _leave_epoch(active);
+
+        if (!helped) {
+            pthread_mutex_lock(&map->write_lock);
+            return;
+        }
+    }
+}
+
+/** resize in to a table twice the size and swap it in
+ *
+ * the copies for the whole table are allocated up front so the threads that
+ * help can not run out of memory half way, this writer moves chunks along
+ * with them and waits for the chunks others claimed before the swap
+ *
+ * the old chains are left as they are for the readers still walking them, the
+ * whole old table is retired once the new one is published
+ */
+static enum HashMapResult _grow(LockFreeHashMap *map) {
+    LockFreeTable *old_table = map->table;
+
+    if (old_table->size > MAX_TABLE_SIZE / GROWTH_FACTOR) {
+        return FailedToRehashNoMemory;
+    }
+
+    LockFreeTable *table = _alloc_table(old_table->size * GROWTH_FACTOR);
+
+    if (table == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    table->block = malloc(sizeof(LockFreeEntry) * (map->current_size + 1));
+    table->block_size = map->current_size;
+
+    if (table->block == NULL) {
+        free(table);
+        return FailedToRehashNoMemory;
+    }
+
+    old_table->chunk_count =
+        (old_table->size + LOCKFREE_TRANSFER_CHUNK - 1) /
+        LOCKFREE_TRANSFER_CHUNK;
+    old_table->transfer_index = 0;
+    old_table->transfer_done = 0;
+
+    __atomic_store_n(&old_table->next, table, __ATOMIC_RELEASE);
+
+    while (_move_chunk(old_table)) {
+    }
+
+    while (__atomic_load_n(&old_table->transfer_done, __ATOMIC_ACQUIRE) <
+           old_table->chunk_count) {
+
+        sched_yield();
+    }
+
+    __atomic_store_n(&map->table, table, __ATOMIC_RELEASE);
+
+    map->threshold = table->size * MAX_LOAD_FACTOR;
+
+    _retire(map, old_table, RetiredTable);
+
+    return Success;
+}
+
+/** insert a key and value
+ *
+ * the new entry is filled in before the release store that puts it at the
+ * head of its chain
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the map
+ */
+enum HashMapResult insert_lockfree_hashmap_base(LockFreeHashMap *map,
+                                                void *key, void *value) {
+    uint64_t hash = mix_seed(map->seed, map->hash_func(key));
+    enum HashMapResult result = Success;
+
+    _lock_writer(map);
+
+    if (map->current_size + 1 >= map->threshold) {
+        result = _grow(map);
+    }
+
+    LockFreeEntry **bucket =
+        &map->table->buckets[hash & (map->table->size - 1)];
+
+    for (LockFreeEntry *entry = *bucket; entry && result == Success;
+         entry = entry->next) {
+
+        if (entry->hash == hash && map->comp_func(entry->key, key)) {
+            result = FailedToInsertDuplicate;
+        }
+    }
+
+    LockFreeEntry *entry = NULL;
+
+    if (result == Success) {
+        entry = malloc(sizeof(LockFreeEntry));
+        result = entry ? Success : FailedToInsertNoMemory;
+    }
+
+    if (result == Success) {
+        entry->hash = hash;
+        entry->key = key;
+        entry->value = value;
+        entry->next = *bucket;
+
+        __atomic_store_n(bucket, entry, __ATOMIC_RELEASE);
+        __atomic_store_n(&map->current_size, map->current_size + 1,
+                         __ATOMIC_RELAXED);
+    }
+
+    pthread_mutex_unlock(&map->write_lock);
+
+    return result;
+}
+
+/** find the entry for a key without taking a lock
+ *
+ * the caller has to be in an epoch for as long as it uses the entry
+ */
+static inline LockFreeEntry *_find_entry(LockFreeHashMap *map, uint64_t hash,
+                                         void *key) {
+    LockFreeTable *table = __atomic_load_n(&map->table, __ATOMIC_ACQUIRE);
+    LockFreeEntry *entry = __atomic_load_n(
+        &table->buckets[hash & (table->size - 1)], __ATOMIC_ACQUIRE);
+
+    // a moved bucket sends the lookup on to the table it moved to
+    while (FORWARDED(entry)) {
+        table = __atomic_load_n(&table->next, __ATOMIC_ACQUIRE);
+        entry = __atomic_load_n(&table->buckets[hash & (table->size - 1)],
+                                __ATOMIC_ACQUIRE);
+    }
+
+    while (entry) {
+        if (entry->hash == hash && map->comp_func(entry->key, key)) {
+            return entry;
+        }
+
+        entry = __atomic_load_n(&entry->next, __ATOMIC_ACQUIRE);
+    }
+
+    return NULL;
+}
+
+bool contains_key_lockfree_hashmap_base(LockFreeHashMap *map, void *key) {
+    uint64_t hash = mix_seed(map->seed, map->hash_func(key));
+    uint64_t *active = _enter_epoch(map);
+
+    _help_resize(map);
+
+    bool found = _find_entry(map, hash, key) != NULL;
+
+    _leave_epoch(active);
+
+    return found;
+}
+
+/** get the value for a key
+ *
+ * this never waits on a writer, the value is not protected once it is
+ * returned, if other threads can remove the key the caller has to make sure the
+ * value stays alive
+ */
+void *get_value_lockfree_hashmap_base(LockFreeHashMap *map, void *key) {
+    uint64_t hash = mix_seed(map->seed, map->hash_func(key));
+    uint64_t *active = _enter_epoch(map);
+
+    _help_resize(map);
+
+    LockFreeEntry *entry = _find_entry(map, hash, key);
+    void *value = entry ? entry->value : NULL;
+
+    _leave_epoch(active);
+
+    return value;
+}
+
+/** remove a key and return its value
+ *
+ * the entry is unlinked with a release store and retired, the key goes to the
+ * drop_func when the entry is freed
+ */
+void *remove_entry_lockfree_hashmap_base(LockFreeHashMap *map, void *key) {
+    uint64_t hash = mix_seed(map->seed, map->hash_func(key));
+    void *value = NULL;
+
+    _lock_writer(map);
+
+    LockFreeEntry **link =
+        &map->table->buckets[hash & (map->table->size - 1)];
+
+    for (; *link; link = &(*link)->next) {
+        LockFreeEntry *entry = *link;
+
+        if (entry->hash == hash && map->comp_func(entry->key, key)) {
+            value = entry->value;
+
+            __atomic_store_n(link, entry->next, __ATOMIC_RELEASE);
+            __atomic_store_n(&map->current_size, map->current_size - 1,
+                             __ATOMIC_RELAXED);
+
+            _retire(map, entry,
+                    _in_block(map->table, entry) ? RetiredBlockEntry
+                                                 : RetiredEntry);
+            break;
+        }
+    }
+
+    pthread_mutex_unlock(&map->write_lock);
+
+    return value;
+}
+
+/* the amount of entrys, this can be out of date as soon as it returns */
+int get_size_lockfree_hashmap_base(LockFreeHashMap *map) {
+    return __atomic_load_n(&map->current_size, __ATOMIC_RELAXED);
+}
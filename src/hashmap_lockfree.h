@@ -0,0 +1,133 @@
+#ifndef MY_HASHMAP_LOCKFREE
+#define MY_HASHMAP_LOCKFREE
+
+#include <pthread.h>
+
+#include "hashmap_base.h"
+
+/* the amount of cache lines the reader counts are spread over, threads are
+ * given one each in turn so up to this many readers never share a line
+ */
+#define LOCKFREE_STRIPES 64
+
+/* writers try to free what they took out of the map once this much is waiting
+ */
+#define LOCKFREE_RECLAIM_BATCH 64
+
+/* the amount of buckets a thread moves at a time during a resize */
+#define LOCKFREE_TRANSFER_CHUNK 4096
+
+/* an entry of a LockFreeHashMap
+ *
+ * only next is ever changed once a reader can see the entry, a removed entry
+ * keeps its next so a reader standing on it can still walk to the end of the
+ * chain
+ */
+typedef struct LockFreeEntry {
+    uint64_t hash;
+    void *key;
+    void *value;
+    struct LockFreeEntry *next;
+} LockFreeEntry;
+
+/* the buckets and their count behind one pointer so a reader always loads a
+ * size that matches the buckets
+ *
+ * during a resize next is the table the buckets are moving to, the chunks of
+ * LOCKFREE_TRANSFER_CHUNK buckets are handed out by transfer_index and a moved
+ * bucket has its head tagged with the low bit to send lookups on to next
+ *
+ * the copies moved in to a table all come from its block, the entries added
+ * after that are allocated one at a time
+ */
+typedef struct LockFreeTable {
+    int size;
+    struct LockFreeTable *next;
+    int chunk_count;
+    int transfer_index;
+    int transfer_done;
+    LockFreeEntry *block;
+    int block_size;
+    int block_used;
+    LockFreeEntry *buckets[];
+} LockFreeTable;
+
+/* what a retired pointer is */
+enum LockFreeRetiredKind {
+    RetiredEntry,
+    RetiredBlockEntry,
+    RetiredTable,
+};
+
+/* an entry or a whole table a writer took out of the map and the epoch it
+ * happened in, an entry from the block of a table only has its key dropped as
+ * the block is freed with the table
+ */
+typedef struct {
+    void *ptr;
+    enum LockFreeRetiredKind kind;
+    uint64_t epoch;
+} LockFreeRetired;
+
+/* the amount of readers in the even and odd epochs, see hashmap_lockfree.c */
+typedef struct {
+    uint64_t active[2];
+} __attribute__((aligned(64))) LockFreeStripe;
+
+/* a thread safe chained hashmap where lookups never take a lock
+ *
+ * readers only do atomic loads of the table and the chains, writers take
+ * write_lock and publish every change with a release store, so a reader sees
+ * an entry either before it was added or fully filled in
+ *
+ * nothing a reader could be looking at is freed straight away, removed entries
+ * and the old tables of a resize go on the retired list and are freed once
+ * every reader that started before they were removed has finished
+ *
+ * a reader that is descheduled in the middle of a lookup holds back every free
+ * until it runs again, so with more threads than cores the retired list can
+ * get long
+ *
+ * a resize is split in to chunks of buckets, the writer that starts it holds
+ * write_lock until it is done and every reader and writer that touches the
+ * map in the meantime moves chunks as well, see _help_resize
+ *
+ * table and epoch are read by every lookup so they are kept away from the
+ * fields the writers change
+ */
+typedef struct {
+    LockFreeTable *table;
+    uint64_t epoch;
+    uint64_t seed;
+    HashFunc hash_func;
+    CompFunc comp_func;
+
+    pthread_mutex_t write_lock __attribute__((aligned(64)));
+    int current_size;
+    int threshold;
+    DropFunc drop_func;
+    LockFreeRetired *retired;
+    int retired_count;
+    int retired_capacity;
+
+    LockFreeStripe stripes[LOCKFREE_STRIPES];
+} LockFreeHashMap;
+
+LockFreeHashMap *init_lockfree_hashmap_base(HashFunc hash_func,
+                                            CompFunc comp_func,
+                                            DropFunc drop_func);
+
+void drop_lockfree_hashmap_base(LockFreeHashMap *map);
+
+enum HashMapResult insert_lockfree_hashmap_base(LockFreeHashMap *map,
+                                                void *key, void *value);
+
+bool contains_key_lockfree_hashmap_base(LockFreeHashMap *map, void *key);
+
+void *get_value_lockfree_hashmap_base(LockFreeHashMap *map, void *key);
+
+void *remove_entry_lockfree_hashmap_base(LockFreeHashMap *map, void *key);
+
+int get_size_lockfree_hashmap_base(LockFreeHashMap *map);
+
+#endif
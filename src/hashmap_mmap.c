@@ -0,0 +1,464 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** snapshots that are loaded with mmap
+ *
+ * save_hashmap_base writes the map to a file that can be mapped back in and
+ * used as it is, a loaded map answers lookups straight from the mapped pages
+ * so loading only costs the mmap and processes mapping the same file share the
+ * page cache
+ *
+ * the file is
+ *
+ *  a SnapshotHeader padded to 64 bytes, it has the seed of the saved map as
+ *  the hashes in the slots have it mixed in
+ *  table_size SnapshotSlots, a robin hood table like the open backend where a
+ *  hash of 0 is an empty slot
+ *  the records the slots point to, each is the key size and value size as two
+ *  uint32s, then the key bytes and then the value bytes, both padded to 8
+ *  bytes so fixed size keys and values can be used in place
+ *
+ * everything is an offset from the start of the file so it does not matter
+ * where it is mapped, the numbers are in the byte order of the machine that
+ * saved it and a file from the other byte order is refused
+ *
+ * a loaded map is read only, inserts fail and removes find nothing
+ */
+
+#define SNAPSHOT_MAGIC "HMSNAP\0\0"
+#define SNAPSHOT_VERSION 2
+#define SNAPSHOT_BYTE_ORDER 0x01020304
+
+/* the value size of a NULL value, it loads back as NULL */
+#define SNAPSHOT_NULL_VALUE UINT32_MAX
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t table_size;
+    uint64_t size;
+    uint64_t file_size;
+    uint64_t seed;
+    uint64_t reserved[2];
+} SnapshotHeader;
+
+typedef struct {
+    uint64_t hash;
+    uint64_t offset;
+} SnapshotSlot;
+
+typedef struct {
+    uint32_t key_size;
+    uint32_t value_size;
+} SnapshotRecord;
+
+static inline uint64_t _pad8(uint64_t size) {
+    return (size + 7) & ~(uint64_t)7;
+}
+
+/* the table size is at most MAX_TABLE_SIZE so an int mask fits */
+ROBIN_HOOD_SLOTS(snapshot, SnapshotSlot)
+
+/* the slots of a mapped map come right after the header */
+static inline const SnapshotSlot *_mapped_slots(HashMapBase *map) {
+    return (const SnapshotSlot *)((const uint8_t *)map->mapped +
+                                  sizeof(SnapshotHeader));
+}
+
+/* write size bytes and pad them to 8, the offset is moved past them */
+static bool _write_padded(FILE *file, const void *data, uint64_t size,
+                          uint64_t *offset) {
+    static const uint8_t zeros[8] = {0};
+    uint64_t padded = _pad8(size);
+
+    if (fwrite(data, 1, size, file) != size ||
+        fwrite(zeros, 1, padded - size, file) != padded - size) {
+        return false;
+    }
+
+    *offset += padded;
+
+    return true;
+}
+
+/** write the records and fill in the slots
+ *
+ * the records are written from where the file is, which is just past the slots
+ */
+static bool _write_records(HashMapBase *map, FILE *file, SnapshotSlot *slots,
+                           uint64_t table_size, SizeFunc key_size,
+                           SizeFunc value_size, uint64_t *offset) {
+    IterHashMap *iter = get_iter_hashmap_base(map);
+
+    if (iter == NULL) {
+        return false;
+    }
+
+    bool good = true;
+    void *key;
+    void *value;
+
+    _iter_next_base(iter);
+
+    while (good && iter_next_hashmap(iter, &key, &value)) {
+        size_t key_bytes = key_size(key);
+        size_t value_bytes = value ? value_size(value) : 0;
+
+        if (key_bytes >= UINT32_MAX || value_bytes >= UINT32_MAX) {
+            good = false;
+            break;
+        }
+
+        SnapshotRecord record = {
+            .key_size = key_bytes,
+            .value_size = value ? value_bytes : SNAPSHOT_NULL_VALUE,
+        };
+
+        SnapshotSlot slot = {
+            .hash = robin_slot_hash(hash_key(map, key)),
+            .offset = *offset,
+        };
+
+        robin_place_snapshot(slots, NULL, table_size - 1, slot, 0,
+                             slot.hash & (table_size - 1), 0);
+
+        good = _write_padded(file, &record, sizeof(record), offset) &&
+               _write_padded(file, key, key_bytes, offset) &&
+               _write_padded(file, value, value_bytes, offset);
+    }
+
+    drop_iter_hashmap(iter);
+
+    return good;
+}
+
+/** save a hashmap to a snapshot file for load_hashmap_mmap_base
+ *
+ * the file is written next to path and renamed over it once it is complete,
+ * so a process that has the old file mapped keeps seeing the old file
+ *
+ * @param map
+ *  the hashmap base, this can use any backend
+ *
+ * @param path
+ *  the file to write
+ *
+ * @param key_size
+ *  the amount of bytes to save for a key, for string keys this should include
+ *  the terminating zero so the comp_func works on the loaded keys
+ *
+ * @param value_size
+ *  the amount of bytes to save for a value, this is not called for NULL values
+ *
+ * @return
+ *  FailedToSaveFile if the file could not be written
+ */
+enum HashMapResult save_hashmap_base(HashMapBase *map, const char *path,
+                                     SizeFunc key_size, SizeFunc value_size) {
+    uint64_t table_size = MIN_TABLE_SIZE;
+
+    while (table_size * MAX_LOAD_FACTOR <= map->current_size) {
+        table_size *= 2;
+    }
+
+    SnapshotSlot *slots = calloc(table_size, sizeof(SnapshotSlot));
+    char *temp_path = malloc(strlen(path) + sizeof(".tmp"));
+
+    if (slots == NULL || temp_path == NULL) {
+        free(slots);
+        free(temp_path);
+
+        return FailedToInsertNoMemory;
+    }
+
+    strcpy(temp_path, path);
+    strcat(temp_path, ".tmp");
+
+    FILE *file = fopen(temp_path, "wb");
+    uint64_t offset =
+        sizeof(SnapshotHeader) + sizeof(SnapshotSlot) * table_size;
+
+    // the records go first so the slots know where they are
+    bool good = file != NULL && fseek(file, offset, SEEK_SET) == 0 &&
+                _write_records(map, file, slots, table_size, key_size,
+                               value_size, &offset);
+
+    SnapshotHeader header = {
+        .magic = SNAPSHOT_MAGIC,
+        .version = SNAPSHOT_VERSION,
+        .byte_order = SNAPSHOT_BYTE_ORDER,
+        .table_size = table_size,
+        .size = map->current_size,
+        .file_size = offset,
+        .seed = map->seed,
+    };
+
+    good = good && fseek(file, 0, SEEK_SET) == 0 &&
+           fwrite(&header, sizeof(header), 1, file) == 1 &&
+           fwrite(slots, sizeof(SnapshotSlot), table_size, file) == table_size;
+
+    if (file && fclose(file) != 0) {
+        good = false;
+    }
+
+    good = good && rename(temp_path, path) == 0;
+
+    if (!good && file) {
+        remove(temp_path);
+    }
+
+    free(slots);
+    free(temp_path);
+
+    return good ? Success : FailedToSaveFile;
+}
+
+/* check the header is one we can use and that it fits in the file */
+static bool _valid_header(const SnapshotHeader *header, size_t file_size) {
+    if (file_size < sizeof(SnapshotHeader) ||
+        memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0 ||
+        header->version != SNAPSHOT_VERSION ||
+        header->byte_order != SNAPSHOT_BYTE_ORDER ||
+        header->file_size != file_size) {
+        return false;
+    }
+
+    uint64_t table_size = header->table_size;
+
+    return table_size >= MIN_TABLE_SIZE && table_size <= MAX_TABLE_SIZE &&
+           (table_size & (table_size - 1)) == 0 &&
+           header->size < table_size &&
+           sizeof(SnapshotHeader) + sizeof(SnapshotSlot) * table_size <=
+               file_size;
+}
+
+/** map a snapshot written by save_hashmap_base
+ *
+ * only the header is read, the table and records are paged in by the lookups
+ * that need them
+ *
+ * the snapshot is trusted past the header, a file that was changed after it
+ * was saved can make lookups read the wrong memory
+ *
+ * @param path
+ *  the snapshot file
+ *
+ * @param hash_func
+ *  the same hash function the map had when it was saved
+ *
+ * @param comp_func
+ *  a function to compare keys, it gets the saved key bytes as the first key
+ *
+ * @return
+ *  a read only map or NULL if the file could not be mapped or is not a
+ *  snapshot
+ */
+HashMapBase *load_hashmap_mmap_base(const char *path, HashFunc hash_func,
+                                    CompFunc comp_func) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat info;
+
+    if (fstat(fd, &info) != 0 || info.st_size == 0) {
+        close(fd);
+        return NULL;
+    }
+
+    // the mapping stays valid after the file is closed
+    void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    close(fd);
+
+    if (mapped == MAP_FAILED) {
+        return NULL;
+    }
+
+    const SnapshotHeader *header = mapped;
+    HashMapBase *map = NULL;
+
+    // the fields are set up by a normal init and its small table is swapped
+    // for the mapping
+    if (_valid_header(header, info.st_size)) {
+        map = init_hashmap_base(hash_func, comp_func, NULL, MIN_TABLE_SIZE,
+                                HashMapChained);
+    }
+
+    if (map == NULL) {
+        munmap(mapped, info.st_size);
+        return NULL;
+    }
+
+    free(map->table);
+
+    map->table = NULL;
+    map->backend = HashMapMapped;
+    map->mapped = mapped;
+    map->mapped_size = info.st_size;
+    map->table_size = header->table_size;
+    map->current_size = header->size;
+    map->seed = header->seed;
+
+    return map;
+}
+
+/* unmap the snapshot */
+void drop_table_mapped(HashMapBase *map) {
+    munmap((void *)map->mapped, map->mapped_size);
+
+    map->mapped = NULL;
+}
+
+/* the key and value of the record a slot points to */
+static inline void _read_record(HashMapBase *map, const SnapshotSlot *slot,
+                                void **key, void **value) {
+    const uint8_t *record = (const uint8_t *)map->mapped + slot->offset;
+    const SnapshotRecord *sizes = (const SnapshotRecord *)record;
+
+    *key = (void *)(record + sizeof(SnapshotRecord));
+    *value = sizes->value_size == SNAPSHOT_NULL_VALUE
+                 ? NULL
+                 : (uint8_t *)*key + _pad8(sizes->key_size);
+}
+
+/** look a key up in the mapped table
+ *
+ * @param found
+ *  set to true if the key is in the table
+ *
+ * @return
+ *  a pointer to the saved value bytes
+ */
+void *find_value_mapped(HashMapBase *map, uint64_t hash, void *key,
+                        bool *found) {
+    const SnapshotSlot *slots = _mapped_slots(map);
+    int mask = map->table_size - 1;
+    int distance = 0;
+
+    hash = robin_slot_hash(hash);
+
+    int index = hash & mask;
+
+    while (robin_probe_snapshot(slots, mask, hash, &index, &distance)) {
+        void *saved_key;
+        void *value;
+
+        _read_record(map, &slots[index], &saved_key, &value);
+
+        if (map->comp_func(saved_key, key)) {
+            COUNT_LOOKUP(map, true, distance + 1);
+
+            *found = true;
+            return value;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    COUNT_LOOKUP(map, false, distance + 1);
+
+    *found = false;
+    return NULL;
+}
+
+/* start loading the slot a lookup for the hash looks at first */
+void prefetch_mapped(HashMapBase *map, uint64_t hash) {
+    int index = robin_slot_hash(hash) & (map->table_size - 1);
+
+    __builtin_prefetch(&_mapped_slots(map)[index]);
+}
+
+/** move the iter to the next full slot */
+void iter_next_base_mapped(IterHashMap *iter) {
+    const SnapshotSlot *slots = _mapped_slots(iter->base);
+
+    ++iter->current_index;
+
+    while (iter->current_index < iter_end(iter) &&
+           slots[iter->current_index].hash == 0) {
+
+        ++iter->current_index;
+    }
+}
+
+/* the keys and values point in to the mapping so they can not be freed */
+bool iter_next_mapped(IterHashMap *iter, void **key, void **value) {
+    if (iter->current_index >= iter_end(iter)) {
+        return false;
+    }
+
+    _read_record(iter->base, &_mapped_slots(iter->base)[iter->current_index],
+                 key, value);
+
+    iter_next_base_mapped(iter);
+
+    return true;
+}
+
+/* the longest probe sequence any key needs */
+int get_longest_chain_mapped(HashMapBase *map) {
+    const SnapshotSlot *slots = _mapped_slots(map);
+    int mask = map->table_size - 1;
+    int longest = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (slots[i].hash != 0) {
+            int length = robin_distance(slots[i].hash, i, mask) + 1;
+
+            if (length > longest) {
+                longest = length;
+            }
+        }
+    }
+
+    return longest;
+}
+
+/* the layout stats, the same as the open backend */
+void get_stats_mapped(HashMapBase *map, HashMapStats *stats) {
+    const SnapshotSlot *slots = _mapped_slots(map);
+    int mask = map->table_size - 1;
+    uint64_t hit_probes = 0;
+    uint64_t miss_probes = 0;
+    int empty = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (slots[i].hash == 0) {
+            ++empty;
+        } else {
+            int length = robin_distance(slots[i].hash, i, mask) + 1;
+
+            stats_add_length(stats, length);
+            hit_probes += length;
+        }
+
+        int index = i;
+        int distance = 0;
+
+        while (slots[index].hash != 0 &&
+               robin_distance(slots[index].hash, index, mask) >= distance) {
+            index = (index + 1) & mask;
+            ++distance;
+        }
+
+        miss_probes += distance + 1;
+    }
+
+    stats->empty_fraction = (double)empty / map->table_size;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+    stats->miss_probes = (double)miss_probes / map->table_size;
+    stats->bytes_used = map->mapped_size;
+}
@@ -0,0 +1,408 @@
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** the open addressing backend
+ *
+ * this uses robin hood probing, on insert an entry that is further from its
+ * home bucket will take the slot of an entry that is closer to its own, this
+ * keeps the probe lengths short and lets lookups stop early
+ *
+ * removal uses backward shift deletion so there are no tombstones, the walk,
+ * the placing and the shift are shared with the other robin hood tables, see
+ * hashmap_robin.h
+ */
+
+ROBIN_HOOD_SLOTS(open, Slot)
+
+/* how far the slot at index is from the bucket its hash points to */
+static inline int _probe_distance(HashMapBase *map, uint64_t hash, int index) {
+    return robin_distance(hash, index, map->table_size - 1);
+}
+
+/** allocate a table of empty slots
+ *
+ * @param size
+ *  the amount of slots, this needs to be a power of two
+ */
+Slot *alloc_slots_open(int size) {
+    return calloc(size, sizeof(Slot));
+}
+
+/** drop all the slots and the table
+ *
+ * @param map
+ *  the hashmap base
+ */
+void drop_table_open(HashMapBase *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->table_size; ++i) {
+            if (map->slots[i].hash != 0) {
+                map->drop_func(map->slots[i].key, map->slots[i].value);
+            }
+        }
+    }
+
+    free(map->slots);
+}
+
+/** rehash in to a new table of the given size
+ *
+ * the stored hash is reused so the users hash function is not called, the old
+ * table is only freed once the new one is full so nothing is lost if the
+ * allocation fails
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param new_table_size
+ *  the new table size, this needs to be a power of two
+ */
+enum HashMapResult rehash_open(HashMapBase *map, int new_table_size) {
+    Slot *new_slots = alloc_slots_open(new_table_size);
+    uint8_t *new_referenced = NULL;
+
+    if (new_slots == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (map->referenced) {
+        new_referenced = calloc(new_table_size, sizeof(uint8_t));
+
+        if (new_referenced == NULL) {
+            free(new_slots);
+            return FailedToRehashNoMemory;
+        }
+    }
+
+    Slot *old_slots = map->slots;
+    uint8_t *old_referenced = map->referenced;
+    int old_table_size = map->table_size;
+
+    map->slots = new_slots;
+    map->referenced = new_referenced;
+    map->table_size = new_table_size;
+
+    robin_move_all_open(new_slots, new_referenced, new_table_size - 1,
+                        old_slots, old_referenced, old_table_size);
+
+    free(old_slots);
+    free(old_referenced);
+
+    return Success;
+}
+
+/** find the slot for a key, adding the key if it is not there
+ *
+ * the table is walked once, if the key exists it will be found before the
+ * point where a new entry would start displacing others, a new entry always
+ * ends up at that point so its slot is known once it is placed
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the key to find or add
+ *
+ * @param found
+ *  set to true if the key was already in the table, if not the new slot has a
+ *  NULL value
+ */
+Slot *entry_open(HashMapBase *map, uint64_t hash, void *key, bool *found) {
+    hash = robin_slot_hash(hash);
+
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_open(map->slots, mask, hash, &index, &distance)) {
+        Slot *slot = &map->slots[index];
+
+        if (map->comp_func(slot->key, key)) {
+            COUNT_LOOKUP(map, true, distance + 1);
+
+            *found = true;
+            return slot;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    COUNT_LOOKUP(map, false, distance + 1);
+    CHECK_FLOODING(map, distance + 1);
+
+    Slot new_slot = {.hash = hash, .key = key, .value = NULL};
+
+    robin_place_open(map->slots, map->referenced, mask, new_slot, 0, index,
+                     distance);
+
+    *found = false;
+    return &map->slots[index];
+}
+
+/** insert a key and value
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the table
+ */
+enum HashMapResult insert_open(HashMapBase *map, uint64_t hash, void *key,
+                               void *value) {
+    bool found;
+    Slot *slot = entry_open(map, hash, key, &found);
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    slot->value = value;
+
+    return Success;
+}
+
+/** insert without going past the end of a range of the table
+ *
+ * this is for the parallel build where every thread owns a range of the table,
+ * the home slot of the hash has to be in the range, if the key or one of the
+ * entrys it pushes along would have to go past end nothing is changed
+ *
+ * @param end
+ *  the first slot after the range
+ *
+ * @return
+ *  FailedToInsert if the key has to be inserted after the threads are done
+ */
+enum HashMapResult insert_range_open(HashMapBase *map, uint64_t hash,
+                                     void *key, void *value, int end) {
+    hash = robin_slot_hash(hash);
+
+    int index = hash & (map->table_size - 1);
+    int distance = 0;
+
+    while (index < end && map->slots[index].hash != 0) {
+        Slot *slot = &map->slots[index];
+
+        if (slot->hash == hash && map->comp_func(slot->key, key)) {
+            return FailedToInsertDuplicate;
+        }
+
+        if (_probe_distance(map, slot->hash, index) < distance) {
+            break;
+        }
+
+        ++index;
+        ++distance;
+    }
+
+    // the entrys from here are pushed up to the next empty slot
+    int empty = index;
+
+    while (empty < end && map->slots[empty].hash != 0) {
+        ++empty;
+    }
+
+    if (empty == end) {
+        return FailedToInsert;
+    }
+
+    Slot new_slot = {.hash = hash, .key = key, .value = value};
+
+    robin_place_open(map->slots, map->referenced, map->table_size - 1,
+                     new_slot, 0, index, distance);
+
+    return Success;
+}
+
+/** find the slot holding the given key
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the key to find
+ *
+ * @return
+ *  the slot or NULL if the key is not in the table
+ */
+Slot *find_slot_open(HashMapBase *map, uint64_t hash, void *key) {
+    hash = robin_slot_hash(hash);
+
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_open(map->slots, mask, hash, &index, &distance)) {
+        Slot *slot = &map->slots[index];
+
+        if (map->comp_func(slot->key, key)) {
+            COUNT_LOOKUP(map, true, distance + 1);
+            return slot;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    COUNT_LOOKUP(map, false, distance + 1);
+
+    return NULL;
+}
+
+/** empty a slot
+ *
+ * the following entries are shifted back a slot until one is found that is
+ * empty or already in its home bucket
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param index
+ *  the full slot to empty, nothing is dropped
+ */
+void remove_slot_open(HashMapBase *map, int index) {
+    robin_shift_open(map->slots, map->referenced, map->table_size - 1, index);
+
+    --map->current_size;
+}
+
+/** remove a key and return its value
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param hash
+ *  the result of the hash_func for the key
+ *
+ * @param key
+ *  the key to remove
+ */
+void *remove_entry_open(HashMapBase *map, uint64_t hash, void *key) {
+    Slot *slot = find_slot_open(map, hash, key);
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    void *value = slot->value;
+
+    if (map->drop_func) {
+        map->drop_func(slot->key, NULL);
+    }
+
+    remove_slot_open(map, slot - map->slots);
+
+    return value;
+}
+
+/** move the iter to the next full slot */
+void iter_next_base_open(IterHashMap *iter) {
+    ++iter->current_index;
+
+    while (iter->current_index < iter_end(iter) &&
+           iter->base->slots[iter->current_index].hash == 0) {
+
+        ++iter->current_index;
+    }
+}
+
+bool iter_next_open(IterHashMap *iter, void **key, void **value) {
+    if (iter->current_index >= iter_end(iter)) {
+        return false;
+    }
+
+    Slot *slot = &iter->base->slots[iter->current_index];
+
+    *key = slot->key;
+    *value = slot->value;
+
+    iter_next_base_open(iter);
+
+    return true;
+}
+
+/** same as iter_next_open but the table is freed after the last slot
+ *
+ * the slots are not allocated one by one so there is nothing to free until the
+ * end
+ */
+bool iter_next_drop_open(IterHashMap *iter, void **key, void **value) {
+    bool got_value = iter_next_open(iter, key, value);
+
+    if (got_value && iter->current_index >= iter->base->table_size) {
+        free(iter->base->slots);
+        iter->base->slots = NULL;
+    }
+
+    return got_value;
+}
+
+/* the longest probe sequence any key needs, this is the open addressing
+ * version of the longest chain
+ */
+int get_longest_chain_open(HashMapBase *map) {
+    int longest = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->slots[i].hash != 0) {
+            int length = _probe_distance(map, map->slots[i].hash, i) + 1;
+
+            if (length > longest) {
+                longest = length;
+            }
+        }
+    }
+
+    return longest;
+}
+
+/** fill in the parts of the stats that depend on the layout
+ *
+ * a miss stops at the first empty slot or at the first slot that is closer to
+ * its home than the key would be, so the miss length is worked out by walking
+ * from every home slot until that point
+ */
+void get_stats_open(HashMapBase *map, HashMapStats *stats) {
+    int mask = map->table_size - 1;
+    uint64_t hit_probes = 0;
+    uint64_t miss_probes = 0;
+    int empty = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->slots[i].hash == 0) {
+            ++empty;
+        } else {
+            int length = _probe_distance(map, map->slots[i].hash, i) + 1;
+
+            stats_add_length(stats, length);
+            hit_probes += length;
+        }
+
+        int index = i;
+        int distance = 0;
+
+        while (map->slots[index].hash != 0 &&
+               _probe_distance(map, map->slots[index].hash, index) >=
+                   distance) {
+
+            index = (index + 1) & mask;
+            ++distance;
+        }
+
+        miss_probes += distance + 1;
+    }
+
+    stats->empty_fraction = (double)empty / map->table_size;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+    stats->miss_probes = (double)miss_probes / map->table_size;
+    stats->bytes_used = sizeof(Slot) * map->table_size;
+
+    if (map->referenced) {
+        stats->bytes_used += map->table_size;
+    }
+}
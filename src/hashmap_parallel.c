@@ -0,0 +1,142 @@
+#include <pthread.h>
+
+#include "hashmap_internal.h"
+
+/** running over a map on many threads
+ *
+ * the buckets are split in to chunks that the threads take one at a time, so
+ * a thread that gets a run of full buckets does not hold the others up, every
+ * chunk is walked with an iter over just its range of buckets
+ */
+
+/* the amount of buckets a thread takes at a time */
+#define FOR_EACH_CHUNK 4096
+
+/** run a function on every thread and wait for them
+ *
+ * if a thread can not be started its work is done on this one instead
+ *
+ * @param args
+ *  an array of count args, the first is used on this thread
+ *
+ * @param arg_size
+ *  the size of each arg
+ */
+void run_threads(void *args, size_t arg_size, int count,
+                 void *(*func)(void *)) {
+    pthread_t ids[MAX_THREADS];
+    bool started[MAX_THREADS];
+
+    for (int t = 1; t < count; ++t) {
+        started[t] = pthread_create(&ids[t], NULL, func,
+                                    (char *)args + t * arg_size) == 0;
+    }
+
+    func(args);
+
+    for (int t = 1; t < count; ++t) {
+        if (started[t]) {
+            pthread_join(ids[t], NULL);
+        } else {
+            func((char *)args + t * arg_size);
+        }
+    }
+}
+
+/* everything the threads share */
+typedef struct {
+    HashMapBase *map;
+    ForEachFunc func;
+    void *ctx;
+    int bucket_count;
+    int next_chunk;
+} ForEachData;
+
+typedef struct {
+    ForEachData *data;
+    int id;
+} ForEachThread;
+
+/* take chunks until there are none left */
+static void *_for_each_chunks(void *arg) {
+    ForEachThread *thread = arg;
+    ForEachData *data = thread->data;
+
+    while (true) {
+        int chunk = __atomic_fetch_add(&data->next_chunk, 1, __ATOMIC_RELAXED);
+        int begin = chunk * FOR_EACH_CHUNK;
+
+        if (begin >= data->bucket_count) {
+            break;
+        }
+
+        // the iter lives on the stack so the threads dont touch active_iters
+        IterHashMap iter = {
+            .base = data->map,
+            .begin_index = begin,
+            .end_index = begin + FOR_EACH_CHUNK,
+            .current_index = begin - 1,
+            .current_entry = NULL,
+        };
+
+        void *key;
+        void *value;
+
+        _iter_next_base(&iter);
+
+        while (iter_next_hashmap(&iter, &key, &value)) {
+            data->func(key, value, data->ctx, thread->id);
+        }
+    }
+
+    return NULL;
+}
+
+/** call a function on every key and value using many threads
+ *
+ * the map must not be changed until this returns, the function is called from
+ * all the threads at once so anything it adds up should be kept per
+ * thread_id and combined after
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param nthreads
+ *  the amount of threads to use, up to 64, this thread is one of them
+ *
+ * @param func
+ *  called with every key and value, the ctx and the id of the thread
+ *
+ * @param ctx
+ *  passed to every call of func
+ */
+void parallel_for_each_hashmap_base(HashMapBase *map, int nthreads,
+                                    ForEachFunc func, void *ctx) {
+    if (nthreads < 1) {
+        nthreads = 1;
+    } else if (nthreads > MAX_THREADS) {
+        nthreads = MAX_THREADS;
+    }
+
+    ForEachData data = {
+        .map = map,
+        .func = func,
+        .ctx = ctx,
+        .bucket_count = get_bucket_count_hashmap_base(map),
+        .next_chunk = 0,
+    };
+
+    ForEachThread threads[MAX_THREADS];
+
+    for (int t = 0; t < nthreads; ++t) {
+        threads[t].data = &data;
+        threads[t].id = t;
+    }
+
+    // hold any incremental rehash while the threads run
+    ++map->active_iters;
+
+    run_threads(threads, sizeof(ForEachThread), nthreads, _for_each_chunks);
+
+    --map->active_iters;
+}
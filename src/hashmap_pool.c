@@ -0,0 +1,184 @@
+#include "hashmap_internal.h"
+
+/** the entry pool
+ *
+ * the chained backend gets its Entry structs from here instead of calling
+ * malloc for each one, entrys are handed out from blocks that grow in size and
+ * removed entrys go on a free list to be reused
+ *
+ * the blocks are only freed when the whole map is dropped, if an arena was
+ * given the blocks come from the arena and are never freed by the pool
+ */
+
+/** set up an empty pool
+ *
+ * @param pool
+ *  the pool to set up
+ */
+void init_pool(EntryPool *pool) {
+    pool->blocks = NULL;
+    pool->free_list = NULL;
+    pool->block_used = 0;
+    pool->arena_alloc = NULL;
+    pool->arena = NULL;
+}
+
+/** add a new block to the pool
+ *
+ * each block is twice the size of the last one up to POOL_MAX_BLOCK
+ */
+static bool _grow_pool(EntryPool *pool) {
+    int size = POOL_START_BLOCK;
+
+    if (pool->blocks) {
+        size = pool->blocks->size * 2;
+
+        if (size > POOL_MAX_BLOCK) {
+            size = POOL_MAX_BLOCK;
+        }
+    }
+
+    size_t bytes = sizeof(EntryBlock) + sizeof(Entry) * size;
+
+    EntryBlock *block = pool->arena_alloc
+                            ? pool->arena_alloc(pool->arena, bytes)
+                            : malloc(bytes);
+
+    if (block == NULL) {
+        return false;
+    }
+
+    block->size = size;
+    block->next = pool->blocks;
+
+    pool->blocks = block;
+    pool->block_used = 0;
+
+    return true;
+}
+
+/** get an entry from the pool
+ *
+ * @return
+ *  an uninitialized entry or NULL if there is no memory
+ */
+Entry *pool_alloc_entry(EntryPool *pool) {
+    if (pool->free_list) {
+        Entry *entry = pool->free_list;
+        pool->free_list = entry->next;
+
+        return entry;
+    }
+
+    if (pool->blocks == NULL || pool->block_used == pool->blocks->size) {
+        if (!_grow_pool(pool)) {
+            return NULL;
+        }
+    }
+
+    return &pool->blocks->entries[pool->block_used++];
+}
+
+/** get count entrys in one contiguous array
+ *
+ * the array gets a block of its own so the normal blocks keep growing like
+ * they did before, this is used to hand out entrys to threads without them
+ * touching the pool
+ *
+ * @return
+ *  an array of uninitialized entrys or NULL if there is no memory
+ */
+Entry *pool_alloc_entries(EntryPool *pool, int count) {
+    size_t bytes = sizeof(EntryBlock) + sizeof(Entry) * count;
+
+    EntryBlock *block = pool->arena_alloc
+                            ? pool->arena_alloc(pool->arena, bytes)
+                            : malloc(bytes);
+
+    if (block == NULL) {
+        return NULL;
+    }
+
+    block->size = count;
+
+    // the first block is the one entrys are handed out from, so the new block
+    // goes after it unless there is none yet
+    if (pool->blocks == NULL) {
+        block->next = NULL;
+
+        pool->blocks = block;
+        pool->block_used = count;
+    } else {
+        block->next = pool->blocks->next;
+        pool->blocks->next = block;
+    }
+
+    return block->entries;
+}
+
+/* give an entry back to the pool so it can be reused */
+void pool_free_entry(EntryPool *pool, Entry *entry) {
+    entry->next = pool->free_list;
+    pool->free_list = entry;
+}
+
+/** free all the blocks
+ *
+ * with an arena this does nothing as the arena owns the memory
+ */
+void drop_pool(EntryPool *pool) {
+    if (pool->arena_alloc == NULL) {
+        EntryBlock *block = pool->blocks;
+
+        while (block != NULL) {
+            EntryBlock *next = block->next;
+
+            free(block);
+
+            block = next;
+        }
+    }
+
+    init_pool(pool);
+}
+
+/* the memory held by the blocks, including the ones from an arena */
+size_t pool_bytes(EntryPool *pool) {
+    size_t bytes = 0;
+
+    for (EntryBlock *block = pool->blocks; block; block = block->next) {
+        bytes += sizeof(EntryBlock) + sizeof(Entry) * block->size;
+    }
+
+    return bytes;
+}
+
+/** get the pool blocks from a user arena
+ *
+ * the arena needs to be set before anything is inserted, when the map is
+ * dropped the blocks are left for the arena to free, so if the map has no
+ * drop_func dropping it does not walk the entrys at all
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param arena_alloc
+ *  the function to get memory from the arena
+ *
+ * @param arena
+ *  the arena, this is passed to arena_alloc
+ *
+ * @return
+ *  false if the map is not chained or entrys have already been allocated
+ */
+bool set_arena_hashmap_base(HashMapBase *map, ArenaAllocFunc arena_alloc,
+                            void *arena) {
+    if (map->backend != HashMapChained || map->pool.blocks != NULL) {
+        return false;
+    }
+
+    map->pool.arena_alloc = arena_alloc;
+    map->pool.arena = arena;
+
+    return true;
+}
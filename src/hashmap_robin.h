@@ -0,0 +1,205 @@
+#ifndef MY_HASHMAP_ROBIN
+#define MY_HASHMAP_ROBIN
+
+#include "hashmap_base.h"
+
+/** general info
+ *
+ * the robin hood probing shared by the open backend, the string map, the
+ * hashset and HASHMAP_INLINE, only the slots are different between them so the
+ * ROBIN_HOOD_SLOTS macro generates the walk, the placing, the backward shift
+ * and the same size rebuild for a new seed for one slot type
+ *
+ * a slot type has to have a uint64_t hash, 0 marks an empty slot so a real
+ * hash of 0 is stored as 1, see robin_slot_hash
+ *
+ * on insert an entry that is further from its home slot takes the slot of one
+ * that is closer to its own, so a lookup can stop at the first slot that is
+ * closer to home than the key would be, removal shifts the following entrys
+ * back so there are no tombstones
+ *
+ * the open backend keeps a CLOCK bit per slot for its cache mode, the
+ * functions that move slots take that array and move the bits with the slots,
+ * the others pass NULL
+ */
+
+/* the hash to store in a slot, zero marks an empty slot so it is bumped to one
+ */
+static inline uint64_t robin_slot_hash(uint64_t hash) {
+    return hash == 0 ? 1 : hash;
+}
+
+/* how far the slot at index is from the home slot of its hash */
+static inline int robin_distance(uint64_t hash, int index, int mask) {
+    return (index - (int)(hash & mask)) & mask;
+}
+
+/* a macro to define the robin hood functions for a slot type
+ *
+ * @param name
+ *  the suffix of the functions, for example robin_probe_##name
+ *
+ * @param slot_type
+ *  the slot type, see the general info
+ */
+#define ROBIN_HOOD_SLOTS(name, slot_type)                                      \
+    /** walk to the next slot that has the hash                                \
+     *                                                                         \
+     * index and distance start at the home slot and 0, if the key in the      \
+     * slot does not match the caller moves them on by one and calls again     \
+     *                                                                         \
+     * @return                                                                 \
+     *  false once the key can not be further on, index and distance are then  \
+     *  where it would be placed                                               \
+     */                                                                        \
+    static inline bool robin_probe_##name(const slot_type *slots, int mask,    \
+                                          uint64_t hash, int *index,           \
+                                          int *distance) {                     \
+        while (slots[*index].hash != 0 &&                                      \
+               robin_distance(slots[*index].hash, *index, mask) >=             \
+                   *distance) {                                                \
+                                                                               \
+            if (slots[*index].hash == hash) {                                  \
+                return true;                                                   \
+            }                                                                  \
+                                                                               \
+            *index = (*index + 1) & mask;                                      \
+            ++*distance;                                                       \
+        }                                                                      \
+                                                                               \
+        return false;                                                          \
+    }                                                                          \
+                                                                               \
+    /** place a slot that is known to not be a duplicate                       \
+     *                                                                         \
+     * @param bit                                                              \
+     *  the CLOCK bit of the slot, only used when referenced is not NULL       \
+     *                                                                         \
+     * @param index                                                            \
+     *  the index to start from, the slot ends up here                         \
+     *                                                                         \
+     * @param distance                                                         \
+     *  the probe distance the slot has at index                               \
+     */                                                                        \
+    static inline void robin_place_##name(slot_type *slots,                    \
+                                          uint8_t *referenced, int mask,       \
+                                          slot_type slot, uint8_t bit,         \
+                                          int index, int distance) {           \
+        while (slots[index].hash != 0) {                                       \
+            int current = robin_distance(slots[index].hash, index, mask);      \
+                                                                               \
+            /* the entry here is closer to home so take its slot and keep      \
+             * going with it                                                   \
+             */                                                                \
+            if (current < distance) {                                          \
+                slot_type temp = slots[index];                                 \
+                slots[index] = slot;                                           \
+                slot = temp;                                                   \
+                                                                               \
+                if (referenced) {                                              \
+                    uint8_t temp_bit = referenced[index];                      \
+                    referenced[index] = bit;                                   \
+                    bit = temp_bit;                                            \
+                }                                                              \
+                                                                               \
+                distance = current;                                            \
+            }                                                                  \
+                                                                               \
+            index = (index + 1) & mask;                                        \
+            ++distance;                                                        \
+        }                                                                      \
+                                                                               \
+        slots[index] = slot;                                                   \
+                                                                               \
+        if (referenced) {                                                      \
+            referenced[index] = bit;                                           \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* place every full slot of an old table in to an empty one, the stored    \
+     * hashes are reused                                                       \
+     */                                                                        \
+    static inline void robin_move_all_##name(                                  \
+        slot_type *slots, uint8_t *referenced, int mask,                       \
+        const slot_type *old_slots, const uint8_t *old_referenced,             \
+        int old_table_size) {                                                  \
+        for (int i = 0; i < old_table_size; ++i) {                             \
+            if (old_slots[i].hash != 0) {                                      \
+                robin_place_##name(slots, referenced, mask, old_slots[i],      \
+                                   old_referenced ? old_referenced[i] : 0,     \
+                                   old_slots[i].hash & mask, 0);               \
+            }                                                                  \
+        }                                                                      \
+    }                                                                          \
+                                                                               \
+    /* empty a full slot, the following entrys are shifted back until one is   \
+     * empty or already in its home slot                                       \
+     */                                                                        \
+    static inline void robin_shift_##name(slot_type *slots,                    \
+                                          uint8_t *referenced, int mask,       \
+                                          int index) {                         \
+        int next = (index + 1) & mask;                                         \
+                                                                               \
+        while (slots[next].hash != 0 &&                                        \
+               robin_distance(slots[next].hash, next, mask) != 0) {            \
+            slots[index] = slots[next];                                        \
+                                                                               \
+            if (referenced) {                                                  \
+                referenced[index] = referenced[next];                          \
+            }                                                                  \
+                                                                               \
+            index = next;                                                      \
+            next = (next + 1) & mask;                                          \
+        }                                                                      \
+                                                                               \
+        slots[index].hash = 0;                                                 \
+    }                                                                          \
+                                                                               \
+    /** rebuild a table at the same size under a new seed, see                 \
+     * _reseed_hashmap in hashmap.c                                            \
+     *                                                                         \
+     * the maps that use this each have their own struct so the fields of the  \
+     * map are passed in by pointer, flooded is cleared even when the map is   \
+     * too small to reseed yet and nothing changes if there is no memory       \
+     *                                                                         \
+     * @param rehash                                                           \
+     *  gives the hash of a full slot under the new seed, it gets map          \
+     */                                                                        \
+    static inline void robin_reseed_##name(                                    \
+        void *map, slot_type **slots, int table_size, int current_size,        \
+        uint64_t *seed, bool *flooded, int *reseed_size,                       \
+        uint64_t (*rehash)(void *map, const slot_type *slot)) {                \
+        *flooded = false;                                                      \
+                                                                               \
+        if (current_size < *reseed_size) {                                     \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        slot_type *new_slots = calloc(table_size, sizeof(slot_type));          \
+                                                                               \
+        if (new_slots == NULL) {                                               \
+            return;                                                            \
+        }                                                                      \
+                                                                               \
+        *seed = new_seed();                                                    \
+                                                                               \
+        int mask = table_size - 1;                                             \
+                                                                               \
+        for (int i = 0; i < table_size; ++i) {                                 \
+            if ((*slots)[i].hash != 0) {                                       \
+                slot_type slot = (*slots)[i];                                  \
+                                                                               \
+                slot.hash = rehash(map, &slot);                                \
+                                                                               \
+                robin_place_##name(new_slots, NULL, mask, slot, 0,             \
+                                   slot.hash & mask, 0);                       \
+            }                                                                  \
+        }                                                                      \
+                                                                               \
+        free(*slots);                                                          \
+                                                                               \
+        *slots = new_slots;                                                    \
+        *reseed_size = current_size * 2;                                       \
+    }
+
+#endif
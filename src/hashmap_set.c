@@ -0,0 +1,373 @@
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+#include "hashmap_set.h"
+
+/** the hashset
+ *
+ * the table is the same as the open backend, robin hood probing with backward
+ * shift deletion from hashmap_robin.h, but the slots only hold the hash and
+ * the key
+ *
+ * the set operations walk the slots of one table and probe the other, the new
+ * set takes the seed of set_1 so its keys keep their stored hashes, the keys
+ * of set_2 are hashed again unless the seeds happen to be the same, the new
+ * set is sized for its largest possible result up front so it never rehashes
+ */
+
+ROBIN_HOOD_SLOTS(set, SetSlot)
+
+/* the seeded hash of a key as it is stored in a slot */
+static inline uint64_t _hash(HashSetBase *set, void *key) {
+    return robin_slot_hash(mix_seed(set->seed, set->hash_func(key)));
+}
+
+/** the smallest table that holds capacity keys without growing
+ *
+ * the one extra key keeps the last insert under the threshold
+ *
+ * @return
+ *  the size or 0 if it would be larger than MAX_TABLE_SIZE
+ */
+static int _table_size_for(size_t capacity) {
+    size_t size = STARTING_SIZE;
+
+    while (size * MAX_LOAD_FACTOR <= capacity + 1) {
+        if (size > MAX_TABLE_SIZE / GROWTH_FACTOR) {
+            return 0;
+        }
+
+        size *= GROWTH_FACTOR;
+    }
+
+    return size;
+}
+
+/** allocate an empty table
+ *
+ * @return
+ *  false if there was no memory
+ */
+static bool _alloc_table(HashSetBase *set, int table_size) {
+    SetSlot *slots = calloc(table_size, sizeof(SetSlot));
+
+    if (slots == NULL) {
+        return false;
+    }
+
+    set->slots = slots;
+    set->table_size = table_size;
+    set->threshold = table_size * MAX_LOAD_FACTOR;
+
+    return true;
+}
+
+/** init a hashset with room for capacity keys
+ *
+ * @param drop_func
+ *  a function that will receive every key when the set is dropped or NULL
+ *
+ * @param capacity
+ *  the amount of keys the set should hold before it has to grow
+ */
+HashSetBase *init_hashset_base(HashFunc hash_func, CompFunc comp_func,
+                               SetDropFunc drop_func, size_t capacity) {
+    int table_size = _table_size_for(capacity);
+
+    if (table_size == 0) {
+        return NULL;
+    }
+
+    HashSetBase *set = malloc(sizeof(HashSetBase));
+
+    if (set == NULL) {
+        return NULL;
+    }
+
+    if (!_alloc_table(set, table_size)) {
+        free(set);
+        return NULL;
+    }
+
+    set->current_size = 0;
+    set->seed = new_seed();
+    set->flooded = false;
+    set->reseed_size = 0;
+    set->hash_func = hash_func;
+    set->comp_func = comp_func;
+    set->drop_func = drop_func;
+
+    return set;
+}
+
+/* drop every key with the drop_func and free the set */
+void drop_hashset_base(HashSetBase *set) {
+    if (set->drop_func) {
+        for (int i = 0; i < set->table_size; ++i) {
+            if (set->slots[i].hash != 0) {
+                set->drop_func(set->slots[i].key);
+            }
+        }
+    }
+
+    free(set->slots);
+    free(set);
+}
+
+/* double the table, the stored hashes are reused */
+static enum HashMapResult _rehash(HashSetBase *set) {
+    if (set->table_size > MAX_TABLE_SIZE / GROWTH_FACTOR) {
+        return FailedToRehashNoMemory;
+    }
+
+    SetSlot *old_slots = set->slots;
+    int old_table_size = set->table_size;
+
+    if (!_alloc_table(set, old_table_size * GROWTH_FACTOR)) {
+        return FailedToRehashNoMemory;
+    }
+
+    robin_move_all_set(set->slots, NULL, set->table_size - 1, old_slots, NULL,
+                       old_table_size);
+
+    free(old_slots);
+
+    return Success;
+}
+
+/* the hash of a slot under a new seed for robin_reseed_set */
+static uint64_t _reseed_hash(void *set, const SetSlot *slot) {
+    return _hash(set, slot->key);
+}
+
+/** find the slot of a key
+ *
+ * @param hash
+ *  the stored hash of the key, see robin_slot_hash
+ *
+ * @return
+ *  the index or -1 if the key is not in the set
+ */
+static int _find_slot(HashSetBase *set, uint64_t hash, void *key) {
+    int mask = set->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_set(set->slots, mask, hash, &index, &distance)) {
+        if (set->comp_func(set->slots[index].key, key)) {
+            return index;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    return -1;
+}
+
+/* insert a key with a stored hash in one walk, see entry_open */
+static enum HashMapResult _insert_hashed(HashSetBase *set, uint64_t hash,
+                                         void *key) {
+    if (set->current_size + 1 >= set->threshold && _rehash(set) != Success) {
+        return FailedToInsertNoMemory;
+    }
+
+    int mask = set->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_set(set->slots, mask, hash, &index, &distance)) {
+        if (set->comp_func(set->slots[index].key, key)) {
+            return FailedToInsertDuplicate;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    CHECK_FLOODING(set, distance + 1);
+
+    robin_place_set(set->slots, NULL, mask, (SetSlot){.hash = hash, .key = key},
+                    0, index, distance);
+
+    ++set->current_size;
+
+    return Success;
+}
+
+/** insert a key
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the set, the new key is
+ *  not stored or dropped
+ */
+enum HashMapResult insert_hashset_base(HashSetBase *set, void *key) {
+    if (set->flooded) {
+        robin_reseed_set(set, &set->slots, set->table_size, set->current_size,
+                         &set->seed, &set->flooded, &set->reseed_size,
+                         _reseed_hash);
+    }
+
+    return _insert_hashed(set, _hash(set, key), key);
+}
+
+bool contains_key_hashset_base(HashSetBase *set, void *key) {
+    return _find_slot(set, _hash(set, key), key) != -1;
+}
+
+/** remove a key
+ *
+ * @return
+ *  the key that was stored in the set or NULL if it was not there, it is not
+ *  passed to the drop_func
+ */
+void *remove_key_hashset_base(HashSetBase *set, void *key) {
+    int index = _find_slot(set, _hash(set, key), key);
+
+    if (index == -1) {
+        return NULL;
+    }
+
+    void *stored = set->slots[index].key;
+
+    robin_shift_set(set->slots, NULL, set->table_size - 1, index);
+
+    --set->current_size;
+
+    return stored;
+}
+
+/* move index to the next full slot and copy out its key, start at -1 */
+bool iter_next_hashset_base(HashSetBase *set, int *index, void **key) {
+    do {
+        ++*index;
+    } while (*index < set->table_size && set->slots[*index].hash == 0);
+
+    if (*index >= set->table_size) {
+        return false;
+    }
+
+    *key = set->slots[*index].key;
+
+    return true;
+}
+
+/** init the set for the result of a set operation
+ *
+ * the sets need the same hash_func for their keys to mean the same thing, the
+ * result takes the seed of set_1 and shares the keys with the sets so it gets
+ * no drop_func
+ *
+ * @return
+ *  the empty set or NULL if the hash_funcs differ or there was no memory
+ */
+static HashSetBase *_init_result(HashSetBase *set_1, HashSetBase *set_2,
+                                 size_t capacity) {
+    if (set_1->hash_func != set_2->hash_func) {
+        return NULL;
+    }
+
+    HashSetBase *result = init_hashset_base(set_1->hash_func,
+                                            set_1->comp_func, NULL, capacity);
+
+    if (result != NULL) {
+        result->seed = set_1->seed;
+    }
+
+    return result;
+}
+
+/* the hash of a key of set in the table of other, the stored one is only
+ * reused when the seeds are the same
+ */
+static inline uint64_t _hash_for(HashSetBase *other, HashSetBase *set,
+                                 const SetSlot *slot) {
+    return other->seed == set->seed ? slot->hash : _hash(other, slot->key);
+}
+
+/* add every key of a set to a result that is known to be large enough */
+static void _copy_all(HashSetBase *result, HashSetBase *set) {
+    for (int i = 0; i < set->table_size; ++i) {
+        if (set->slots[i].hash != 0) {
+            _insert_hashed(result, _hash_for(result, set, &set->slots[i]),
+                           set->slots[i].key);
+        }
+    }
+}
+
+/** a new set with the keys that are in either set
+ *
+ * the new set points at the same keys as the two sets and does not drop them,
+ * where a key is in both sets the one from set_1 is kept
+ *
+ * @return
+ *  the new set or NULL if the sets have different hash_funcs or there was no
+ *  memory
+ */
+HashSetBase *union_hashset_base(HashSetBase *set_1, HashSetBase *set_2) {
+    HashSetBase *result =
+        _init_result(set_1, set_2,
+                     (size_t)set_1->current_size + set_2->current_size);
+
+    if (result == NULL) {
+        return NULL;
+    }
+
+    _copy_all(result, set_1);
+    _copy_all(result, set_2);
+
+    return result;
+}
+
+/** a new set with the keys of set_1 that are or are not in set_2
+ *
+ * @param in_set_2
+ *  true for the intersection and false for the difference
+ */
+static HashSetBase *_filter(HashSetBase *set_1, HashSetBase *set_2,
+                            bool in_set_2) {
+    HashSetBase *result = _init_result(set_1, set_2, set_1->current_size);
+
+    if (result == NULL) {
+        return NULL;
+    }
+
+    for (int i = 0; i < set_1->table_size; ++i) {
+        SetSlot *slot = &set_1->slots[i];
+
+        if (slot->hash != 0 &&
+            (_find_slot(set_2, _hash_for(set_2, set_1, slot), slot->key) !=
+             -1) == in_set_2) {
+            _insert_hashed(result, slot->hash, slot->key);
+        }
+    }
+
+    return result;
+}
+
+/** a new set with the keys that are in both sets
+ *
+ * the smaller set is walked and the larger one probed, the keys come from the
+ * smaller set and are not dropped by the new set
+ *
+ * @return
+ *  the new set or NULL if the sets have different hash_funcs or there was no
+ *  memory
+ */
+HashSetBase *intersection_hashset_base(HashSetBase *set_1,
+                                       HashSetBase *set_2) {
+    if (set_2->current_size < set_1->current_size) {
+        return _filter(set_2, set_1, true);
+    }
+
+    return _filter(set_1, set_2, true);
+}
+
+/** a new set with the keys of set_1 that are not in set_2
+ *
+ * @return
+ *  the new set or NULL if the sets have different hash_funcs or there was no
+ *  memory
+ */
+HashSetBase *difference_hashset_base(HashSetBase *set_1, HashSetBase *set_2) {
+    return _filter(set_1, set_2, false);
+}
@@ -0,0 +1,63 @@
+#ifndef MY_HASHMAP_SET
+#define MY_HASHMAP_SET
+
+#include "hashmap_base.h"
+
+/* the function signature to drop a key of a HashSetBase
+ *
+ * if the function is null then the keys are not dropped
+ */
+typedef void (*SetDropFunc)(void *key);
+
+/* a slot of a HashSetBase, the Slot of the open backend without the value
+ *
+ * a hash of zero marks an empty slot
+ */
+typedef struct {
+    uint64_t hash;
+    void *key;
+} SetSlot;
+
+/* a hashset
+ *
+ * this is the open backend with the value taken out of the slots, so a set
+ * of n keys takes two thirds of the memory of a map with NULL values
+ *
+ * the hashes from the hash_func are mixed with the seed of the set and stored
+ * with the keys, so a rehash and the keys a set operation copies out of set_1
+ * do not call the hash_func again
+ */
+typedef struct {
+    int table_size;
+    int current_size;
+    int threshold;
+    SetSlot *slots;
+    uint64_t seed;
+    bool flooded;
+    int reseed_size;
+    HashFunc hash_func;
+    CompFunc comp_func;
+    SetDropFunc drop_func;
+} HashSetBase;
+
+HashSetBase *init_hashset_base(HashFunc hash_func, CompFunc comp_func,
+                               SetDropFunc drop_func, size_t capacity);
+
+void drop_hashset_base(HashSetBase *set);
+
+enum HashMapResult insert_hashset_base(HashSetBase *set, void *key);
+
+bool contains_key_hashset_base(HashSetBase *set, void *key);
+
+void *remove_key_hashset_base(HashSetBase *set, void *key);
+
+bool iter_next_hashset_base(HashSetBase *set, int *index, void **key);
+
+HashSetBase *union_hashset_base(HashSetBase *set_1, HashSetBase *set_2);
+
+HashSetBase *intersection_hashset_base(HashSetBase *set_1,
+                                       HashSetBase *set_2);
+
+HashSetBase *difference_hashset_base(HashSetBase *set_1, HashSetBase *set_2);
+
+#endif
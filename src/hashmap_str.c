@@ -0,0 +1,318 @@
+#include <string.h>
+
+#include "hashmap.h"
+#include "hashmap_internal.h"
+#include "hashmap_robin.h"
+
+/** the string key map
+ *
+ * the slots use the same robin hood probing and backward shift deletion as
+ * the open backend, see hashmap_robin.h, with the hash and length of the key
+ * next to the key
+ *
+ * a key under STR_INLINE_SIZE bytes is copied in to the slot, so a lookup for
+ * a short key reads one slot and never follows a pointer, longer keys are
+ * copied in to an arena that is freed with the map
+ */
+
+ROBIN_HOOD_SLOTS(str, StrSlot)
+
+/* the seeded hash of a key, the seed goes in to fast_hash64 itself as keys
+ * with the same unseeded hash would still collide if it was mixed in after
+ */
+static inline uint64_t _str_hash(StrHashMap *map, const char *key, size_t len) {
+    return robin_slot_hash(fast_hash64(key, len, map->seed));
+}
+
+/* the bytes of the key in a slot */
+static inline const char *_slot_key(const StrSlot *slot) {
+    return slot->len < STR_INLINE_SIZE ? slot->key.data : slot->key.ptr;
+}
+
+/* check the hash and the length before comparing any bytes */
+static inline bool _slot_matches(const StrSlot *slot, uint64_t hash,
+                                 const char *key, size_t len) {
+    return slot->hash == hash && slot->len == len &&
+           memcmp(_slot_key(slot), key, len) == 0;
+}
+
+/** copy a key in to the arena
+ *
+ * @return
+ *  the copy or NULL if there was no memory
+ */
+static char *_arena_copy(StrHashMap *map, const char *key, size_t len) {
+    StrArenaBlock *block = map->arena;
+
+    if (block == NULL || block->size - block->used < len + 1) {
+        size_t size = len + 1 > STR_ARENA_BLOCK ? len + 1 : STR_ARENA_BLOCK;
+
+        block = malloc(sizeof(StrArenaBlock) + size);
+
+        if (block == NULL) {
+            return NULL;
+        }
+
+        block->next = map->arena;
+        block->used = 0;
+        block->size = size;
+
+        map->arena = block;
+    }
+
+    char *copy = block->data + block->used;
+
+    memcpy(copy, key, len);
+    copy[len] = '\0';
+
+    block->used += len + 1;
+
+    return copy;
+}
+
+/* init a StrHashMap, drop_func gets every key and value when the map is dropped
+ * or NULL
+ */
+StrHashMap *init_str_hashmap(StrDropFunc drop_func) {
+    StrHashMap *map = malloc(sizeof(StrHashMap));
+
+    if (map == NULL) {
+        return NULL;
+    }
+
+    map->slots = calloc(STARTING_SIZE, sizeof(StrSlot));
+
+    if (map->slots == NULL) {
+        free(map);
+        return NULL;
+    }
+
+    map->table_size = STARTING_SIZE;
+    map->current_size = 0;
+    map->threshold = STARTING_SIZE * MAX_LOAD_FACTOR;
+    map->seed = new_seed();
+    map->flooded = false;
+    map->reseed_size = 0;
+    map->arena = NULL;
+    map->drop_func = drop_func;
+
+    return map;
+}
+
+void drop_str_hashmap(StrHashMap *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->table_size; ++i) {
+            if (map->slots[i].hash != 0) {
+                map->drop_func(_slot_key(&map->slots[i]), map->slots[i].value);
+            }
+        }
+    }
+
+    while (map->arena) {
+        StrArenaBlock *next = map->arena->next;
+
+        free(map->arena);
+        map->arena = next;
+    }
+
+    free(map->slots);
+    free(map);
+}
+
+/* double the table, the stored hashes are reused */
+static enum HashMapResult _rehash(StrHashMap *map) {
+    if (map->table_size > MAX_TABLE_SIZE / GROWTH_FACTOR) {
+        return FailedToRehashNoMemory;
+    }
+
+    int old_table_size = map->table_size;
+    StrSlot *old_slots = map->slots;
+
+    map->slots = calloc(old_table_size * GROWTH_FACTOR, sizeof(StrSlot));
+
+    if (map->slots == NULL) {
+        map->slots = old_slots;
+        return FailedToRehashNoMemory;
+    }
+
+    map->table_size = old_table_size * GROWTH_FACTOR;
+    map->threshold = map->table_size * MAX_LOAD_FACTOR;
+
+    robin_move_all_str(map->slots, NULL, map->table_size - 1, old_slots, NULL,
+                       old_table_size);
+
+    free(old_slots);
+
+    return Success;
+}
+
+/* the hash of a slot under a new seed for robin_reseed_str */
+static uint64_t _reseed_hash(void *map, const StrSlot *slot) {
+    return _str_hash(map, _slot_key(slot), slot->len);
+}
+
+/** find the slot of a key
+ *
+ * @return
+ *  the index or -1 if the key is not in the table
+ */
+static int _find_slot(StrHashMap *map, uint64_t hash, const char *key,
+                      size_t len) {
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_str(map->slots, mask, hash, &index, &distance)) {
+        if (_slot_matches(&map->slots[index], hash, key, len)) {
+            return index;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    return -1;
+}
+
+/** get the value slot for a key, copying the key in to the map if it is not
+ * there
+ *
+ * @param found
+ *  set to true if the key was already in the map, a new key has a NULL value
+ *
+ * @return
+ *  a pointer to the value or NULL if there was no memory, this is only valid
+ *  until the map is changed
+ */
+void **entry_str_hashmap(StrHashMap *map, const char *key, bool *found) {
+    size_t len = strlen(key);
+
+    *found = false;
+
+    if (len >= UINT32_MAX) {
+        return NULL;
+    }
+
+    if (map->flooded) {
+        robin_reseed_str(map, &map->slots, map->table_size, map->current_size,
+                         &map->seed, &map->flooded, &map->reseed_size,
+                         _reseed_hash);
+    }
+
+    uint64_t hash = _str_hash(map, key, len);
+
+    if (map->current_size + 1 >= map->threshold && _rehash(map) != Success) {
+        return NULL;
+    }
+
+    // the same single walk as entry_open, a new key goes where the walk stops
+    int mask = map->table_size - 1;
+    int index = hash & mask;
+    int distance = 0;
+
+    while (robin_probe_str(map->slots, mask, hash, &index, &distance)) {
+        StrSlot *slot = &map->slots[index];
+
+        if (_slot_matches(slot, hash, key, len)) {
+            *found = true;
+            return &slot->value;
+        }
+
+        index = (index + 1) & mask;
+        ++distance;
+    }
+
+    CHECK_FLOODING(map, distance + 1);
+
+    StrSlot slot = {.hash = hash, .value = NULL, .len = len};
+
+    if (len < STR_INLINE_SIZE) {
+        memcpy(slot.key.data, key, len + 1);
+    } else {
+        slot.key.ptr = _arena_copy(map, key, len);
+
+        if (slot.key.ptr == NULL) {
+            return NULL;
+        }
+    }
+
+    robin_place_str(map->slots, NULL, mask, slot, 0, index, distance);
+
+    ++map->current_size;
+
+    return &map->slots[index].value;
+}
+
+/** insert a copy of the key and a value
+ *
+ * @return
+ *  FailedToInsertDuplicate if the key is already in the map
+ */
+enum HashMapResult insert_str_hashmap(StrHashMap *map, const char *key,
+                                      void *value) {
+    bool found;
+    void **slot = entry_str_hashmap(map, key, &found);
+
+    if (slot == NULL) {
+        return FailedToInsertNoMemory;
+    }
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    *slot = value;
+
+    return Success;
+}
+
+bool contains_key_str_hashmap(StrHashMap *map, const char *key) {
+    size_t len = strlen(key);
+
+    return _find_slot(map, _str_hash(map, key, len), key, len) != -1;
+}
+
+void *get_value_str_hashmap(StrHashMap *map, const char *key) {
+    size_t len = strlen(key);
+    int index = _find_slot(map, _str_hash(map, key, len), key, len);
+
+    return index == -1 ? NULL : map->slots[index].value;
+}
+
+/** remove a key and return its value
+ *
+ * the value is not passed to the drop_func
+ */
+void *remove_entry_str_hashmap(StrHashMap *map, const char *key) {
+    size_t len = strlen(key);
+    int index = _find_slot(map, _str_hash(map, key, len), key, len);
+
+    if (index == -1) {
+        return NULL;
+    }
+
+    void *value = map->slots[index].value;
+
+    robin_shift_str(map->slots, NULL, map->table_size - 1, index);
+
+    --map->current_size;
+
+    return value;
+}
+
+/* move index to the next full slot and point key at its key */
+bool iter_next_str_hashmap(StrHashMap *map, int *index, const char **key,
+                           void **value) {
+    do {
+        ++*index;
+    } while (*index < map->table_size && map->slots[*index].hash == 0);
+
+    if (*index >= map->table_size) {
+        return false;
+    }
+
+    *key = _slot_key(&map->slots[*index]);
+    *value = map->slots[*index].value;
+
+    return true;
+}
@@ -0,0 +1,97 @@
+#ifndef MY_HASHMAP_STR
+#define MY_HASHMAP_STR
+
+#include "hashmap_base.h"
+
+/* keys shorter than this are stored in the slot, the rest go in the arena */
+#define STR_INLINE_SIZE 20
+
+/* the size of the arena blocks longer keys are copied in to */
+#define STR_ARENA_BLOCK 65536
+
+/* the function signature to drop a value of a StrHashMap
+ *
+ * the key belongs to the map so only the value should be freed
+ */
+typedef void (*StrDropFunc)(const char *key, void *value);
+
+/* a slot of a StrHashMap
+ *
+ * a hash of zero marks an empty slot like the open backend, the key is inline
+ * when len is under STR_INLINE_SIZE and is always zero terminated
+ */
+typedef struct {
+    uint64_t hash;
+    void *value;
+    uint32_t len;
+    union {
+        char data[STR_INLINE_SIZE];
+        char *ptr;
+    } key;
+} StrSlot;
+
+/* a block of the arena the longer keys are copied in to */
+typedef struct StrArenaBlock {
+    struct StrArenaBlock *next;
+    size_t used;
+    size_t size;
+    char data[];
+} StrArenaBlock;
+
+/* a hashmap with string keys
+ *
+ * the map keeps its own copy of every key so the caller does not need to
+ * allocate them, lookups compare the hash and the length before the bytes
+ * so a byte compare almost always means a match
+ *
+ * the keys in the arena are only freed with the map, so a map that removes a
+ * lot of long keys and adds new ones keeps growing
+ *
+ * the keys are hashed with the seed of the map, see FLOOD_PROBE_LENGTH
+ */
+typedef struct {
+    int table_size;
+    int current_size;
+    int threshold;
+    StrSlot *slots;
+    uint64_t seed;
+    bool flooded;
+    int reseed_size;
+    StrArenaBlock *arena;
+    StrDropFunc drop_func;
+} StrHashMap;
+
+StrHashMap *init_str_hashmap(StrDropFunc drop_func);
+
+void drop_str_hashmap(StrHashMap *map);
+
+void **entry_str_hashmap(StrHashMap *map, const char *key, bool *found);
+
+enum HashMapResult insert_str_hashmap(StrHashMap *map, const char *key,
+                                      void *value);
+
+bool contains_key_str_hashmap(StrHashMap *map, const char *key);
+
+void *get_value_str_hashmap(StrHashMap *map, const char *key);
+
+void *remove_entry_str_hashmap(StrHashMap *map, const char *key);
+
+bool iter_next_str_hashmap(StrHashMap *map, int *index, const char **key,
+                           void **value);
+
+/** iterate over a StrHashMap
+ *
+ * it is not safe to insert or remove while iterating, the keys point in to the
+ * map
+ *
+ * @param key
+ *  a const char * variable to point at each key
+ *
+ * @param value
+ *  a pointer variable to copy each value to
+ */
+#define for_each_str(map, key, value)                                          \
+    for (int _str_index = -1;                                                  \
+         iter_next_str_hashmap(map, &_str_index, &key, (void **)&value);)
+
+#endif
@@ -0,0 +1,565 @@
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define SWISS_X86
+#endif
+
+#include "hashmap_internal.h"
+
+/** the swiss table backend
+ *
+ * next to the slots there is one control byte per slot, a full slot holds the
+ * low 7 bits of the hash (h2) and the high bit is set for empty and deleted
+ * slots, the rest of the hash (h1) picks the group to start probing from
+ *
+ * a lookup loads a whole group of control bytes and compares all of them to
+ * h2 at once, comp_func is only called for the slots that match, so most of
+ * the non matching keys are rejected without leaving the control bytes
+ *
+ * the group width is picked at runtime, 32 if the cpu has avx2 and 16 for sse2
+ * or the scalar fallback
+ */
+
+#define CTRL_EMPTY 0x80
+#define CTRL_DELETED 0xFE
+
+#define H1(hash) ((hash) >> 7)
+#define H2(hash) ((uint8_t)((hash)&0x7F))
+
+/* the result of matching a group, bit n is set if byte n matched */
+typedef uint32_t GroupMask;
+
+/* how the probe functions should search a group */
+typedef GroupMask (*GroupMatchFunc)(const uint8_t *group, uint8_t h2);
+
+/* the function signature for the generated lookup functions */
+typedef Slot *(*SwissFindFunc)(HashMapBase *map, uint64_t hash, void *key);
+
+/** scalar versions
+ *
+ * these are used when there are no vector instructions, the loops are simple
+ * enough that the compiler might vectorize them anyway
+ */
+static inline GroupMask _match_scalar(const uint8_t *group, uint8_t h2) {
+    GroupMask mask = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        mask |= (GroupMask)(group[i] == h2) << i;
+    }
+
+    return mask;
+}
+
+static inline GroupMask _match_empty_scalar(const uint8_t *group) {
+    return _match_scalar(group, CTRL_EMPTY);
+}
+
+static inline GroupMask _match_free_scalar(const uint8_t *group) {
+    GroupMask mask = 0;
+
+    for (int i = 0; i < 16; ++i) {
+        mask |= (GroupMask)(group[i] >> 7) << i;
+    }
+
+    return mask;
+}
+
+#ifdef SWISS_X86
+/** sse2 versions
+ *
+ * these are part of the x86_64 baseline but the target attribute lets them be
+ * built for 32bit x86 as well
+ */
+__attribute__((target("sse2"))) static inline GroupMask
+_match_sse2(const uint8_t *group, uint8_t h2) {
+    __m128i ctrl = _mm_loadu_si128((const __m128i *)group);
+
+    return _mm_movemask_epi8(_mm_cmpeq_epi8(ctrl, _mm_set1_epi8(h2)));
+}
+
+__attribute__((target("sse2"))) static inline GroupMask
+_match_empty_sse2(const uint8_t *group) {
+    return _match_sse2(group, CTRL_EMPTY);
+}
+
+__attribute__((target("sse2"))) static inline GroupMask
+_match_free_sse2(const uint8_t *group) {
+    return _mm_movemask_epi8(_mm_loadu_si128((const __m128i *)group));
+}
+
+/* avx2 versions, these look at 32 control bytes at a time */
+__attribute__((target("avx2"))) static inline GroupMask
+_match_avx2(const uint8_t *group, uint8_t h2) {
+    __m256i ctrl = _mm256_loadu_si256((const __m256i *)group);
+
+    return _mm256_movemask_epi8(_mm256_cmpeq_epi8(ctrl, _mm256_set1_epi8(h2)));
+}
+
+__attribute__((target("avx2"))) static inline GroupMask
+_match_empty_avx2(const uint8_t *group) {
+    return _match_avx2(group, CTRL_EMPTY);
+}
+
+__attribute__((target("avx2"))) static inline GroupMask
+_match_free_avx2(const uint8_t *group) {
+    return _mm256_movemask_epi8(_mm256_loadu_si256((const __m256i *)group));
+}
+#endif
+
+/** generate a lookup function for one instruction set
+ *
+ * the matching functions are inlined in to the probe loop so there is only
+ * one indirect call per lookup, to the generated function, instead of one per
+ * group
+ *
+ * the groups are probed with triangular steps which visits every group when
+ * the group count is a power of two
+ */
+#define SWISS_FIND(name, attr, width, match, match_empty)                      \
+    attr static Slot *name(HashMapBase *map, uint64_t hash, void *key) {       \
+        size_t group_mask = (map->table_size / width) - 1;                     \
+        size_t group = H1(hash) & group_mask;                                  \
+        uint8_t h2 = H2(hash);                                                 \
+                                                                               \
+        for (size_t step = 1;; ++step) {                                       \
+            const uint8_t *ctrl = map->ctrl + group * width;                   \
+            Slot *slots = map->slots + group * width;                          \
+                                                                               \
+            for (GroupMask found = match(ctrl, h2); found;                     \
+                 found &= found - 1) {                                         \
+                Slot *slot = &slots[__builtin_ctz(found)];                     \
+                                                                               \
+                if (slot->hash == hash && map->comp_func(slot->key, key)) {    \
+                    COUNT_LOOKUP(map, true, step);                             \
+                    return slot;                                               \
+                }                                                              \
+            }                                                                  \
+                                                                               \
+            if (match_empty(ctrl) || step > group_mask) {                      \
+                COUNT_LOOKUP(map, false, step);                                \
+                return NULL;                                                   \
+            }                                                                  \
+                                                                               \
+            group = (group + step) & group_mask;                               \
+        }                                                                      \
+    }
+
+SWISS_FIND(_find_scalar, , 16, _match_scalar, _match_empty_scalar)
+
+#ifdef SWISS_X86
+SWISS_FIND(_find_sse2, __attribute__((target("sse2"))), 16, _match_sse2,
+           _match_empty_sse2)
+SWISS_FIND(_find_avx2, __attribute__((target("avx2"))), 32, _match_avx2,
+           _match_empty_avx2)
+#endif
+
+/* everything that changes with the instruction set */
+typedef struct {
+    int width;
+    SwissFindFunc find;
+    GroupMatchFunc match;
+    GroupMask (*match_free)(const uint8_t *group);
+} SwissOps;
+
+static const SwissOps scalar_ops = {
+    .width = 16,
+    .find = _find_scalar,
+    .match = _match_scalar,
+    .match_free = _match_free_scalar,
+};
+
+#ifdef SWISS_X86
+static const SwissOps sse2_ops = {
+    .width = 16,
+    .find = _find_sse2,
+    .match = _match_sse2,
+    .match_free = _match_free_sse2,
+};
+
+static const SwissOps avx2_ops = {
+    .width = 32,
+    .find = _find_avx2,
+    .match = _match_avx2,
+    .match_free = _match_free_avx2,
+};
+#endif
+
+/** pick the ops for the cpu we are running on
+ *
+ * the answer never changes so it is only worked out once
+ */
+static const SwissOps *_swiss_ops(void) {
+    static const SwissOps *ops = NULL;
+
+    if (ops == NULL) {
+        const SwissOps *picked = &scalar_ops;
+
+#ifdef SWISS_X86
+        __builtin_cpu_init();
+
+        if (__builtin_cpu_supports("avx2")) {
+            picked = &avx2_ops;
+        } else if (__builtin_cpu_supports("sse2")) {
+            picked = &sse2_ops;
+        }
+#endif
+
+        ops = picked;
+    }
+
+    return ops;
+}
+
+/* the smallest table the current group width can use */
+int min_table_size_swiss(void) {
+    return _swiss_ops()->width;
+}
+
+/** allocate the control bytes and slots
+ *
+ * @param map
+ *  the hashmap base, table_size needs to be set to a power of two that is at
+ *  least min_table_size_swiss
+ */
+bool alloc_table_swiss(HashMapBase *map) {
+    map->ctrl = malloc(map->table_size);
+    map->slots = malloc(sizeof(Slot) * map->table_size);
+
+    if (map->ctrl == NULL || map->slots == NULL) {
+        free(map->ctrl);
+        free(map->slots);
+
+        map->ctrl = NULL;
+        map->slots = NULL;
+
+        return false;
+    }
+
+    memset(map->ctrl, CTRL_EMPTY, map->table_size);
+    map->deleted_size = 0;
+
+    return true;
+}
+
+void drop_table_swiss(HashMapBase *map) {
+    if (map->drop_func) {
+        for (int i = 0; i < map->table_size; ++i) {
+            if (map->ctrl[i] < CTRL_EMPTY) {
+                map->drop_func(map->slots[i].key, map->slots[i].value);
+            }
+        }
+    }
+
+    free(map->ctrl);
+    free(map->slots);
+}
+
+/** find the first free slot on the probe sequence for the hash
+ *
+ * there is always a free slot as the table is rehashed before it gets full
+ *
+ * @param groups
+ *  set to the amount of groups that were looked at
+ */
+static int _find_free(HashMapBase *map, const SwissOps *ops, uint64_t hash,
+                      int *groups) {
+    size_t group_mask = (map->table_size / ops->width) - 1;
+    size_t group = H1(hash) & group_mask;
+
+    for (size_t step = 1;; ++step) {
+        GroupMask free_mask = ops->match_free(map->ctrl + group * ops->width);
+
+        if (free_mask) {
+            *groups = step;
+            return group * ops->width + __builtin_ctz(free_mask);
+        }
+
+        group = (group + step) & group_mask;
+    }
+}
+
+static inline void _set_slot(HashMapBase *map, int index, uint64_t hash,
+                             void *key, void *value) {
+    map->ctrl[index] = H2(hash);
+    map->slots[index].hash = hash;
+    map->slots[index].key = key;
+    map->slots[index].value = value;
+}
+
+/** rehash in to a new table of the given size
+ *
+ * this also clears out all the deleted markers
+ *
+ * @param map
+ *  the hashmap base
+ *
+ * @param new_table_size
+ *  the new table size, a power of two
+ */
+enum HashMapResult rehash_swiss(HashMapBase *map, int new_table_size) {
+    const SwissOps *ops = _swiss_ops();
+
+    uint8_t *old_ctrl = map->ctrl;
+    Slot *old_slots = map->slots;
+    int old_table_size = map->table_size;
+
+    map->table_size = new_table_size;
+
+    if (!alloc_table_swiss(map)) {
+        map->ctrl = old_ctrl;
+        map->slots = old_slots;
+        map->table_size = old_table_size;
+
+        return FailedToRehashNoMemory;
+    }
+
+    for (int i = 0; i < old_table_size; ++i) {
+        if (old_ctrl[i] < CTRL_EMPTY) {
+            Slot *slot = &old_slots[i];
+            int groups;
+            int index = _find_free(map, ops, slot->hash, &groups);
+
+            _set_slot(map, index, slot->hash, slot->key, slot->value);
+        }
+    }
+
+    free(old_ctrl);
+    free(old_slots);
+
+    return Success;
+}
+
+Slot *find_slot_swiss(HashMapBase *map, uint64_t hash, void *key) {
+    return _swiss_ops()->find(map, hash, key);
+}
+
+/* the first control bytes and slots a lookup for the hash will look at */
+void first_group_swiss(HashMapBase *map, uint64_t hash, const uint8_t **ctrl,
+                       const Slot **slots) {
+    int width = _swiss_ops()->width;
+    size_t group = H1(hash) & ((map->table_size / width) - 1);
+
+    *ctrl = map->ctrl + group * width;
+    *slots = map->slots + group * width;
+}
+
+/** find the slot for a key, adding the key if it is not there
+ *
+ * the deleted markers take up room in the table as well so if there are too
+ * many of them the table is rebuilt at the same size to clear them out
+ *
+ * @param found
+ *  set to true if the key was already in the table, if not the new slot has a
+ *  NULL value
+ *
+ * @return
+ *  the slot or NULL if the table had to be rebuilt and there was no memory
+ */
+Slot *entry_swiss(HashMapBase *map, uint64_t hash, void *key, bool *found) {
+    const SwissOps *ops = _swiss_ops();
+    Slot *slot = ops->find(map, hash, key);
+
+    *found = slot != NULL;
+
+    if (slot != NULL) {
+        return slot;
+    }
+
+    // both sides pass INT_MAX in the biggest tables so this is in 64 bits,
+    // the rebuild goes through resize_hashmap so it is counted as a pause
+    if (((int64_t)map->current_size + map->deleted_size + 1) * 8 >=
+        (int64_t)map->table_size * 7) {
+
+        if (resize_hashmap(map, map->table_size) != Success) {
+            return NULL;
+        }
+    }
+
+    int groups;
+    int index = _find_free(map, ops, hash, &groups);
+
+    CHECK_FLOODING(map, groups);
+
+    if (map->ctrl[index] == CTRL_DELETED) {
+        --map->deleted_size;
+    }
+
+    _set_slot(map, index, hash, key, NULL);
+
+    return &map->slots[index];
+}
+
+/* insert a key and value, the slot for it is found with entry_swiss */
+enum HashMapResult insert_swiss(HashMapBase *map, uint64_t hash, void *key,
+                                void *value) {
+    bool found;
+    Slot *slot = entry_swiss(map, hash, key, &found);
+
+    if (slot == NULL) {
+        return FailedToRehashNoMemory;
+    }
+
+    if (found) {
+        return FailedToInsertDuplicate;
+    }
+
+    slot->value = value;
+
+    return Success;
+}
+
+/** remove a key and return its value
+ *
+ * if the group the slot is in still has an empty slot then no probe sequence
+ * ever went past it, so the slot can be marked as empty instead of deleted
+ */
+void *remove_entry_swiss(HashMapBase *map, uint64_t hash, void *key) {
+    const SwissOps *ops = _swiss_ops();
+    Slot *slot = find_slot_swiss(map, hash, key);
+
+    if (slot == NULL) {
+        return NULL;
+    }
+
+    void *value = slot->value;
+
+    if (map->drop_func) {
+        map->drop_func(slot->key, NULL);
+    }
+
+    int index = slot - map->slots;
+    const uint8_t *group = map->ctrl + (index - index % ops->width);
+
+    if (ops->match(group, CTRL_EMPTY)) {
+        map->ctrl[index] = CTRL_EMPTY;
+    } else {
+        map->ctrl[index] = CTRL_DELETED;
+        ++map->deleted_size;
+    }
+
+    --map->current_size;
+
+    return value;
+}
+
+/** move the iter to the next full slot */
+void iter_next_base_swiss(IterHashMap *iter) {
+    ++iter->current_index;
+
+    while (iter->current_index < iter_end(iter) &&
+           iter->base->ctrl[iter->current_index] >= CTRL_EMPTY) {
+
+        ++iter->current_index;
+    }
+}
+
+bool iter_next_swiss(IterHashMap *iter, void **key, void **value) {
+    if (iter->current_index >= iter_end(iter)) {
+        return false;
+    }
+
+    Slot *slot = &iter->base->slots[iter->current_index];
+
+    *key = slot->key;
+    *value = slot->value;
+
+    iter_next_base_swiss(iter);
+
+    return true;
+}
+
+bool iter_next_drop_swiss(IterHashMap *iter, void **key, void **value) {
+    bool got_value = iter_next_swiss(iter, key, value);
+
+    if (got_value && iter->current_index >= iter->base->table_size) {
+        free(iter->base->ctrl);
+        free(iter->base->slots);
+
+        iter->base->ctrl = NULL;
+        iter->base->slots = NULL;
+    }
+
+    return got_value;
+}
+
+/* the most groups any key has to look at before it is found */
+int get_longest_chain_swiss(HashMapBase *map) {
+    int width = _swiss_ops()->width;
+    size_t group_mask = (map->table_size / width) - 1;
+    int longest = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->ctrl[i] >= CTRL_EMPTY) {
+            continue;
+        }
+
+        size_t group = H1(map->slots[i].hash) & group_mask;
+        int length = 1;
+
+        for (size_t step = 1; group != (size_t)(i / width); ++step) {
+            group = (group + step) & group_mask;
+            ++length;
+        }
+
+        if (length > longest) {
+            longest = length;
+        }
+    }
+
+    return longest;
+}
+
+/** fill in the parts of the stats that depend on the layout
+ *
+ * a miss stops at the first group with an empty slot, the deleted slots dont
+ * stop it which is why lots of them make misses slow
+ */
+void get_stats_swiss(HashMapBase *map, HashMapStats *stats) {
+    const SwissOps *ops = _swiss_ops();
+    size_t group_mask = (map->table_size / ops->width) - 1;
+    uint64_t hit_probes = 0;
+    uint64_t miss_probes = 0;
+    int empty = 0;
+
+    for (int i = 0; i < map->table_size; ++i) {
+        if (map->ctrl[i] == CTRL_EMPTY) {
+            ++empty;
+        }
+
+        if (map->ctrl[i] >= CTRL_EMPTY) {
+            continue;
+        }
+
+        size_t group = H1(map->slots[i].hash) & group_mask;
+        int length = 1;
+
+        for (size_t step = 1; group != (size_t)(i / ops->width); ++step) {
+            group = (group + step) & group_mask;
+            ++length;
+        }
+
+        stats_add_length(stats, length);
+        hit_probes += length;
+    }
+
+    for (size_t start = 0; start <= group_mask; ++start) {
+        size_t group = start;
+        size_t step = 1;
+
+        while (!ops->match(map->ctrl + group * ops->width, CTRL_EMPTY) &&
+               step <= group_mask) {
+
+            group = (group + step) & group_mask;
+            ++step;
+        }
+
+        miss_probes += step;
+    }
+
+    stats->empty_fraction = (double)empty / map->table_size;
+    stats->hit_probes =
+        map->current_size ? (double)hit_probes / map->current_size : 0;
+    stats->miss_probes = (double)miss_probes / (group_mask + 1);
+    stats->bytes_used = (sizeof(Slot) + 1) * map->table_size;
+}
@@ -0,0 +1,308 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/hashmap.h"
+
+/* read scaling of the sharded concurrent map and the lock free read map
+ * compared to one map behind one mutex, which is what had to be done before
+ *
+ * then the time one resize of the lock free map takes with more threads
+ * reading during it, every reader moves chunks of the resize it runs in to
+ *
+ * usage: bench_concurrent [max_threads] [keys] [reads_per_thread]
+ */
+
+#define SHARD_BITS 8
+
+typedef struct {
+    ConcurrentHashMap *sharded;
+    LockFreeHashMap *lockfree;
+    HashMapBase *single;
+    pthread_mutex_t *single_lock;
+    uint64_t *keys;
+    int key_count;
+    int reads;
+    uint64_t seed;
+    uint64_t found;
+    int *started;
+    int *stop;
+} ThreadData;
+
+uint64_t hash_key(const void *key) {
+    return integer_hash64(*(const uint64_t *)key);
+}
+
+bool comp_key(const void *key_1, const void *key_2) {
+    return *(const uint64_t *)key_1 == *(const uint64_t *)key_2;
+}
+
+double now_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* a small xorshift so every thread reads a different random order */
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+void *read_sharded(void *arg) {
+    ThreadData *data = arg;
+
+    for (int i = 0; i < data->reads; ++i) {
+        uint64_t *key = &data->keys[next_random(&data->seed) % data->key_count];
+
+        if (get_value_concurrent_hashmap_base(data->sharded, key)) {
+            ++data->found;
+        }
+    }
+
+    return NULL;
+}
+
+void *read_lockfree(void *arg) {
+    ThreadData *data = arg;
+
+    for (int i = 0; i < data->reads; ++i) {
+        uint64_t *key = &data->keys[next_random(&data->seed) % data->key_count];
+
+        if (get_value_lockfree_hashmap_base(data->lockfree, key)) {
+            ++data->found;
+        }
+    }
+
+    return NULL;
+}
+
+void *read_single(void *arg) {
+    ThreadData *data = arg;
+
+    for (int i = 0; i < data->reads; ++i) {
+        uint64_t *key = &data->keys[next_random(&data->seed) % data->key_count];
+
+        pthread_mutex_lock(data->single_lock);
+
+        if (get_value_hashmap_base(data->single, key)) {
+            ++data->found;
+        }
+
+        pthread_mutex_unlock(data->single_lock);
+    }
+
+    return NULL;
+}
+
+/* read until stop is set, so there is a reader in the map for the resize */
+void *spin_lockfree(void *arg) {
+    ThreadData *data = arg;
+
+    __atomic_fetch_add(data->started, 1, __ATOMIC_RELEASE);
+
+    while (!__atomic_load_n(data->stop, __ATOMIC_ACQUIRE)) {
+        uint64_t *key = &data->keys[next_random(&data->seed) % data->key_count];
+
+        if (get_value_lockfree_hashmap_base(data->lockfree, key)) {
+            ++data->found;
+        }
+    }
+
+    return NULL;
+}
+
+/** time the insert that grows a lock free map while other threads read
+ *
+ * the map is filled to just under a resize with at least half the keys, the
+ * readers are started and then the next insert does the resize
+ *
+ * @return
+ *  the seconds the insert took or -1 if no resize was in range
+ */
+double run_resize(uint64_t *keys, int key_count, int thread_count) {
+    LockFreeHashMap *map = init_lockfree_hashmap_base(hash_key, comp_key, NULL);
+    int filled = 0;
+
+    while (filled < key_count - 1 &&
+           (filled < key_count / 2 || map->current_size + 1 < map->threshold)) {
+
+        insert_lockfree_hashmap_base(map, &keys[filled], &keys[filled]);
+        ++filled;
+    }
+
+    if (map->current_size + 1 < map->threshold) {
+        drop_lockfree_hashmap_base(map);
+        return -1;
+    }
+
+    int readers = thread_count - 1;
+    int started = 0;
+    int stop = 0;
+    pthread_t threads[readers + 1];
+    ThreadData data[readers + 1];
+
+    for (int i = 0; i < readers; ++i) {
+        data[i] = (ThreadData){
+            .lockfree = map,
+            .keys = keys,
+            .key_count = filled,
+            .seed = 0x9E3779B97F4A7C15 * (i + 1),
+            .started = &started,
+            .stop = &stop,
+        };
+
+        pthread_create(&threads[i], NULL, spin_lockfree, &data[i]);
+    }
+
+    while (__atomic_load_n(&started, __ATOMIC_ACQUIRE) < readers) {
+        sched_yield();
+    }
+
+    double before = now_seconds();
+
+    insert_lockfree_hashmap_base(map, &keys[filled], &keys[filled]);
+
+    double seconds = now_seconds() - before;
+
+    __atomic_store_n(&stop, 1, __ATOMIC_RELEASE);
+
+    for (int i = 0; i < readers; ++i) {
+        pthread_join(threads[i], NULL);
+    }
+
+    drop_lockfree_hashmap_base(map);
+
+    return seconds;
+}
+
+/* run the reads on thread_count threads and return the reads per second */
+double run(void *(*func)(void *), ThreadData *base, int thread_count) {
+    pthread_t threads[thread_count];
+    ThreadData data[thread_count];
+
+    double before = now_seconds();
+
+    for (int i = 0; i < thread_count; ++i) {
+        data[i] = *base;
+        data[i].seed = 0x9E3779B97F4A7C15 * (i + 1);
+
+        pthread_create(&threads[i], NULL, func, &data[i]);
+    }
+
+    for (int i = 0; i < thread_count; ++i) {
+        pthread_join(threads[i], NULL);
+
+        if (data[i].found != (uint64_t)data[i].reads) {
+            printf("thread %d missed keys\n", i);
+        }
+    }
+
+    return (double)base->reads * thread_count / (now_seconds() - before);
+}
+
+int main(int argc, char **argv) {
+    int max_threads = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+    int key_count = argc > 2 ? atoi(argv[2]) : 1000000;
+    int reads = argc > 3 ? atoi(argv[3]) : 2000000;
+
+    uint64_t *keys = malloc(sizeof(uint64_t) * key_count);
+
+    ConcurrentHashMap *sharded = init_concurrent_hashmap_base(
+        hash_key, comp_key, NULL, SHARD_BITS, HashMapOpen);
+    LockFreeHashMap *lockfree =
+        init_lockfree_hashmap_base(hash_key, comp_key, NULL);
+    HashMapBase *single =
+        init_hashmap_base(hash_key, comp_key, NULL, STARTING_SIZE, HashMapOpen);
+
+    pthread_mutex_t single_lock = PTHREAD_MUTEX_INITIALIZER;
+
+    for (int i = 0; i < key_count; ++i) {
+        keys[i] = i;
+
+        insert_concurrent_hashmap_base(sharded, &keys[i], &keys[i]);
+        insert_lockfree_hashmap_base(lockfree, &keys[i], &keys[i]);
+        insert_hashmap_base(single, &keys[i], &keys[i]);
+    }
+
+    ThreadData base = {
+        .sharded = sharded,
+        .lockfree = lockfree,
+        .single = single,
+        .single_lock = &single_lock,
+        .keys = keys,
+        .key_count = key_count,
+        .reads = reads,
+        .found = 0,
+    };
+
+    printf("%d keys, %d reads per thread, %d shards\n", key_count, reads,
+           1 << SHARD_BITS);
+    printf("threads  sharded Mops/s  scaling  lock free Mops/s  scaling  "
+           "one mutex Mops/s  scaling\n");
+
+    double sharded_one = 0;
+    double lockfree_one = 0;
+    double single_one = 0;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double sharded_ops = run(read_sharded, &base, threads);
+        double lockfree_ops = run(read_lockfree, &base, threads);
+        double single_ops = run(read_single, &base, threads);
+
+        if (threads == 1) {
+            sharded_one = sharded_ops;
+            lockfree_one = lockfree_ops;
+            single_one = single_ops;
+        }
+
+        printf("%7d  %14.2f  %7.2f  %16.2f  %7.2f  %16.2f  %7.2f\n", threads,
+               sharded_ops / 1e6, sharded_ops / sharded_one,
+               lockfree_ops / 1e6, lockfree_ops / lockfree_one,
+               single_ops / 1e6, single_ops / single_one);
+
+        // make sure the last step is the max even if it is not a power of two
+        if (threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+
+    printf("\nthreads  lock free resize ms  speedup\n");
+
+    double resize_one = 0;
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double seconds = run_resize(keys, key_count, threads);
+
+        if (seconds < 0) {
+            printf("no resize between %d and %d keys\n", key_count / 2,
+                   key_count);
+            break;
+        }
+
+        if (threads == 1) {
+            resize_one = seconds;
+        }
+
+        printf("%7d  %19.2f  %7.2f\n", threads, seconds * 1e3,
+               resize_one / seconds);
+
+        if (threads < max_threads && threads * 2 > max_threads) {
+            threads = max_threads / 2;
+        }
+    }
+
+    drop_concurrent_hashmap_base(sharded);
+    drop_lockfree_hashmap_base(lockfree);
+    drop_hashmap_base(single);
+    free(keys);
+
+    return 0;
+}
@@ -0,0 +1,196 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/hashmap.h"
+
+/* compare fast_hash64 to data_hash64
+ *
+ * throughput is measured for a few key lengths, quality is measured with an
+ * avalanche test (flipping one input bit should flip every output bit half of
+ * the time) and with how evenly sequential keys fill a power of two table
+ *
+ * usage: bench_hash [hashes_per_length]
+ */
+
+#define MAX_LEN 1024
+#define BUCKET_BITS 16
+#define AVALANCHE_ROUNDS 2000
+
+typedef uint64_t (*BenchHashFunc)(const void *data, size_t len);
+
+uint64_t bench_data_hash64(const void *data, size_t len) {
+    return data_hash64(data, len);
+}
+
+uint64_t bench_fast_hash64(const void *data, size_t len) {
+    return fast_hash64(data, len, 0);
+}
+
+typedef struct {
+    const char *name;
+    BenchHashFunc func;
+} NamedHash;
+
+static const NamedHash hashes[] = {
+    {"data_hash64", bench_data_hash64},
+    {"fast_hash64", bench_fast_hash64},
+};
+
+static const size_t lengths[] = {4, 8, 16, 32, 64, 128, 200, 1024};
+
+double now_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+/* ns per hash, each hash feeds the next so the calls can not overlap */
+double bench_throughput(BenchHashFunc func, uint8_t *buffer, size_t len,
+                        int count) {
+    uint64_t hash = 0;
+
+    double before = now_seconds();
+
+    for (int i = 0; i < count; ++i) {
+        memcpy(buffer, &hash, sizeof(hash));
+
+        hash = func(buffer, len);
+    }
+
+    double seconds = now_seconds() - before;
+
+    // keep the result alive
+    if (hash == 42) {
+        printf("!");
+    }
+
+    return seconds * 1e9 / count;
+}
+
+/* the worst difference from 50% any output bit has when one input bit flips */
+double bench_avalanche(BenchHashFunc func, size_t len) {
+    static int flips[MAX_LEN * 8][64];
+    uint8_t buffer[MAX_LEN];
+    uint64_t state = 0x9E3779B97F4A7C15;
+
+    memset(flips, 0, sizeof(flips));
+
+    for (int round = 0; round < AVALANCHE_ROUNDS; ++round) {
+        for (size_t i = 0; i < len; ++i) {
+            buffer[i] = next_random(&state);
+        }
+
+        uint64_t hash = func(buffer, len);
+
+        for (size_t bit = 0; bit < len * 8; ++bit) {
+            buffer[bit / 8] ^= 1 << (bit % 8);
+
+            uint64_t diff = hash ^ func(buffer, len);
+
+            buffer[bit / 8] ^= 1 << (bit % 8);
+
+            for (int out = 0; out < 64; ++out) {
+                flips[bit][out] += (diff >> out) & 1;
+            }
+        }
+    }
+
+    double worst = 0;
+
+    for (size_t bit = 0; bit < len * 8; ++bit) {
+        for (int out = 0; out < 64; ++out) {
+            double bias = (double)flips[bit][out] / AVALANCHE_ROUNDS - 0.5;
+
+            bias = bias < 0 ? -bias : bias;
+
+            if (bias > worst) {
+                worst = bias;
+            }
+        }
+    }
+
+    return worst;
+}
+
+/** how evenly sequential integers fill the table
+ *
+ * this is the chi squared of the bucket counts divided by the degrees of
+ * freedom, a good hash is close to 1
+ */
+double bench_buckets(BenchHashFunc func) {
+    static int buckets[1 << BUCKET_BITS];
+    int keys = 8 << BUCKET_BITS;
+
+    memset(buckets, 0, sizeof(buckets));
+
+    for (uint64_t key = 0; key < (uint64_t)keys; ++key) {
+        ++buckets[func(&key, sizeof(key)) & ((1 << BUCKET_BITS) - 1)];
+    }
+
+    double expected = (double)keys / (1 << BUCKET_BITS);
+    double chi = 0;
+
+    for (int i = 0; i < 1 << BUCKET_BITS; ++i) {
+        chi += (buckets[i] - expected) * (buckets[i] - expected) / expected;
+    }
+
+    return chi / ((1 << BUCKET_BITS) - 1);
+}
+
+int main(int argc, char **argv) {
+    int count = argc > 1 ? atoi(argv[1]) : 2000000;
+    int hash_count = sizeof(hashes) / sizeof(hashes[0]);
+    int length_count = sizeof(lengths) / sizeof(lengths[0]);
+
+    uint8_t buffer[MAX_LEN];
+
+    for (int i = 0; i < MAX_LEN; ++i) {
+        buffer[i] = i * 31 + 7;
+    }
+
+    printf("throughput (ns per hash / GB per second)\n");
+    printf("%6s", "len");
+
+    for (int h = 0; h < hash_count; ++h) {
+        printf("  %24s", hashes[h].name);
+    }
+
+    printf("\n");
+
+    for (int l = 0; l < length_count; ++l) {
+        printf("%6zu", lengths[l]);
+
+        for (int h = 0; h < hash_count; ++h) {
+            double ns =
+                bench_throughput(hashes[h].func, buffer, lengths[l], count);
+
+            printf("  %11.2f ns %8.2f GB/s", ns, lengths[l] / ns);
+        }
+
+        printf("\n");
+    }
+
+    printf("\nquality\n");
+
+    for (int h = 0; h < hash_count; ++h) {
+        printf("%s\n", hashes[h].name);
+        printf("  worst avalanche bias  8 bytes %.3f  32 bytes %.3f\n",
+               bench_avalanche(hashes[h].func, 8),
+               bench_avalanche(hashes[h].func, 32));
+        printf("  sequential keys chi squared / df %.3f (1.0 is ideal)\n",
+               bench_buckets(hashes[h].func));
+    }
+
+    return 0;
+}
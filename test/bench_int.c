@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "../src/hashmap.h"
+
+/* compare IntHashMap to the other ways of keeping uint64_t keys
+ *
+ * the open backend needs a pointer to every key and calls the hash_func and
+ * comp_func through pointers, HASHMAP_INLINE stores the keys by value but
+ * keeps the hash next to them, IntHashMap only has the keys array to probe
+ *
+ * usage: bench_int [size]
+ */
+
+#define hash_u64(key) integer_hash64(key)
+#define comp_u64(key_1, key_2) ((key_1) == (key_2))
+
+HASHMAP_INLINE(InlineU64, uint64_t, void *, hash_u64, comp_u64);
+
+uint64_t hash_u64_ptr(const void *key) {
+    return integer_hash64(*(const uint64_t *)key);
+}
+
+bool comp_u64_ptr(const void *key_1, const void *key_2) {
+    return *(const uint64_t *)key_1 == *(const uint64_t *)key_2;
+}
+
+double now_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* time a loop over n keys and print the millions of ops per second */
+#define TIME_LOOP(name, workload, n, body)                                     \
+    do {                                                                       \
+        double before = now_seconds();                                         \
+                                                                               \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            body;                                                              \
+        }                                                                      \
+                                                                               \
+        printf("%-8s %-8s %8.2f Mops/s\n", name, workload,                     \
+               n / (now_seconds() - before) / 1e6);                            \
+    } while (0)
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    uint64_t *keys = malloc(sizeof(uint64_t) * n);
+    uint64_t *missing = malloc(sizeof(uint64_t) * n);
+    uint64_t state = 0x9e3779b97f4a7c15;
+    uintptr_t sink = 0;
+
+    if (keys == NULL || missing == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    // odd keys are in the maps and even keys are not
+    for (size_t i = 0; i < n; ++i) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+
+        keys[i] = state | 1;
+        missing[i] = state & ~(uint64_t)1;
+    }
+
+    IntHashMap *int_map = init_int_hashmap(NULL);
+
+    TIME_LOOP("int", "insert", n,
+              insert_int_hashmap(int_map, keys[i], (void *)keys[i]));
+    TIME_LOOP("int", "hit", n,
+              sink += (uintptr_t)get_value_int_hashmap(int_map, keys[i]));
+    TIME_LOOP("int", "miss", n,
+              sink += contains_key_int_hashmap(int_map, missing[i]));
+    TIME_LOOP("int", "count", n, {
+        bool found;
+        void **count = entry_int_hashmap(int_map, keys[i] & 0xffff, &found);
+
+        *count = (void *)((uintptr_t)*count + 1);
+    });
+
+    drop_int_hashmap(int_map);
+
+    InlineU64 *inline_map = init_InlineU64(STARTING_SIZE);
+
+    TIME_LOOP("inline", "insert", n,
+              insert_InlineU64(inline_map, keys[i], (void *)keys[i]));
+    TIME_LOOP("inline", "hit", n,
+              sink += (uintptr_t)*get_value_InlineU64(inline_map, keys[i]));
+    TIME_LOOP("inline", "miss", n,
+              sink += contains_key_InlineU64(inline_map, missing[i]));
+
+    drop_InlineU64(inline_map);
+
+    HashMapBase *open_map = init_hashmap_base(hash_u64_ptr, comp_u64_ptr, NULL,
+                                              STARTING_SIZE, HashMapOpen);
+
+    TIME_LOOP("open", "insert", n,
+              insert_hashmap_base(open_map, &keys[i], &keys[i]));
+    TIME_LOOP("open", "hit", n,
+              sink += (uintptr_t)get_value_hashmap_base(open_map, &keys[i]));
+    TIME_LOOP("open", "miss", n,
+              sink += contains_key_hashmap_base(open_map, &missing[i]));
+
+    drop_hashmap_base(open_map);
+
+    // use the results so the lookups are not optimized out
+    printf("checksum %lu\n", (unsigned long)sink);
+
+    free(keys);
+    free(missing);
+
+    return 0;
+}
@@ -0,0 +1,121 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/hashmap.h"
+
+/* compare StrHashMap to the open backend with string keys
+ *
+ * the open backend gets a pointer to a malloc'd key and calls strlen, the
+ * hash_func and strcmp through pointers, StrHashMap copies short keys in to
+ * the slot and only compares bytes once the hash and the length match
+ *
+ * the lookups use a second copy of the keys, like keys read from input, so
+ * the open backend can not find its key bytes already in the cache
+ *
+ * usage: bench_str [size] [key length]
+ */
+
+uint64_t hash_str(const void *key) {
+    return fast_hash64(key, strlen(key), 0);
+}
+
+bool comp_str(const void *key_1, const void *key_2) {
+    return strcmp(key_1, key_2) == 0;
+}
+
+double now_seconds() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return now.tv_sec + now.tv_nsec * 1e-9;
+}
+
+/* time a loop over n keys and print the millions of ops per second */
+#define TIME_LOOP(name, workload, n, body)                                     \
+    do {                                                                       \
+        double before = now_seconds();                                         \
+                                                                               \
+        for (size_t i = 0; i < n; ++i) {                                       \
+            body;                                                              \
+        }                                                                      \
+                                                                               \
+        printf("%-8s %-8s %8.2f Mops/s\n", name, workload,                     \
+               n / (now_seconds() - before) / 1e6);                            \
+    } while (0)
+
+/* make n distinct keys of about len bytes with a prefix */
+char **make_keys(size_t n, int len, char prefix) {
+    char **keys = malloc(sizeof(char *) * n);
+
+    for (size_t i = 0; keys != NULL && i < n; ++i) {
+        keys[i] = malloc(len + 32);
+
+        if (keys[i] == NULL) {
+            return NULL;
+        }
+
+        int written = sprintf(keys[i], "%c%zu", prefix, i * 2654435761u);
+
+        memset(keys[i] + written, 'x', len > written ? len - written : 0);
+        keys[i][len > written ? len : written] = '\0';
+    }
+
+    return keys;
+}
+
+int main(int argc, char **argv) {
+    size_t n = argc > 1 ? strtoull(argv[1], NULL, 10) : 1000000;
+    int len = argc > 2 ? atoi(argv[2]) : 12;
+    char **keys = make_keys(n, len, 'k');
+    char **probes = make_keys(n, len, 'k');
+    char **missing = make_keys(n, len, 'm');
+    uintptr_t sink = 0;
+
+    if (keys == NULL || probes == NULL || missing == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    printf("%zu keys of %d bytes\n", n, len);
+
+    StrHashMap *str_map = init_str_hashmap(NULL);
+
+    TIME_LOOP("str", "insert", n,
+              insert_str_hashmap(str_map, keys[i], keys[i]));
+    TIME_LOOP("str", "hit", n,
+              sink += (uintptr_t)get_value_str_hashmap(str_map, probes[i]));
+    TIME_LOOP("str", "miss", n,
+              sink += contains_key_str_hashmap(str_map, missing[i]));
+
+    drop_str_hashmap(str_map);
+
+    HashMapBase *open_map = init_hashmap_base(hash_str, comp_str, NULL,
+                                              STARTING_SIZE, HashMapOpen);
+
+    TIME_LOOP("open", "insert", n,
+              insert_hashmap_base(open_map, keys[i], keys[i]));
+    TIME_LOOP("open", "hit", n,
+              sink += (uintptr_t)get_value_hashmap_base(open_map, probes[i]));
+    TIME_LOOP("open", "miss", n,
+              sink += contains_key_hashmap_base(open_map, missing[i]));
+
+    drop_hashmap_base(open_map);
+
+    // use the results so the lookups are not optimized out
+    printf("checksum %lu\n", (unsigned long)sink);
+
+    for (size_t i = 0; i < n; ++i) {
+        free(keys[i]);
+        free(probes[i]);
+        free(missing[i]);
+    }
+
+    free(keys);
+    free(probes);
+    free(missing);
+
+    return 0;
+}
@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "../src/hashmap.h"
+
+/** the benchmark suite
+ *
+ * every backend is run with every key type at every size, each run goes
+ * through the workloads below on one map
+ *
+ *  insert  insert n new keys in to an empty map
+ *  hit     look up n keys that are in the map in a random order
+ *  miss    look up n keys that are not in the map
+ *  mixed   n operations, half hits, a quarter inserts and a quarter removes
+ *  iterate walk over every entry with for_each
+ *  remove  remove every key in a random order
+ *
+ * every workload runs twice, once untimed per operation for the throughput and
+ * once with every operation timed for the p50, p99 and p999 latencies
+ *
+ * usage: bench_suite [--max-size n] [--backend name] [--key name]
+ *                    [--load-factor x] [--json]
+ *
+ * the sizes go from 1K up to max-size by factors of 10 (the default max is
+ * 1M, 100M needs a lot of memory), --json prints one json document instead of
+ * the table so results can be kept and compared between releases
+ *
+ * --load-factor sets the max load factor of every map, the tail latencies
+ * mostly differ between the backends when the tables are full, a backend that
+ * does not allow the load factor is skipped
+ */
+
+/* latencies below this are counted in an exact histogram, anything slower is
+ * kept in a list as those should only be rehashes
+ */
+#define EXACT_LATENCY_NS 65536
+
+typedef struct {
+    const char *name;
+    enum HashMapBackend backend;
+    bool incremental;
+} BenchBackend;
+
+static const BenchBackend backends[] = {
+    {"chained", HashMapChained, false},
+    {"chained_incremental", HashMapChained, true},
+    {"open", HashMapOpen, false},
+    {"swiss", HashMapSwiss, false},
+    {"compact", HashMapCompact, false},
+    {"cuckoo", HashMapCuckoo, false},
+};
+
+/* the struct key type */
+typedef struct {
+    uint64_t x;
+    uint64_t y;
+    uint32_t z;
+} BenchPoint;
+
+/* short strings are stored inline so making them does not time malloc */
+#define SHORT_STRING_LEN 24
+
+typedef struct {
+    char value[SHORT_STRING_LEN];
+} BenchString;
+
+uint64_t hash_int(const void *key) {
+    return integer_hash64(*(const uint64_t *)key);
+}
+
+bool comp_int(const void *key_1, const void *key_2) {
+    return *(const uint64_t *)key_1 == *(const uint64_t *)key_2;
+}
+
+uint64_t hash_string(const void *key) {
+    const char *string = ((const BenchString *)key)->value;
+
+    return fast_hash64(string, strlen(string), 0);
+}
+
+bool comp_string(const void *key_1, const void *key_2) {
+    return strcmp(((const BenchString *)key_1)->value,
+                  ((const BenchString *)key_2)->value) == 0;
+}
+
+uint64_t hash_point(const void *key) {
+    const BenchPoint *point = key;
+
+    // hash the fields and not the struct so the padding is not included
+    uint64_t fields[3] = {point->x, point->y, point->z};
+
+    return fast_hash64(fields, sizeof(fields), 0);
+}
+
+bool comp_point(const void *key_1, const void *key_2) {
+    const BenchPoint *point_1 = key_1;
+    const BenchPoint *point_2 = key_2;
+
+    return point_1->x == point_2->x && point_1->y == point_2->y &&
+           point_1->z == point_2->z;
+}
+
+/* fill a key from a number, every number gives a different key */
+typedef void (*MakeKeyFunc)(void *key, uint64_t number);
+
+void make_int(void *key, uint64_t number) {
+    *(uint64_t *)key = number;
+}
+
+void make_string(void *key, uint64_t number) {
+    snprintf(((BenchString *)key)->value, SHORT_STRING_LEN, "user:%llu",
+             (unsigned long long)number);
+}
+
+void make_point(void *key, uint64_t number) {
+    BenchPoint *point = key;
+
+    point->x = number;
+    point->y = number * 3;
+    point->z = (uint32_t)number;
+}
+
+typedef struct {
+    const char *name;
+    size_t size;
+    HashFunc hash_func;
+    CompFunc comp_func;
+    MakeKeyFunc make_key;
+} BenchKey;
+
+static const BenchKey key_types[] = {
+    {"int", sizeof(uint64_t), hash_int, comp_int, make_int},
+    {"string", sizeof(BenchString), hash_string, comp_string, make_string},
+    {"struct", sizeof(BenchPoint), hash_point, comp_point, make_point},
+};
+
+/* the latencies for one workload */
+typedef struct {
+    uint64_t *exact;
+    uint64_t *slow;
+    size_t slow_count;
+    size_t slow_cap;
+    size_t count;
+} Latencies;
+
+typedef struct {
+    double ops_per_second;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    bool has_latency;
+} BenchResult;
+
+static bool json = false;
+static double load_factor = 0;
+static bool first_json_result = true;
+
+static inline uint64_t now_ns() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    return (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+}
+
+static inline uint64_t next_random(uint64_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+
+    return *state;
+}
+
+void reset_latencies(Latencies *latencies) {
+    memset(latencies->exact, 0, sizeof(uint64_t) * EXACT_LATENCY_NS);
+
+    latencies->slow_count = 0;
+    latencies->count = 0;
+}
+
+static inline void add_latency(Latencies *latencies, uint64_t ns) {
+    ++latencies->count;
+
+    if (ns < EXACT_LATENCY_NS) {
+        ++latencies->exact[ns];
+        return;
+    }
+
+    if (latencies->slow_count == latencies->slow_cap) {
+        latencies->slow_cap =
+            latencies->slow_cap ? latencies->slow_cap * 2 : 64;
+        latencies->slow =
+            realloc(latencies->slow, sizeof(uint64_t) * latencies->slow_cap);
+    }
+
+    latencies->slow[latencies->slow_count++] = ns;
+}
+
+int comp_u64(const void *a, const void *b) {
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+
+    return x < y ? -1 : x > y;
+}
+
+uint64_t percentile(Latencies *latencies, double fraction) {
+    size_t rank = (size_t)(fraction * (latencies->count - 1));
+    size_t seen = 0;
+
+    for (uint64_t ns = 0; ns < EXACT_LATENCY_NS; ++ns) {
+        seen += latencies->exact[ns];
+
+        if (seen > rank) {
+            return ns;
+        }
+    }
+
+    qsort(latencies->slow, latencies->slow_count, sizeof(uint64_t), comp_u64);
+
+    return latencies->slow[rank - seen];
+}
+
+void fill_percentiles(BenchResult *result, Latencies *latencies) {
+    result->has_latency = true;
+    result->p50 = percentile(latencies, 0.5);
+    result->p99 = percentile(latencies, 0.99);
+    result->p999 = percentile(latencies, 0.999);
+}
+
+/* everything a run needs */
+typedef struct {
+    const BenchBackend *backend;
+    const BenchKey *key_type;
+    size_t size;
+    void **keys;
+    void **missing;
+    void **order;
+    Latencies latencies;
+} BenchRun;
+
+HashMapBase *new_map(BenchRun *run) {
+    HashMapBase *map =
+        init_hashmap_base(run->key_type->hash_func, run->key_type->comp_func,
+                          NULL, STARTING_SIZE, run->backend->backend);
+
+    if (map && run->backend->incremental) {
+        set_incremental_rehash_base(map, true);
+    }
+
+    if (map && load_factor > 0) {
+        set_load_factor_hashmap_base(map, load_factor, GROWTH_FACTOR);
+    }
+
+    return map;
+}
+
+/* check the backend of the run can have the --load-factor */
+bool allows_load_factor(BenchRun *run) {
+    HashMapBase *map = new_map(run);
+    bool allowed = map != NULL;
+
+    if (map && load_factor > 0) {
+        allowed = set_load_factor_hashmap_base(map, load_factor, GROWTH_FACTOR);
+    }
+
+    if (map) {
+        drop_hashmap_base(map);
+    }
+
+    return allowed;
+}
+
+void fill_map(HashMapBase *map, BenchRun *run) {
+    for (size_t i = 0; i < run->size; ++i) {
+        insert_hashmap_base(map, run->keys[i], run->keys[i]);
+    }
+}
+
+/** time one operation
+ *
+ * the macro runs the operation once with no timing for the throughput, the
+ * timed pass runs it again in a loop where each call is timed
+ */
+#define TIME_OPS(run, result, count, setup, op)                                \
+    do {                                                                       \
+        setup;                                                                 \
+                                                                               \
+        uint64_t _before = now_ns();                                           \
+                                                                               \
+        for (size_t i = 0; i < (count); ++i) {                                 \
+            op;                                                                \
+        }                                                                      \
+                                                                               \
+        (result)->ops_per_second = (count) / ((now_ns() - _before) * 1e-9);   \
+                                                                               \
+        reset_latencies(&(run)->latencies);                                    \
+        setup;                                                                 \
+                                                                               \
+        for (size_t i = 0; i < (count); ++i) {                                 \
+            uint64_t _start = now_ns();                                        \
+                                                                               \
+            op;                                                                \
+                                                                               \
+            add_latency(&(run)->latencies, now_ns() - _start);                 \
+        }                                                                      \
+                                                                               \
+        fill_percentiles(result, &(run)->latencies);                           \
+    } while (0)
+
+void print_result(BenchRun *run, const char *workload, BenchResult *result) {
+    if (json) {
+        printf("%s\n    {\"backend\": \"%s\", \"key\": \"%s\", \"size\": %zu, "
+               "\"workload\": \"%s\", \"ops_per_second\": %.0f",
+               first_json_result ? "" : ",", run->backend->name,
+               run->key_type->name, run->size, workload,
+               result->ops_per_second);
+
+        if (result->has_latency) {
+            printf(", \"p50_ns\": %llu, \"p99_ns\": %llu, \"p999_ns\": %llu}",
+                   (unsigned long long)result->p50,
+                   (unsigned long long)result->p99,
+                   (unsigned long long)result->p999);
+        } else {
+            printf("}");
+        }
+
+        first_json_result = false;
+        return;
+    }
+
+    printf("%-20s %-7s %10zu %-8s %10.2f", run->backend->name,
+           run->key_type->name, run->size, workload,
+           result->ops_per_second / 1e6);
+
+    if (result->has_latency) {
+        printf(" %8llu %8llu %8llu\n", (unsigned long long)result->p50,
+               (unsigned long long)result->p99,
+               (unsigned long long)result->p999);
+    } else {
+        printf(" %8s %8s %8s\n", "-", "-", "-");
+    }
+}
+
+void run_workloads(BenchRun *run) {
+    BenchResult result = {0};
+    HashMapBase *map = NULL;
+    size_t n = run->size;
+
+    TIME_OPS(run, &result, n,
+             {
+                 if (map) {
+                     drop_hashmap_base(map);
+                 }
+                 map = new_map(run);
+             },
+             insert_hashmap_base(map, run->keys[i], run->keys[i]));
+    print_result(run, "insert", &result);
+
+    TIME_OPS(run, &result, n, {},
+             get_value_hashmap_base(map, run->order[i]));
+    print_result(run, "hit", &result);
+
+    TIME_OPS(run, &result, n, {},
+             get_value_hashmap_base(map, run->missing[i]));
+    print_result(run, "miss", &result);
+
+    // every fourth op inserts a missing key and the one after removes the
+    // key inserted the round before, so the size stays the same
+    size_t inserted = 0;
+    size_t removed = 0;
+
+    TIME_OPS(run, &result, n,
+             {
+                 for (; removed < inserted; ++removed) {
+                     remove_entry_hashmap_base(map, run->missing[removed]);
+                 }
+                 inserted = 0;
+                 removed = 0;
+             },
+             {
+                 switch (i & 3) {
+                     case 0:
+                     case 1:
+                         get_value_hashmap_base(map, run->order[i]);
+                         break;
+                     case 2:
+                         insert_hashmap_base(map, run->missing[inserted],
+                                             run->missing[inserted]);
+                         ++inserted;
+                         break;
+                     case 3:
+                         if (removed + 1 < inserted) {
+                             remove_entry_hashmap_base(map,
+                                                       run->missing[removed]);
+                             ++removed;
+                         }
+                         break;
+                 }
+             });
+    print_result(run, "mixed", &result);
+
+    for (; removed < inserted; ++removed) {
+        remove_entry_hashmap_base(map, run->missing[removed]);
+    }
+
+    // there is no per operation latency for iteration
+    IterHashMap *iter = get_iter_hashmap_base(map);
+    void *key;
+    void *value;
+    size_t seen = 0;
+
+    uint64_t before = now_ns();
+
+    for_each(iter, key, value) {
+        ++seen;
+    }
+
+    result.ops_per_second = seen / ((now_ns() - before) * 1e-9);
+    result.has_latency = false;
+
+    drop_iter_hashmap(iter);
+    print_result(run, "iterate", &result);
+
+    TIME_OPS(run, &result, n,
+             {
+                 if (map->current_size == 0) {
+                     fill_map(map, run);
+                 }
+             },
+             remove_entry_hashmap_base(map, run->order[i]));
+    print_result(run, "remove", &result);
+
+    drop_hashmap_base(map);
+}
+
+/* make the keys for a key type, the missing keys use numbers past size */
+void make_keys(BenchRun *run, char *storage) {
+    size_t size = run->key_type->size;
+    uint64_t state = 0x9E3779B97F4A7C15;
+
+    for (size_t i = 0; i < run->size * 2; ++i) {
+        void *key = storage + i * size;
+
+        run->key_type->make_key(key, i);
+
+        if (i < run->size) {
+            run->keys[i] = key;
+            run->order[i] = key;
+        } else {
+            run->missing[i - run->size] = key;
+        }
+    }
+
+    // shuffle the lookup order so it is not the insert order
+    for (size_t i = run->size - 1; i > 0; --i) {
+        size_t j = next_random(&state) % (i + 1);
+        void *temp = run->order[i];
+
+        run->order[i] = run->order[j];
+        run->order[j] = temp;
+    }
+}
+
+int main(int argc, char **argv) {
+    size_t max_size = 1000000;
+    const char *only_backend = NULL;
+    const char *only_key = NULL;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--max-size") == 0 && i + 1 < argc) {
+            max_size = strtoull(argv[++i], NULL, 10);
+        } else if (strcmp(argv[i], "--backend") == 0 && i + 1 < argc) {
+            only_backend = argv[++i];
+        } else if (strcmp(argv[i], "--key") == 0 && i + 1 < argc) {
+            only_key = argv[++i];
+        } else if (strcmp(argv[i], "--load-factor") == 0 && i + 1 < argc) {
+            load_factor = strtod(argv[++i], NULL);
+        } else if (strcmp(argv[i], "--json") == 0) {
+            json = true;
+        } else {
+            printf("usage: %s [--max-size n] [--backend name] [--key name] "
+                   "[--load-factor x] [--json]\n",
+                   argv[0]);
+            return 1;
+        }
+    }
+
+    BenchRun run = {0};
+    run.latencies.exact = malloc(sizeof(uint64_t) * EXACT_LATENCY_NS);
+
+    if (json) {
+        printf("{\"results\": [");
+    } else {
+        printf("%-20s %-7s %10s %-8s %10s %8s %8s %8s\n", "backend", "key",
+               "size", "workload", "Mops/s", "p50 ns", "p99 ns", "p999 ns");
+    }
+
+    int backend_count = sizeof(backends) / sizeof(backends[0]);
+    int key_count = sizeof(key_types) / sizeof(key_types[0]);
+
+    for (int k = 0; k < key_count; ++k) {
+        if (only_key && strcmp(only_key, key_types[k].name) != 0) {
+            continue;
+        }
+
+        run.key_type = &key_types[k];
+
+        for (size_t size = 1000; size <= max_size; size *= 10) {
+            run.size = size;
+            run.keys = malloc(sizeof(void *) * size);
+            run.missing = malloc(sizeof(void *) * size);
+            run.order = malloc(sizeof(void *) * size);
+
+            char *storage = malloc(key_types[k].size * size * 2);
+
+            if (!run.keys || !run.missing || !run.order || !storage) {
+                printf("not enough memory for %zu keys\n", size);
+                return 1;
+            }
+
+            make_keys(&run, storage);
+
+            for (int b = 0; b < backend_count; ++b) {
+                if (only_backend && strcmp(only_backend, backends[b].name)) {
+                    continue;
+                }
+
+                run.backend = &backends[b];
+
+                if (!allows_load_factor(&run)) {
+                    continue;
+                }
+
+                run_workloads(&run);
+            }
+
+            free(storage);
+            free(run.keys);
+            free(run.missing);
+            free(run.order);
+        }
+    }
+
+    if (json) {
+        printf("\n]}\n");
+    }
+
+    free(run.latencies.exact);
+    free(run.latencies.slow);
+
+    return 0;
+}
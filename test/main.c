@@ -13,6 +13,18 @@
 
 // HASHMAP(HashMapData, struct TestStruct, struct TestStruct);
 HASHMAP(HashMapStr, char, char);
+HASHMAP(HashMapInt, int, int);
+HASHSET(HashSetInt, int);
+CONCURRENT_HASHMAP(ConcurrentInt, int, int);
+
+#define hash_char(key) integer_hash64(key)
+#define comp_char(key_1, key_2) ((key_1) == (key_2))
+
+HASHMAP_INLINE(HashMapChar, char, char, hash_char, comp_char);
+
+#define hash_same_inline(key) 42
+
+HASHMAP_INLINE(HashMapSame, int, int, hash_same_inline, comp_char);
 
 uint64_t hash_data(char *key) {
     // int str_len = strnlen(key, INTMAX_MAX);
@@ -29,16 +41,29 @@ void drop_data_func(char *key, char *data) {
     free(data);
 }
 
-HashMapStr *init_map() {
+uint64_t hash_int(int *key) {
+    return integer_hash64(*key);
+}
+
+bool comp_int(int *key_1, int *key_2) {
+    return *key_1 == *key_2;
+}
+
+size_t size_int(const void *data) {
+    return sizeof(int);
+}
+
+HashMapStr *init_map(enum HashMapBackend backend) {
     HashMapStr *map;
 
-    init_hashmap(map, hash_data, comp_data_func, drop_data_func);
+    init_hashmap_backend(map, backend, hash_data, comp_data_func,
+                         drop_data_func);
 
     return map;
 }
 
-int main() {
-    HashMapStr *map = init_map();
+int test_backend(enum HashMapBackend backend) {
+    HashMapStr *map = init_map(backend);
 
     if (map == NULL) {
         printf("did not allocate memory\n");
@@ -85,10 +110,41 @@ int main() {
         printf("found %c \n", *(char *)return_value);
     }
 
+    char batch_keys[] = {'a', 'b', ' ', 'c'};
+    char *batch_key_ptrs[] = {&batch_keys[0], &batch_keys[1], &batch_keys[2],
+                              &batch_keys[3]};
+    char *batch_values[4];
+    bool batch_contains[4];
+
+    get_values_hashmap(map, batch_key_ptrs, 4, batch_values);
+    contains_keys_hashmap(map, batch_key_ptrs, 4, batch_contains);
+
+    for (int i = 0; i < 4; ++i) {
+        // the space is the only key that was not inserted
+        if ((batch_values[i] != NULL) != (batch_keys[i] != ' ') ||
+            batch_contains[i] != (batch_keys[i] != ' ')) {
+            printf("bad batch lookup for '%c'\n", batch_keys[i]);
+
+            drop_hashmap(map);
+            return 1;
+        }
+    }
+
     int longest = get_longest_chain(map);
 
     printf("longest chain %d\n", longest);
 
+    HashMapStats stats;
+    get_stats_hashmap(map, &stats);
+
+    if (stats.size != map->map_base->current_size ||
+        stats.longest != longest || stats.bytes_per_entry <= 0) {
+        printf("bad stats\n");
+
+        drop_hashmap(map);
+        return 1;
+    }
+
     bool contains = false;
     IterHashMap *iter;
     get_iter_hashmap(map, iter);
@@ -122,3 +178,1476 @@ int main() {
 
     return 0;
 }
+
+/* a map made with a capacity should not rehash while it is filled and should
+ * get smaller again when most of it is removed
+ */
+int test_capacity(enum HashMapBackend backend) {
+    static int keys[4096];
+    HashMapInt *map;
+
+    init_hashmap_with_capacity(map, backend, 4096, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+
+    for (int i = 0; i < 4096 && result == Success; ++i) {
+        keys[i] = i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+    }
+
+    int full_size = map->map_base->table_size;
+
+    int *value = NULL;
+
+    for (int i = 16; i < 4096; ++i) {
+        remove_entry_hashmap(map, &keys[i], value);
+    }
+
+    HashMapStats stats;
+    get_stats_hashmap(map, &stats);
+
+    bool good = result == Success && stats.rehash_count == 0 &&
+                shrink_to_fit_hashmap(map) == Success &&
+                map->map_base->table_size < full_size;
+
+    get_value_hashmap(map, &keys[15], value);
+
+    drop_hashmap(map);
+
+    if (!good || value != &keys[15]) {
+        printf("bad capacity handling\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* a table smaller than any backend wants is made big enough to work */
+int test_small_table(enum HashMapBackend backend) {
+    static int keys[100];
+    bool good = true;
+
+    for (int size = 2; size <= 4 && good; size *= 2) {
+        HashMapBase *map = init_hashmap_base(
+            (HashFunc)hash_int, (CompFunc)comp_int, NULL, size, backend);
+
+        if (map == NULL) {
+            printf("did not allocate memory\n");
+            return 1;
+        }
+
+        for (int i = 0; i < 100 && good; ++i) {
+            keys[i] = i;
+            good = insert_hashmap_base(map, &keys[i], &keys[i]) == Success;
+        }
+
+        for (int i = 0; i < 100 && good; ++i) {
+            good = get_value_hashmap_base(map, &keys[i]) == &keys[i];
+        }
+
+        drop_hashmap_base(map);
+    }
+
+    if (!good) {
+        printf("bad small table\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* count words with the entry api and check upsert and get or insert */
+int test_entry(enum HashMapBackend backend) {
+    static int keys[] = {1, 2, 1, 3, 1, 2};
+    int counts[3] = {0, 0, 0};
+    HashMapInt *map;
+
+    init_hashmap_backend(map, backend, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < 6; ++i) {
+        int **value;
+        bool found;
+
+        entry_hashmap(map, &keys[i], value, found);
+
+        if (!found) {
+            *value = &counts[keys[i] - 1];
+        }
+
+        ++**value;
+    }
+
+    int replacement = 0;
+    int *old_value = NULL;
+    int *current = NULL;
+    enum HashMapResult result;
+
+    upsert_hashmap(map, &keys[1], &replacement, old_value, result);
+    get_or_insert_hashmap(map, &keys[0], &replacement, current);
+
+    bool good = counts[0] == 3 && counts[1] == 2 && counts[2] == 1 &&
+                result == Success && old_value == &counts[1] &&
+                current == &counts[0] && map->map_base->current_size == 3;
+
+    get_value_hashmap(map, &keys[1], current);
+
+    drop_hashmap(map);
+
+    if (!good || current != &replacement) {
+        printf("bad entry api\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* build a map on a few threads from arrays where every 100th key is a repeat
+ * of the one before it
+ */
+int test_build(enum HashMapBackend backend) {
+    static int keys[10000];
+    static int *key_ptrs[10000];
+    static bool duplicates[10000];
+    HashMapInt *map;
+
+    init_hashmap_backend(map, backend, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    for (int i = 0; i < 10000; ++i) {
+        keys[i] = i % 100 == 99 ? i - 1 : i;
+        key_ptrs[i] = &keys[i];
+    }
+
+    enum HashMapResult result = Success;
+
+    build_hashmap_from_arrays(map, key_ptrs, key_ptrs, 10000, 4, duplicates,
+                              result);
+
+    bool good = result == FailedToInsertDuplicate &&
+                map->map_base->current_size == 9900;
+
+    for (int i = 0; i < 10000 && good; ++i) {
+        int *value = NULL;
+
+        get_value_hashmap(map, &keys[i], value);
+
+        // the first pair for a key is the one that is kept
+        good = duplicates[i] == (i % 100 == 99) &&
+               value == (duplicates[i] ? &keys[i - 1] : &keys[i]);
+    }
+
+    drop_hashmap(map);
+
+    if (!good) {
+        printf("bad bulk build\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* add up the values for each thread */
+void sum_int(int *key, int *value, void *ctx, int thread_id) {
+    ((long *)ctx)[thread_id] += *value;
+}
+
+/* split the map between range iters and threads and add up the values */
+int test_parallel(enum HashMapBackend backend) {
+    static int keys[10000];
+    HashMapInt *map;
+
+    init_hashmap_backend(map, backend, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+    long expected = 0;
+
+    for (int i = 0; i < 10000; ++i) {
+        keys[i] = i;
+        expected += i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+    }
+
+    if (result != Success) {
+        printf("bad insert\n");
+
+        drop_hashmap(map);
+        return 1;
+    }
+
+    long range_sum = 0;
+    int half = get_bucket_count_hashmap(map) / 2;
+    IterHashMap *first;
+    IterHashMap *second;
+    int *key;
+    int *value;
+
+    get_iter_range_hashmap(map, 0, half, first);
+    get_iter_range_hashmap(map, half, -1, second);
+
+    for_each(first, key, value) {
+        range_sum += *value;
+    }
+
+    for_each(second, key, value) {
+        range_sum += *value;
+    }
+
+    drop_iter_hashmap(first);
+    drop_iter_hashmap(second);
+
+    long sums[4] = {0, 0, 0, 0};
+
+    parallel_for_each_hashmap(map, 4, sum_int, sums);
+
+    drop_hashmap(map);
+
+    if (range_sum != expected ||
+        sums[0] + sums[1] + sums[2] + sums[3] != expected) {
+        printf("bad parallel iteration\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+typedef struct {
+    ConcurrentInt *map;
+    int *keys;
+    bool stop;
+    bool bad;
+} ConcurrentTest;
+
+typedef struct {
+    ConcurrentTest *test;
+    int start;
+    bool bad;
+} ConcurrentWriter;
+
+/* keys 40000 to 40999 are in the map the whole time */
+void *read_concurrent(void *arg) {
+    ConcurrentTest *test = arg;
+
+    while (!__atomic_load_n(&test->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 40000; i < 41000; ++i) {
+            int *value;
+            bool contains;
+
+            get_value_concurrent_hashmap(test->map, &test->keys[i], value);
+            contains_key_concurrent_hashmap(test->map, &test->keys[i],
+                                            contains);
+
+            if (value != &test->keys[i] || !contains) {
+                test->bad = true;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* insert 10000 keys from start and remove the odd ones again */
+void *write_concurrent(void *arg) {
+    ConcurrentWriter *writer = arg;
+    ConcurrentInt *map = writer->test->map;
+    int *keys = writer->test->keys;
+    enum HashMapResult result;
+
+    for (int i = writer->start; i < writer->start + 10000; ++i) {
+        insert_concurrent_hashmap(map, &keys[i], &keys[i], result);
+        writer->bad = writer->bad || result != Success;
+    }
+
+    for (int i = writer->start + 1; i < writer->start + 10000; i += 2) {
+        int *removed;
+
+        remove_entry_concurrent_hashmap(map, &keys[i], removed);
+        writer->bad = writer->bad || removed != &keys[i];
+    }
+
+    return NULL;
+}
+
+/* 4 writers on their own key ranges and 2 readers on keys that stay put, the
+ * shards grow under the writers while the readers look up
+ */
+int test_concurrent(enum HashMapBackend backend) {
+    static int keys[41000];
+    ConcurrentTest test = {.keys = keys};
+
+    init_concurrent_hashmap(test.map, 4, backend, hash_int, comp_int, NULL);
+
+    if (test.map == NULL || test.map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+
+    for (int i = 0; i < 41000; ++i) {
+        keys[i] = i;
+
+        if (i >= 40000) {
+            insert_concurrent_hashmap(test.map, &keys[i], &keys[i], result);
+        }
+    }
+
+    pthread_t readers[2];
+    pthread_t writers[4];
+    ConcurrentWriter writer_args[4];
+
+    for (int t = 0; t < 2; ++t) {
+        pthread_create(&readers[t], NULL, read_concurrent, &test);
+    }
+
+    for (int t = 0; t < 4; ++t) {
+        writer_args[t] = (ConcurrentWriter){&test, t * 10000, false};
+        pthread_create(&writers[t], NULL, write_concurrent, &writer_args[t]);
+    }
+
+    bool good = result == Success;
+
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(writers[t], NULL);
+        good = good && !writer_args[t].bad;
+    }
+
+    __atomic_store_n(&test.stop, true, __ATOMIC_RELEASE);
+
+    for (int t = 0; t < 2; ++t) {
+        pthread_join(readers[t], NULL);
+    }
+
+    good = good && !test.bad &&
+           get_size_concurrent_hashmap_base(test.map->map_base) == 21000;
+
+    for (int i = 0; i < 41000 && good; ++i) {
+        int *value;
+        bool contains;
+        bool kept = i >= 40000 || i % 2 == 0;
+
+        get_value_concurrent_hashmap(test.map, &keys[i], value);
+        contains_key_concurrent_hashmap(test.map, &keys[i], contains);
+        good = contains == kept && value == (kept ? &keys[i] : NULL);
+    }
+
+    drop_concurrent_hashmap(test.map);
+
+    if (!good) {
+        printf("bad concurrent map\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+uint64_t hash_same(int *key) {
+    return 42;
+}
+
+/* every key has the same hash so the probes get long and the map reseeds, as
+ * no seed can split keys with the same hash it only reseeds as it doubles
+ *
+ * a cuckoo key can only be in two buckets of 4 so the 9th key fails instead
+ * of growing the table
+ */
+int test_flooding(enum HashMapBackend backend) {
+    static int keys[4000];
+    int count = backend == HashMapCuckoo ? 8 : 4000;
+    HashMapInt *map;
+
+    init_hashmap_backend(map, backend, hash_same, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+    int inserted = 0;
+
+    for (int i = 0; i < 4000 && result == Success; ++i) {
+        keys[i] = i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+        inserted += result == Success;
+    }
+
+    bool good = inserted == count &&
+                (count == 4000 ? result == Success : result == FailedToInsert);
+
+    for (int i = 0; i < count && good; ++i) {
+        int *value;
+
+        get_value_hashmap(map, &keys[i], value);
+        good = value == &keys[i];
+    }
+
+    HashMapStats stats;
+    get_stats_hashmap(map, &stats);
+
+    if (backend != HashMapCuckoo) {
+        good = good && stats.reseed_count >= 1 && stats.reseed_count <= 7;
+    }
+
+    drop_hashmap(map);
+
+    if (!good) {
+        printf("bad reseeding %lu\n", (unsigned long)stats.reseed_count);
+        return 1;
+    }
+
+    return 0;
+}
+
+/* save a map, map the file back in and look the keys up in it */
+int test_snapshot(enum HashMapBackend backend) {
+    static int keys[1000];
+    static int values[1000];
+    const char *path = "/tmp/hashmap_test_snapshot";
+    HashMapInt *map;
+
+    init_hashmap_backend(map, backend, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+
+    for (int i = 0; i < 1000; ++i) {
+        keys[i] = i;
+        values[i] = i * 3;
+
+        insert_hashmap(map, &keys[i], &values[i], result);
+    }
+
+    result = save_hashmap(map, path, size_int, size_int);
+
+    drop_hashmap(map);
+
+    HashMapInt *loaded;
+
+    load_hashmap_mmap(loaded, path, hash_int, comp_int);
+
+    bool good = result == Success && loaded != NULL;
+
+    for (int i = 0; i < 1010 && good; ++i) {
+        int *value = NULL;
+
+        get_value_hashmap(loaded, &i, value);
+
+        good = i < 1000 ? value != NULL && *value == i * 3 : value == NULL;
+    }
+
+    if (good) {
+        int key = 2000;
+
+        insert_hashmap(loaded, &key, &key, result);
+
+        good = result != Success && loaded->map_base->current_size == 1000;
+    }
+
+    if (loaded != NULL) {
+        drop_hashmap(loaded);
+    }
+
+    remove(path);
+
+    if (!good) {
+        printf("bad snapshot\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the compact backend iterates in the order the keys were added, removed keys
+ * are skipped and a key added again goes to the end
+ */
+/* grow a chained map with incremental rehashing on and stop part way through
+ * the migration, keys in the old buckets that are not moved yet are looked
+ * up and removed and an iter sees every key once
+ */
+int test_incremental_rehash() {
+    static int keys[800];
+    static int seen[800];
+    HashMapInt *map;
+    HashMapInt *open;
+
+    init_hashmap_backend(map, HashMapChained, hash_int, comp_int, NULL);
+    init_hashmap_backend(open, HashMapOpen, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL || open == NULL ||
+        open->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = set_incremental_rehash(map, true) &&
+                !set_incremental_rehash(open, true);
+    enum HashMapResult result;
+
+    // the table grows at 716 keys and each insert after moves 4 buckets
+    for (int i = 0; i < 800 && good; ++i) {
+        keys[i] = i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+        good = result == Success;
+    }
+
+    HashMapBase *base = map->map_base;
+
+    good = good && base->old_table != NULL &&
+           base->migrate_index < base->old_table_size;
+
+    IterHashMap *iter;
+    int *key;
+    int *value;
+    int count = 0;
+
+    get_iter_hashmap(map, iter);
+
+    for_each(iter, key, value) {
+        good = good && value == &keys[*key] && seen[*key]++ == 0;
+        ++count;
+    }
+
+    drop_iter_hashmap(iter);
+
+    good = good && count == 800;
+
+    // a key from each of the last 3 full old buckets, the 9 calls below only
+    // move 36 buckets so they are still in the old table when looked up
+    int old_keys[3];
+    int found = 0;
+
+    for (int i = base->old_table_size - 1; i >= 0 && found < 3 && good; --i) {
+        if (base->old_table[i] != NULL) {
+            good = i >= base->migrate_index + 36;
+            old_keys[found++] = *(int *)base->old_table[i]->key;
+        }
+    }
+
+    for (int i = 0; i < found && good; ++i) {
+        int *removed;
+        bool contains;
+
+        get_value_hashmap(map, &old_keys[i], value);
+        contains_key_hashmap(map, &old_keys[i], contains);
+        remove_entry_hashmap(map, &old_keys[i], removed);
+
+        good = value == &keys[old_keys[i]] && contains &&
+               removed == &keys[old_keys[i]];
+    }
+
+    good = good && found == 3 && base->old_table != NULL;
+
+    // finish the migration and check every key is where it should be
+    good = good && set_incremental_rehash(map, false) &&
+           base->old_table == NULL && get_max_pause(map) > 0;
+
+    for (int i = 0; i < 800 && good; ++i) {
+        bool removed = i == old_keys[0] || i == old_keys[1] ||
+                       i == old_keys[2];
+
+        get_value_hashmap(map, &keys[i], value);
+        good = value == (removed ? NULL : &keys[i]);
+    }
+
+    drop_hashmap(map);
+    drop_hashmap(open);
+
+    if (!good) {
+        printf("bad incremental rehash\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+typedef struct {
+    char data[1 << 16];
+    size_t used;
+    int allocs;
+} TestArena;
+
+/* a bump allocator over a static buffer, freeing any of it would crash */
+void *bump_alloc(void *arena, size_t size) {
+    TestArena *bump = arena;
+    size_t start = (bump->used + 15) & ~(size_t)15;
+
+    if (start + size > sizeof(bump->data)) {
+        return NULL;
+    }
+
+    bump->used = start + size;
+    ++bump->allocs;
+
+    return bump->data + start;
+}
+
+/* the pool blocks of a chained map come from the arena, removed entrys are
+ * reused before it asks for more and the map leaves the blocks alone when it
+ * is dropped
+ */
+int test_arena() {
+    static TestArena arena;
+    static int keys[POOL_START_BLOCK + 20];
+    HashMapInt *map;
+    HashMapInt *open;
+
+    init_hashmap_backend(map, HashMapChained, hash_int, comp_int, NULL);
+    init_hashmap_backend(open, HashMapOpen, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL || open == NULL ||
+        open->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = set_arena_hashmap(map, bump_alloc, &arena) &&
+                !set_arena_hashmap(open, bump_alloc, &arena);
+    enum HashMapResult result;
+
+    // exactly fill the first block
+    for (int i = 0; i < POOL_START_BLOCK && good; ++i) {
+        keys[i] = i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+        good = result == Success;
+    }
+
+    EntryPool *pool = &map->map_base->pool;
+    char *block = (char *)pool->blocks;
+
+    good = good && arena.allocs == 1 && block >= arena.data &&
+           block < arena.data + arena.used &&
+           !set_arena_hashmap(map, bump_alloc, &arena);
+
+    // the removed entrys are reused so the arena is not asked again
+    for (int i = 0; i < 20 && good; ++i) {
+        int *removed;
+
+        remove_entry_hashmap(map, &keys[i], removed);
+        good = removed == &keys[i];
+    }
+
+    for (int i = POOL_START_BLOCK; i < POOL_START_BLOCK + 20 && good; ++i) {
+        keys[i] = i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+        good = result == Success;
+    }
+
+    good = good && arena.allocs == 1 && (char *)pool->blocks == block;
+
+    for (int i = 20; i < POOL_START_BLOCK + 20 && good; ++i) {
+        int *value;
+
+        get_value_hashmap(map, &keys[i], value);
+        good = value == &keys[i];
+    }
+
+    // with no drop_func nothing is freed, a free of the static arena would
+    // abort here
+    drop_hashmap(map);
+    drop_hashmap(open);
+
+    if (!good) {
+        printf("bad arena\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_insertion_order() {
+    static int keys[1000];
+    HashMapInt *map;
+
+    init_hashmap_backend(map, HashMapCompact, hash_int, comp_int, NULL);
+
+    if (map == NULL || map->map_base == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+    int *removed = NULL;
+
+    for (int i = 0; i < 1000; ++i) {
+        keys[i] = 999 - i;
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+    }
+
+    for (int i = 0; i < 1000; i += 2) {
+        remove_entry_hashmap(map, &keys[i], removed);
+    }
+
+    insert_hashmap(map, &keys[0], &keys[0], result);
+
+    IterHashMap *iter;
+    int *key;
+    int *value;
+    int seen = 0;
+    bool good = result == Success;
+
+    get_iter_hashmap(map, iter);
+
+    // the odd keys in order and then the first key again
+    for_each(iter, key, value) {
+        good = good && key == &keys[seen < 500 ? seen * 2 + 1 : 0];
+
+        ++seen;
+    }
+
+    drop_iter_hashmap(iter);
+    drop_hashmap(map);
+
+    if (!good || seen != 501) {
+        printf("bad insertion order\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the uint64_t key map, including the key it uses to mark empty slots */
+int test_int_map() {
+    IntHashMap *map = init_int_hashmap(NULL);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = true;
+
+    for (uint64_t i = 0; i < 10000 && good; ++i) {
+        good = insert_int_hashmap(map, i * 7, (void *)(uintptr_t)i) == Success;
+    }
+
+    good = good && insert_int_hashmap(map, INT_EMPTY_KEY, map) == Success &&
+           insert_int_hashmap(map, 7, NULL) == FailedToInsertDuplicate;
+
+    for (uint64_t i = 0; i < 10000 && good; i += 2) {
+        good = remove_entry_int_hashmap(map, i * 7) == (void *)(uintptr_t)i;
+    }
+
+    for (uint64_t i = 0; i < 10000 && good; ++i) {
+        good = contains_key_int_hashmap(map, i * 7) == (i % 2 == 1) &&
+               !contains_key_int_hashmap(map, i * 7 + 1);
+    }
+
+    uint64_t key;
+    void *value;
+    int count = 0;
+
+    for_each_int(map, key, value) {
+        good = good && (key == INT_EMPTY_KEY
+                            ? value == map
+                            : value == (void *)(uintptr_t)(key / 7));
+        ++count;
+    }
+
+    good = good && count == 5001 && map->current_size == 5001 &&
+           get_value_int_hashmap(map, INT_EMPTY_KEY) == map;
+
+    drop_int_hashmap(map);
+
+    if (!good) {
+        printf("bad int map\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+typedef struct {
+    LockFreeHashMap *map;
+    int *keys;
+    bool stop;
+    bool bad;
+} LockFreeTest;
+
+/* look up the keys that stay in the map until the writer is done */
+void *read_lockfree(void *arg) {
+    LockFreeTest *test = arg;
+
+    while (!__atomic_load_n(&test->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < 1000; ++i) {
+            if (get_value_lockfree_hashmap_base(test->map, &test->keys[i]) !=
+                &test->keys[i]) {
+                test->bad = true;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* readers keep finding the same keys while the writer grows the table and
+ * removes keys around them
+ */
+int test_lockfree_map() {
+    static int keys[20000];
+    LockFreeTest test = {.keys = keys};
+
+    test.map = init_lockfree_hashmap_base((HashFunc)hash_int,
+                                          (CompFunc)comp_int, NULL);
+
+    if (test.map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = true;
+
+    for (int i = 0; i < 20000; ++i) {
+        keys[i] = i;
+    }
+
+    for (int i = 0; i < 1000; ++i) {
+        insert_lockfree_hashmap_base(test.map, &keys[i], &keys[i]);
+    }
+
+    pthread_t readers[4];
+
+    for (int t = 0; t < 4; ++t) {
+        pthread_create(&readers[t], NULL, read_lockfree, &test);
+    }
+
+    for (int i = 1000; i < 20000 && good; ++i) {
+        good = insert_lockfree_hashmap_base(test.map, &keys[i], &keys[i]) ==
+               Success;
+    }
+
+    for (int i = 1000; i < 20000 && good; ++i) {
+        good = remove_entry_lockfree_hashmap_base(test.map, &keys[i]) ==
+               &keys[i];
+    }
+
+    __atomic_store_n(&test.stop, true, __ATOMIC_RELEASE);
+
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(readers[t], NULL);
+    }
+
+    good = good && !test.bad &&
+           get_size_lockfree_hashmap_base(test.map) == 1000 &&
+           insert_lockfree_hashmap_base(test.map, &keys[0], NULL) ==
+               FailedToInsertDuplicate &&
+           !contains_key_lockfree_hashmap_base(test.map, &keys[1000]);
+
+    drop_lockfree_hashmap_base(test.map);
+
+    if (!good) {
+        printf("bad lock free map\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* look up keys 0 to 999 by value, the keys in the map are their own copies */
+void *read_lockfree_copies(void *arg) {
+    LockFreeTest *test = arg;
+
+    while (!__atomic_load_n(&test->stop, __ATOMIC_ACQUIRE)) {
+        for (int i = 0; i < 1000; ++i) {
+            if (get_value_lockfree_hashmap_base(test->map, &i) !=
+                (void *)(uintptr_t)(i + 1)) {
+
+                test->bad = true;
+            }
+        }
+    }
+
+    return NULL;
+}
+
+void free_lockfree_key(void *key, void *value) {
+    free(key);
+}
+
+/* insert a malloced copy of key with key + 1 as the value */
+bool insert_lockfree_copy(LockFreeHashMap *map, int key) {
+    int *copy = malloc(sizeof(int));
+
+    *copy = key;
+
+    void *value = (void *)(uintptr_t)(key + 1);
+
+    return insert_lockfree_hashmap_base(map, copy, value) == Success;
+}
+
+/* grow past several transfer chunks with readers going through the forwarded
+ * buckets and moving chunks, then remove keys that were copied in to the
+ * block of the table and grow again so the block is freed, the drop_func
+ * frees the keys so a block freed before its keys are dropped is caught
+ */
+int test_lockfree_resize() {
+    LockFreeTest test = {0};
+
+    test.map = init_lockfree_hashmap_base(
+        (HashFunc)hash_int, (CompFunc)comp_int, free_lockfree_key);
+
+    if (test.map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = true;
+
+    for (int i = 0; i < 1000; ++i) {
+        insert_lockfree_copy(test.map, i);
+    }
+
+    pthread_t readers[4];
+
+    for (int t = 0; t < 4; ++t) {
+        pthread_create(&readers[t], NULL, read_lockfree_copies, &test);
+    }
+
+    for (int i = 1000; i < 40000 && good; ++i) {
+        good = insert_lockfree_copy(test.map, i);
+    }
+
+    good = good && test.map->table->size > 4 * LOCKFREE_TRANSFER_CHUNK;
+
+    int size = test.map->table->size;
+
+    for (int i = 1000; i < 20000 && good; ++i) {
+        good = remove_entry_lockfree_hashmap_base(test.map, &i) ==
+               (void *)(uintptr_t)(i + 1);
+    }
+
+    for (int i = 40000; i < 80000 && good; ++i) {
+        good = insert_lockfree_copy(test.map, i);
+    }
+
+    __atomic_store_n(&test.stop, true, __ATOMIC_RELEASE);
+
+    for (int t = 0; t < 4; ++t) {
+        pthread_join(readers[t], NULL);
+    }
+
+    int removed = 1000;
+    int kept = 39999;
+
+    good = good && !test.bad && test.map->table->size > size &&
+           get_size_lockfree_hashmap_base(test.map) == 61000 &&
+           !contains_key_lockfree_hashmap_base(test.map, &removed) &&
+           get_value_lockfree_hashmap_base(test.map, &kept) ==
+               (void *)(uintptr_t)(kept + 1);
+
+    drop_lockfree_hashmap_base(test.map);
+
+    if (!good) {
+        printf("bad lock free resize\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the string key map with keys that are stored inline and in the arena */
+int test_str_map() {
+    StrHashMap *map = init_str_hashmap(NULL);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = true;
+    char buffer[64];
+
+    // every 3rd key is longer than STR_INLINE_SIZE
+    for (int i = 0; i < 3000 && good; ++i) {
+        snprintf(buffer, sizeof(buffer), i % 3 ? "k%d" : "a long key number %d",
+                 i);
+        good = insert_str_hashmap(map, buffer, (void *)(intptr_t)i) == Success;
+    }
+
+    good = good &&
+           insert_str_hashmap(map, "k1", NULL) == FailedToInsertDuplicate &&
+           insert_str_hashmap(map, "", map) == Success;
+
+    for (int i = 0; i < 3000 && good; i += 2) {
+        snprintf(buffer, sizeof(buffer), i % 3 ? "k%d" : "a long key number %d",
+                 i);
+        good = remove_entry_str_hashmap(map, buffer) == (void *)(intptr_t)i &&
+               !contains_key_str_hashmap(map, buffer);
+    }
+
+    const char *key;
+    void *value;
+    int count = 0;
+
+    for_each_str(map, key, value) {
+        if (value != map) {
+            int i = (int)(intptr_t)value;
+
+            snprintf(buffer, sizeof(buffer),
+                     i % 3 ? "k%d" : "a long key number %d", i);
+            good = good && i % 2 == 1 && strcmp(key, buffer) == 0;
+        }
+
+        ++count;
+    }
+
+    good = good && count == 1501 && map->current_size == 1501 &&
+           get_value_str_hashmap(map, "") == map &&
+           get_value_str_hashmap(map, "a long key number 3") == (void *)3;
+
+    drop_str_hashmap(map);
+
+    if (!good) {
+        printf("bad str map\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the hashset and the set operations, keys 0 to 99 and the even keys to 198 */
+int test_hashset() {
+    int *keys = malloc(sizeof(int) * 200);
+    HashSetInt *set_1;
+    HashSetInt *set_2;
+
+    init_hashset(set_1, 0, hash_int, comp_int, NULL);
+    init_hashset(set_2, 100, hash_int, comp_int, NULL);
+
+    if (keys == NULL || set_1 == NULL || set_2 == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    bool good = true;
+    enum HashMapResult result;
+
+    for (int i = 0; i < 200; ++i) {
+        keys[i] = i;
+
+        if (i < 100) {
+            insert_hashset(set_1, &keys[i], result);
+            good = good && result == Success;
+        }
+
+        if (i % 2 == 0) {
+            insert_hashset(set_2, &keys[i], result);
+            good = good && result == Success;
+        }
+    }
+
+    int duplicate = 4;
+    int *removed;
+
+    insert_hashset(set_1, &duplicate, result);
+    remove_key_hashset(set_2, &keys[198], removed);
+
+    good = good && result == FailedToInsertDuplicate && removed == &keys[198];
+
+    HashSetInt *both;
+    HashSetInt *either;
+    HashSetInt *only_1;
+
+    intersection_hashset(set_1, set_2, both);
+    union_hashset(set_1, set_2, either);
+    difference_hashset(set_1, set_2, only_1);
+
+    if (both == NULL || either == NULL || only_1 == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    int *key;
+    int count = 0;
+
+    for_each_set(both, key) {
+        good = good && *key < 100 && *key % 2 == 0;
+        ++count;
+    }
+
+    for_each_set(only_1, key) {
+        good = good && *key < 100 && *key % 2 == 1;
+        ++count;
+    }
+
+    bool contains;
+
+    contains_key_hashset(either, &keys[196], contains);
+    good = good && contains;
+    contains_key_hashset(either, &keys[198], contains);
+    good = good && !contains && count == 100 &&
+           either->set_base->current_size == 149;
+
+    drop_hashset(both);
+    drop_hashset(either);
+    drop_hashset(only_1);
+    drop_hashset(set_1);
+    drop_hashset(set_2);
+    free(keys);
+
+    if (!good) {
+        printf("bad hashset\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int evicted_count = 0;
+
+void count_evicted(int *key, int *value) {
+    ++evicted_count;
+}
+
+/* a full cache of 100 keys where the first 50 are used before 50 new keys go
+ * in, the unused keys are the ones evicted
+ */
+int test_cache() {
+    static int keys[150];
+    HashMapInt *map;
+
+    init_hashmap_backend(map, HashMapOpen, hash_int, comp_int, count_evicted);
+
+    if (map == NULL || map->map_base == NULL ||
+        !set_cache_capacity_hashmap(map, 100)) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    enum HashMapResult result = Success;
+    int *value;
+
+    for (int i = 0; i < 150 && result == Success; ++i) {
+        keys[i] = i;
+
+        if (i == 100) {
+            for (int j = 0; j < 50; ++j) {
+                get_value_hashmap(map, &keys[j], value);
+            }
+        }
+
+        insert_hashmap(map, &keys[i], &keys[i], result);
+    }
+
+    bool good = result == Success && map->map_base->current_size == 100;
+
+    for (int i = 0; i < 50; ++i) {
+        get_value_hashmap(map, &keys[i], value);
+        good = good && value == &keys[i];
+    }
+
+    HashMapStats stats;
+    get_stats_hashmap(map, &stats);
+
+    good = good && stats.cache_evictions == 50 && evicted_count == 50 &&
+           stats.cache_hits == 100 && stats.cache_misses == 150 &&
+           stats.rehash_count == 0;
+
+    drop_hashmap(map);
+
+    if (!good) {
+        printf("bad cache\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int test_inline() {
+    HashMapChar *map = init_HashMapChar(STARTING_SIZE);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    for (int i = 0x21; i <= 0x7E; ++i) {
+        enum HashMapResult result = insert_HashMapChar(map, (char)i, (char)i);
+
+        if (result != Success) {
+            printf("bad insert %d\n", i);
+            print_hashmap_error(result);
+
+            drop_HashMapChar(map);
+            return 1;
+        }
+    }
+
+    if (insert_HashMapChar(map, '!', 0) != FailedToInsertDuplicate ||
+        *get_value_HashMapChar(map, '!') != '!') {
+        printf("inline insert replaced a key\n");
+
+        drop_HashMapChar(map);
+        return 1;
+    }
+
+    char *found = get_value_HashMapChar(map, '+');
+
+    if (found == NULL) {
+        printf("did not find the key \n");
+    } else {
+        printf("found %c \n", *found);
+    }
+
+    char removed = 0;
+
+    if (!remove_entry_HashMapChar(map, '+', &removed) ||
+        contains_key_HashMapChar(map, '+')) {
+        printf("could not remove key\n");
+
+        drop_HashMapChar(map);
+        return 1;
+    }
+
+    char key;
+    char value;
+    int count = 0;
+
+    for_each_inline(HashMapChar, map, key, value) {
+        if (key != value) {
+            printf("bad value for %c\n", key);
+            break;
+        }
+
+        ++count;
+    }
+
+    printf("iterated over %d inline entrys\n", count);
+
+    drop_HashMapChar(map);
+
+    return count == 0x7E - 0x21 ? 0 : 1;
+}
+
+/* the int map with seed 0 and keys that all start in slot 0 under it, the
+ * probe gets long enough that the map picks a new seed and splits them
+ */
+int test_int_flooding() {
+    static uint64_t keys[400];
+    IntHashMap *map = init_int_hashmap(NULL);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    map->seed = 0;
+
+    int count = 0;
+
+    for (uint64_t key = 0; count < 400; ++key) {
+        if ((mix_seed(0, key) & (map->table_size - 1)) == 0) {
+            keys[count++] = key;
+        }
+    }
+
+    bool good = true;
+
+    for (int i = 0; i < 400 && good; ++i) {
+        good = insert_int_hashmap(map, keys[i], &keys[i]) == Success;
+    }
+
+    for (int i = 0; i < 400 && good; ++i) {
+        good = get_value_int_hashmap(map, keys[i]) == &keys[i];
+    }
+
+    good = good && map->seed != 0;
+
+    drop_int_hashmap(map);
+
+    if (!good) {
+        printf("bad int map flooding\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the same as test_int_flooding for the string map */
+int test_str_flooding() {
+    static char keys[100][16];
+    StrHashMap *map = init_str_hashmap(NULL);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    map->seed = 0;
+
+    int count = 0;
+
+    for (int i = 0; count < 100; ++i) {
+        int len = snprintf(keys[count], sizeof(keys[count]), "f%d", i);
+
+        count += (fast_hash64(keys[count], len, 0) &
+                  (map->table_size - 1)) == 0;
+    }
+
+    bool good = true;
+
+    for (int i = 0; i < 100 && good; ++i) {
+        good = insert_str_hashmap(map, keys[i], keys[i]) == Success;
+    }
+
+    for (int i = 0; i < 100 && good; ++i) {
+        good = get_value_str_hashmap(map, keys[i]) == keys[i];
+    }
+
+    good = good && map->seed != 0;
+
+    drop_str_hashmap(map);
+
+    if (!good) {
+        printf("bad str map flooding\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* every key has the same hash, see test_flooding, the set still reseeds as it
+ * grows and keeps every key
+ */
+int test_set_flooding() {
+    static int keys[1000];
+    HashSetInt *set;
+
+    init_hashset(set, 0, hash_same, comp_int, NULL);
+
+    if (set == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    uint64_t seed = set->set_base->seed;
+    bool good = true;
+    enum HashMapResult result;
+
+    for (int i = 0; i < 1000 && good; ++i) {
+        keys[i] = i;
+
+        insert_hashset(set, &keys[i], result);
+        good = result == Success;
+    }
+
+    for (int i = 0; i < 1000 && good; ++i) {
+        int key = i;
+
+        contains_key_hashset(set, &key, good);
+    }
+
+    good = good && set->set_base->seed != seed;
+
+    drop_hashset(set);
+
+    if (!good) {
+        printf("bad hashset flooding\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+/* the same as test_set_flooding for a map from HASHMAP_INLINE */
+int test_inline_flooding() {
+    HashMapSame *map = init_HashMapSame(1024);
+
+    if (map == NULL) {
+        printf("did not allocate memory\n");
+        return 1;
+    }
+
+    uint64_t seed = map->seed;
+    bool good = true;
+
+    for (int i = 0; i < 1000 && good; ++i) {
+        good = insert_HashMapSame(map, i, -i) == Success;
+    }
+
+    for (int i = 0; i < 1000 && good; ++i) {
+        int *value = get_value_HashMapSame(map, i);
+
+        good = value != NULL && *value == -i;
+    }
+
+    good = good && map->seed != seed;
+
+    drop_HashMapSame(map);
+
+    if (!good) {
+        printf("bad inline flooding\n");
+        return 1;
+    }
+
+    return 0;
+}
+
+int main() {
+    enum HashMapBackend backends[] = {HashMapChained, HashMapOpen,
+                                      HashMapSwiss, HashMapCompact,
+                                      HashMapCuckoo};
+
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); ++b) {
+        if (test_backend(backends[b]) != 0 ||
+            test_capacity(backends[b]) != 0 ||
+            test_small_table(backends[b]) != 0 ||
+            test_entry(backends[b]) != 0 || test_build(backends[b]) != 0 ||
+            test_parallel(backends[b]) != 0 ||
+            test_concurrent(backends[b]) != 0 ||
+            test_snapshot(backends[b]) != 0 ||
+            test_flooding(backends[b]) != 0) {
+            return 1;
+        }
+    }
+
+    if (test_incremental_rehash() != 0 || test_arena() != 0 ||
+        test_insertion_order() != 0 || test_cache() != 0) {
+        return 1;
+    }
+
+    if (test_int_map() != 0 || test_str_map() != 0 || test_hashset() != 0 ||
+        test_lockfree_map() != 0 || test_lockfree_resize() != 0) {
+        return 1;
+    }
+
+    if (test_int_flooding() != 0 || test_str_flooding() != 0 ||
+        test_set_flooding() != 0) {
+        return 1;
+    }
+
+    if (test_inline() != 0 || test_inline_flooding() != 0) {
+        return 1;
+    }
+
+    return 0;
+}